@@ -27,12 +27,13 @@ public:
         return x;
     }
 
-    // 必须实现，返回所有参数
-    std::vector<cctorch::Tensor> parameters() override
+    // 必须实现，返回所有参数（每层的权重和偏置各是一个连续的 DenseTensor）
+    // 旧的 std::vector<cctorch::Tensor> parameters() 仍然可用，但已弃用
+    std::vector<cctorch::DenseTensor> dense_parameters() override
     {
-        std::vector<cctorch::Tensor> params;
-        auto p1 = linear1.parameters();
-        auto p2 = linear2.parameters();
+        std::vector<cctorch::DenseTensor> params;
+        auto p1 = linear1.dense_parameters();
+        auto p2 = linear2.dense_parameters();
 
         params.insert(params.end(), p1.begin(), p1.end());
         params.insert(params.end(), p2.begin(), p2.end());
@@ -2,6 +2,7 @@
 #include "../../include/layer.h"
 #include "../../include/loss.h"
 #include "../../include/optimizer.h"
+#include "../../include/graph_arena.h"
 #include <iostream>
 
 int main()
@@ -24,13 +25,16 @@ int main()
     int epochs = 40;
     float learning_rate = 0.01f;
     cctorch::Linear linear(1, 1);
-    cctorch::SGD optimizer(linear.parameters(), learning_rate);
+    cctorch::SGD optimizer(linear.dense_parameters(), learning_rate);
     cctorch::MSELoss criterion;
 
     std::cout << "parameters size: " << optimizer.parameters.size() << std::endl;
 
+    // 每个 epoch 的计算图节点从 arena 分配，作用域结束时块留给下一个 epoch 复用
+    cctorch::GraphArena arena;
     for (int epoch = 1; epoch <= epochs; ++epoch)
     {
+        cctorch::GraphArena::Scope scope(arena);
         float tot_loss = 0;
         // batch gradient descent
         vector<vector<cctorch::Tensor>> batch_inputs;
@@ -51,7 +55,7 @@ int main()
             std::cout << "Epoch [" << epoch << "/" << epochs << "], Loss: " << tot_loss / X.size();
             for (const auto &param : optimizer.parameters)
             {
-                std::cout << ", Parameter: " << param.value() << " (grad: " << param.grad() << ")";
+                std::cout << ", Parameter: " << param.value(0) << " (grad: " << param.grad(0) << ")";
             }
             std::cout << std::endl;
         }
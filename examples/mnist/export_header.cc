@@ -0,0 +1,69 @@
+#include "../../include/checkpoint.h"
+#include "../../include/header_export.h"
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+// 把训练好的 MLP 检查点导出为独立的推理头文件：
+//     ./mnist_export ../models/mlp_final.bin mlp_model.h
+//     ./mnist_export mlp_epoch_1_20.bin.delta mlp_model.h --base mlp_epoch_1_10.bin --name digits
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <checkpoint> <output.h> [--name <namespace>] [--base <base checkpoint>]" << std::endl;
+        return 1;
+    }
+
+    std::string input = argv[1];
+    std::string output = argv[2];
+    std::string base_path;
+    cctorch::HeaderExportOptions options;
+    for (int i = 3; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--name" && i + 1 < argc)
+        {
+            options.name = argv[++i];
+        }
+        else if (arg == "--base" && i + 1 < argc)
+        {
+            base_path = argv[++i];
+        }
+        else
+        {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    try
+    {
+        if (!cctorch::Checkpoint::is_checkpoint(input))
+        {
+            throw std::runtime_error(input + " is not a v2 checkpoint; load it with the model and save it again first");
+        }
+        // 增量检查点需要先打开它的基准
+        std::unique_ptr<cctorch::Checkpoint> base;
+        std::unique_ptr<cctorch::Checkpoint> checkpoint;
+        if (base_path.empty())
+        {
+            checkpoint = std::make_unique<cctorch::Checkpoint>(input);
+        }
+        else
+        {
+            base = std::make_unique<cctorch::Checkpoint>(base_path);
+            checkpoint = std::make_unique<cctorch::Checkpoint>(input, *base);
+        }
+        cctorch::export_header(*checkpoint, output, options);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Export failed: " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::cout << "Exported " << input << " to " << output << " (namespace " << options.name << ")" << std::endl;
+    return 0;
+}
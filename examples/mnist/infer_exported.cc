@@ -0,0 +1,65 @@
+#include "../../include/idx_dataset.h"
+#include "../../include/dense_tensor.h"
+#include "../../include/sequential.h"
+#include CCTORCH_MODEL_HEADER
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// 在测试集上对比导出的 mlp_model::infer() 和 Model::forward 的输出，二者一致时返回 0：
+//     ./mnist_infer ../models/mlp_final.bin
+// 头文件由 mnist_export 用默认的命名空间 mlp_model 生成，构建时通过 CCTORCH_MODEL_HEADER 指定
+using MLP = cctorch::fixed::Sequential<cctorch::fixed::Linear<784, 128>,
+                                       cctorch::fixed::ReLU,
+                                       cctorch::fixed::Linear<128, 10>>;
+
+static_assert(mlp_model::in_features == MLP::in_features && mlp_model::out_features == MLP::out_features,
+              "exported header does not match the MLP shape");
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <checkpoint the header was exported from> [data dir]" << std::endl;
+        return 1;
+    }
+    std::string data_path = argc > 2 ? argv[2] : "../data";
+
+    MLP mlp;
+    mlp.load(argv[1]);
+    auto test_data = cctorch::IDXDataset::test(data_path);
+    int num_images = static_cast<int>(test_data.size());
+    const int classes = mlp_model::out_features;
+
+    cctorch::DenseTensor images({num_images, mlp_model::in_features});
+    cctorch::normalize_pixels(test_data.pixels(), images.value_ptr(), images.numel());
+    cctorch::DenseTensor reference;
+    {
+        cctorch::NoGradGuard no_grad;
+        cctorch::Model &model = mlp;
+        reference = model.forward(images);
+    }
+
+    float max_diff = 0.0f;
+    int correct = 0, agree = 0;
+    float scores[mlp_model::out_features];
+    for (int i = 0; i < num_images; ++i)
+    {
+        mlp_model::infer(images.value_ptr() + static_cast<size_t>(i) * mlp_model::in_features, scores);
+        const float *expected = reference.value_ptr() + static_cast<size_t>(i) * classes;
+        for (int j = 0; j < classes; ++j)
+        {
+            max_diff = std::max(max_diff, std::fabs(scores[j] - expected[j]));
+        }
+        int predicted = std::max_element(scores, scores + classes) - scores;
+        correct += predicted == test_data.labels()[i];
+        agree += predicted == std::max_element(expected, expected + classes) - expected;
+    }
+
+    std::cout << "Exported model: accuracy " << static_cast<float>(correct) / num_images * 100 << "%, "
+              << agree << "/" << num_images << " predictions agree with Model::forward, max |diff| " << max_diff << std::endl;
+    // 两边的累加顺序不同（GEMM 分块），只允许舍入误差
+    return agree == num_images && max_diff < 1e-3f ? 0 : 1;
+}
@@ -1,103 +1,71 @@
 #include "../../include/tensor.h"
 #include "../../include/layer.h"
 #include "../../include/mnist_loader.h"
+#include "../../include/idx_dataset.h"
+#include "../../include/data_loader.h"
 #include "../../include/loss.h"
 #include "../../include/optimizer.h"
 #include "../../include/model.h"
+#include "../../include/checkpoint.h"
+#include "../../include/trainer.h"
+#include "../../include/profiler.h"
+#include "../../include/sequential.h"
 #include <algorithm>
 #include <fstream>
 #include <stdexcept>
 #include <filesystem>
+#include <memory>
 
 using cctorch::MNISTLoader;
 using std::vector;
 
-class MLP : public cctorch::Model
-{
-public:
-    cctorch::Linear linear1;
-    cctorch::ReLU relu;
-    cctorch::Linear linear2;
-
-    // 模型格式
-    // [offset] [type]          [value]          [description]
-    // 0000     32 bit integer  1(Linear)        layer类型
-    // 0004     32 bit integer  784              in_features
-    // 0008     32 bit integer  128              out_features
-    // 0012     float           w[0][0]          模型权重
-    // 0016     float           w[0][1]          模型权重
-    // ...
-    // xxxx     float           b[x]             模型偏置
-    // ...
-    // xxxx     32 bit integer  1(Linear)        layer类型
-    // xxxx+4   32 bit integer  128              in_features
-    // xxxx+8   32 bit integer  10               out_features
-    // xxxx+12  float           w[0][0]          模型权重
-    // xxxx+16  float           w[0][1]          模型权重
-    // ...
-    // xxxx+... float           b[x]             模型偏置
-    // ...
-    MLP() : linear1(784, 128),
-            relu(),
-            linear2(128, 10) {}
-
-    std::vector<cctorch::Tensor> forward(const std::vector<cctorch::Tensor> &input) override
-    {
-        auto x = linear1(input);
-        x = relu(x);
-        x = linear2(x);
-        return x;
-    }
+// 784 -> 128 -> ReLU -> 10，形状在编译期确定。dense_parameters()、保存（检查点格式 v2，可附带 Adam 状态）
+// 和加载都由 Sequential 生成：第一个 Linear 为第 0 层、第二个为第 1 层，load 仍能读取逐层拼接的旧格式
+using MLP = cctorch::fixed::Sequential<cctorch::fixed::Linear<784, 128>,
+                                       cctorch::fixed::ReLU,
+                                       cctorch::fixed::Linear<128, 10>>;
 
-    std::vector<cctorch::Tensor> parameters() override
+// 在测试集上评估准确率：整个测试集走固定尺寸的推理内核，不构建计算图
+float evaluate(MLP &mlp, const cctorch::IDXDataset &data)
+{
+    if (data.image_size() != MLP::in_features)
     {
-        // return linear1.parameters();
-
-        std::vector<cctorch::Tensor> params;
-        auto p1 = linear1.parameters();
-        auto p2 = linear2.parameters();
-
-        params.insert(params.end(), p1.begin(), p1.end());
-        params.insert(params.end(), p2.begin(), p2.end());
-
-        return params;
+        throw std::runtime_error("Unexpected image size in test set");
     }
-
-    void save(const std::string &filename) const override
+    size_t num_images = data.size();
+    std::vector<float> images(num_images * MLP::in_features);
+    std::vector<float> logits(num_images * MLP::out_features);
+    cctorch::normalize_pixels(data.pixels(), images.data(), images.size());
+    mlp.predict(images.data(), logits.data(), num_images);
+    int correct = 0;
+    for (size_t i = 0; i < num_images; i++)
     {
-        std::ofstream file(filename, std::ios::binary);
-        if (!file.is_open())
+        const float *row = logits.data() + i * MLP::out_features;
+        if (std::max_element(row, row + MLP::out_features) - row == data.labels()[i])
         {
-            throw std::runtime_error("Failed to open file for writing: " + filename);
+            correct++;
         }
-
-        // 依次保存每个层
-        linear1.save_to_stream(file);
-        linear2.save_to_stream(file);
-
-        file.close();
-        std::cout << "MLP model saved to " << filename << std::endl;
     }
+    return static_cast<float>(correct) / num_images * 100;
+}
 
-    void load(const std::string &filename) override
+int main(int argc, char **argv)
+{
+    // --bf16 开启混合精度训练，默认全精度
+    bool bf16 = false;
+    for (int i = 1; i < argc; ++i)
     {
-        std::ifstream file(filename, std::ios::binary);
-        if (!file.is_open())
+        if (std::string(argv[i]) == "--bf16")
         {
-            throw std::runtime_error("Failed to open file for reading: " + filename);
+            bf16 = true;
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--bf16]" << std::endl;
+            return 1;
         }
-
-        // 依次加载每个层
-        linear1.load_from_stream(file);
-        linear2.load_from_stream(file);
-
-        file.close();
-        std::cout << "MLP model loaded from " << filename << std::endl;
     }
-};
 
-int main()
-{
     // 使用相对路径指向数据目录
     std::string data_path = "../data";
     std::string models_path = "../models";
@@ -105,76 +73,101 @@ int main()
     // 创建models目录（如果不存在）
     std::filesystem::create_directories(models_path);
 
-    auto train_data = cctorch::MNISTLoader::load_train_data(data_path);
-    auto test_data = cctorch::MNISTLoader::load_test_data(data_path);
+    // 数据集直接映射到内存，shuffle 只打乱样本编号，batch 是不拷贝像素的视图
+    auto train_data = cctorch::IDXDataset::train(data_path);
+    auto test_data = cctorch::IDXDataset::test(data_path);
     int epochs = 2;
     float learning_rate = 0.001f;
     MLP mlp;
 
-    // mlp.load(models_path + "/mlp_epoch_1_250.bin");
-
-    cctorch::Adam optimizer(mlp.parameters(), learning_rate);
-    std::cout << "MLP initialized with " << mlp.parameters().size() << " parameters." << std::endl;
+    cctorch::Adam optimizer(mlp.dense_parameters(), learning_rate);
+    // mlp.load(models_path + "/mlp_epoch_1_250.bin", &optimizer);
+    optimizer.set_multi_tensor(true);
+    size_t num_parameters = 0;
+    for (const auto &param : mlp.dense_parameters())
+    {
+        num_parameters += param.numel();
+    }
+    std::cout << "MLP initialized with " << num_parameters << " parameters." << std::endl;
     cctorch::CrossEntropyLoss criterion;
     int batch_size = 64;
+    // 每次前向的行数：内存不够时调小，梯度仍然是整个 batch 的平均，更新不变
+    int micro_batch_size = 64;
+
+    // 第一个 batch 记录一次前向 + 反向的执行计划，之后的 batch 直接重放，不再逐步构建计算图
+    cctorch::Trainer<cctorch::Adam> trainer(mlp, criterion, optimizer, micro_batch_size);
+    // 混合精度（--bf16）：激活以 bf16 存储（权重直接以 fp32 参与 GEMM，不复制），参数、梯度和 Adam 状态仍是 fp32
+    cctorch::Precision precision = bf16 ? cctorch::Precision::BF16 : cctorch::Precision::FP32;
+
+    // 后台线程提前打乱、切片并归一化下一个 batch，训练线程只取现成的数据
+    cctorch::DataLoaderOptions loader_options;
+    loader_options.batch_size = batch_size;
+    loader_options.num_workers = 2;
+    cctorch::DataLoader loader(train_data, loader_options);
+
+    // 训练线程只拷贝一份参数快照，写盘和 fsync 在后台线程完成。
+    // 第一个检查点完整保存并作为基准，之后只保存相对它变化的块（压缩后）
+    cctorch::AsyncCheckpointWriter checkpointer;
+    std::unique_ptr<cctorch::Checkpoint> base_checkpoint;
 
     std::cout << "Training MLP on MNIST dataset..." << std::endl;
+    // 用 -DCCTORCH_PROFILE=ON 配置时记录每个训练步的时间区间和节点计数，否则这些调用什么也不做
+    cctorch::profiler::start();
     for (int epoch = 1; epoch <= epochs; ++epoch)
     {
-        train_data.shuffle();
         int num_batches = 0;
-        for (int i = 0; i < train_data.num_images; i += batch_size)
+        while (const cctorch::DataBatch *batch = loader.next())
         {
-            auto batch = cctorch::MNISTLoader::get_batch(train_data, i, batch_size);
-            auto outputs = mlp(cctorch::to_tensor(MNISTLoader::normalize_image(batch.images)));
-            auto loss = criterion(outputs, batch.labels);
-            optimizer.zero_grad();
-            loss.backward();
-            optimizer.step();
+            const auto &labels = batch->labels;
+            float loss;
+            {
+                cctorch::AutocastGuard autocast(precision);
+                loss = trainer.step(batch->images, labels);
+            }
             num_batches++;
             if (num_batches % 1 == 0)
             {
-                int correct = 0;
-                for (int j = 0; j < outputs.size(); j++)
-                {
-                    int mx = 0;
-                    for (int i = 0; i < outputs[j].size(); i++)
-                    {
-                        if (outputs[j][i].value() > outputs[j][mx].value())
-                        {
-                            mx = i;
-                        }
-                    }
-                    if (mx == batch.labels[j])
-                    {
-                        correct++;
-                    }
-                }
-
-                std::cout << "Epoch [" << epoch << "/" << epochs << "], Batch [" << num_batches << "], Loss: " << loss.value() << ", Accuracy: " << (static_cast<float>(correct) / batch.labels.size()) * 100 << "%";
-                auto l1p = mlp.linear1.parameters();
-                auto l2p = mlp.linear2.parameters();
-                auto max_l1 = std::max_element(l1p.begin(), l1p.end(), [&](const cctorch::Tensor &a, const cctorch::Tensor &b)
-                                               { return a.grad() < b.grad(); });
-                auto min_l1 = std::min_element(l1p.begin(), l1p.end(), [&](const cctorch::Tensor &a, const cctorch::Tensor &b)
-                                               { return a.grad() < b.grad(); });
-                auto max_l2 = std::max_element(l2p.begin(), l2p.end(), [&](const cctorch::Tensor &a, const cctorch::Tensor &b)
-                                               { return a.grad() < b.grad(); });
-                auto min_l2 = std::min_element(l2p.begin(), l2p.end(), [&](const cctorch::Tensor &a, const cctorch::Tensor &b)
-                                               { return a.grad() < b.grad(); });
-                std::cout << ", maxl1: " << max_l1->grad() << ", minl1: " << min_l1->grad() << ", maxl2: " << max_l2->grad() << ", minl2: " << min_l2->grad() << std::endl;
+                size_t correct = trainer.correct();
+
+                std::cout << "Epoch [" << epoch << "/" << epochs << "], Batch [" << num_batches << "], Loss: " << loss << ", Accuracy: " << (static_cast<float>(correct) / labels.size()) * 100 << "%";
+                // 权重梯度是连续缓冲区，直接扫描
+                const cctorch::DenseTensor &w1 = mlp.layer<0>().base().weight;
+                const cctorch::DenseTensor &w2 = mlp.layer<2>().base().weight;
+                auto [min_l1, max_l1] = std::minmax_element(w1.grad_ptr(), w1.grad_ptr() + w1.numel());
+                auto [min_l2, max_l2] = std::minmax_element(w2.grad_ptr(), w2.grad_ptr() + w2.numel());
+                std::cout << ", maxl1: " << *max_l1 << ", minl1: " << *min_l1 << ", maxl2: " << *max_l2 << ", minl2: " << *min_l2 << std::endl;
             }
             if (num_batches % 10 == 0)
             {
                 std::string model_filename = "mlp_epoch_" + std::to_string(epoch) + "_" + std::to_string(num_batches) + ".bin";
                 std::string full_path = models_path + "/" + model_filename;
-                mlp.save(full_path);
-                std::cout << "Model saved at epoch " << epoch << ", batch " << num_batches << std::endl;
+                mlp.snapshot(checkpointer.snapshot(), &optimizer);
+                if (base_checkpoint)
+                {
+                    checkpointer.commit(full_path + ".delta", base_checkpoint.get());
+                }
+                else
+                {
+                    checkpointer.commit(full_path);
+                    checkpointer.wait();
+                    base_checkpoint = std::make_unique<cctorch::Checkpoint>(full_path);
+                }
+                std::cout << "Model checkpoint queued at epoch " << epoch << ", batch " << num_batches << std::endl;
             }
+            cctorch::profiler::step();
         }
+        std::cout << "Epoch [" << epoch << "/" << epochs << "], Test Accuracy: " << evaluate(mlp, test_data) << "%" << std::endl;
     }
 
-    // 训练结束后保存最终模型
+    // 训练结束后等最后一个后台检查点写完，再保存最终模型
+    checkpointer.wait();
+    cctorch::profiler::stop();
+    if (cctorch::profiler::enabled())
+    {
+        cctorch::profiler::write_chrome_trace("mlp_trace.json");
+        cctorch::profiler::print_summary(std::cout);
+        std::cout << "Profiler trace saved as mlp_trace.json" << std::endl;
+    }
     mlp.save("mlp_final.bin");
     std::cout << "Final model saved as mlp_final.bin" << std::endl;
 
@@ -0,0 +1,129 @@
+#include "../../include/checkpoint.h"
+#include "../../include/idx_dataset.h"
+#include "../../include/quantize.h"
+#include "../../include/sequential.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// 训练后量化：用训练集前 N 张图片校准，把 fp32 检查点量化为 int8 检查点，
+// 然后在 t10k 上对比 fp32 和 int8 模型的准确率与吞吐：
+//     ./mnist_quantize ../models/mlp_final.bin mlp_int8.bin
+//     ./mnist_quantize ../models/mlp_final.bin mlp_int8.bin --data ../data --calibration 2000
+using MLP = cctorch::fixed::Sequential<cctorch::fixed::Linear<784, 128>,
+                                       cctorch::fixed::ReLU,
+                                       cctorch::fixed::Linear<128, 10>>;
+
+namespace
+{
+    int count_correct(const std::vector<float> &logits, const cctorch::IDXDataset &data, int classes)
+    {
+        int correct = 0;
+        for (size_t i = 0; i < data.size(); ++i)
+        {
+            const float *row = logits.data() + i * classes;
+            correct += std::max_element(row, row + classes) - row == data.labels()[i];
+        }
+        return correct;
+    }
+
+    template <typename F>
+    double seconds(F &&f)
+    {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <fp32 checkpoint> <output int8 checkpoint> [--data <dir>] [--calibration <images>]" << std::endl;
+        return 1;
+    }
+    std::string input = argv[1];
+    std::string output = argv[2];
+    std::string data_path = "../data";
+    size_t calibration_images = 1000;
+    for (int i = 3; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--data" && i + 1 < argc)
+        {
+            data_path = argv[++i];
+        }
+        else if (arg == "--calibration" && i + 1 < argc)
+        {
+            calibration_images = std::stoul(argv[++i]);
+        }
+        else
+        {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    try
+    {
+        auto train_data = cctorch::IDXDataset::train(data_path);
+        auto test_data = cctorch::IDXDataset::test(data_path);
+        if (train_data.image_size() != MLP::in_features || test_data.image_size() != MLP::in_features)
+        {
+            throw std::runtime_error("Unexpected image size in " + data_path);
+        }
+
+        // 校准数据和推理时的预处理相同（normalize_pixels 的默认参数，与训练一致）
+        calibration_images = std::min(calibration_images, train_data.size());
+        std::vector<float> calibration(calibration_images * MLP::in_features);
+        cctorch::normalize_pixels(train_data.pixels(), calibration.data(), calibration.size());
+
+        cctorch::Checkpoint checkpoint(input);
+        cctorch::QuantizedMLP quantized(checkpoint, calibration.data(), calibration_images);
+        quantized.save(output);
+        // 从文件重新读取，确认保存的模型本身可用
+        cctorch::QuantizedMLP int8(output);
+
+        MLP mlp;
+        mlp.load(input);
+
+        size_t num_images = test_data.size();
+        std::vector<float> images(num_images * MLP::in_features);
+        cctorch::normalize_pixels(test_data.pixels(), images.data(), images.size());
+        std::vector<float> fp32_logits(num_images * MLP::out_features);
+        std::vector<float> int8_logits(num_images * MLP::out_features);
+        double fp32_time = seconds([&]
+                                   { mlp.predict(images.data(), fp32_logits.data(), num_images); });
+        double int8_time = seconds([&]
+                                   { int8.predict(images.data(), int8_logits.data(), num_images); });
+
+        int agree = 0;
+        for (size_t i = 0; i < num_images; ++i)
+        {
+            const float *a = fp32_logits.data() + i * MLP::out_features;
+            const float *b = int8_logits.data() + i * MLP::out_features;
+            agree += std::max_element(a, a + MLP::out_features) - a == std::max_element(b, b + MLP::out_features) - b;
+        }
+        float fp32_accuracy = 100.0f * count_correct(fp32_logits, test_data, MLP::out_features) / num_images;
+        float int8_accuracy = 100.0f * count_correct(int8_logits, test_data, MLP::out_features) / num_images;
+        size_t fp32_bytes = (784 * 128 + 128 + 128 * 10 + 10) * sizeof(float);
+
+        std::cout << "Calibrated on " << calibration_images << " training images, saved " << output
+                  << " (int8 kernel: " << cctorch::igemm_kernel_name() << ")" << std::endl;
+        std::cout << "Weights: fp32 " << fp32_bytes << " bytes, int8 " << int8.weight_bytes() << " bytes ("
+                  << static_cast<float>(fp32_bytes) / int8.weight_bytes() << "x smaller)" << std::endl;
+        std::cout << "Test accuracy: fp32 " << fp32_accuracy << "%, int8 " << int8_accuracy << "% (diff "
+                  << int8_accuracy - fp32_accuracy << "), " << agree << "/" << num_images << " predictions agree" << std::endl;
+        std::cout << "Throughput: fp32 " << num_images / fp32_time << " images/s, int8 " << num_images / int8_time << " images/s" << std::endl;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Quantization failed: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
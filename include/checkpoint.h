@@ -0,0 +1,223 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "mapped_file.h"
+#include "optimizer.h"
+
+namespace cctorch
+{
+
+    // 检查点格式 v2（小端序）。头部和层表之后是按 64 字节对齐的连续参数块，
+    // 读取时整个文件 mmap 进来，参数块可以直接当作 float 数组使用，多个进程共享同一份页面。
+    // [offset] [type]              [value]          [description]
+    // 0000     char[8]             "CCTORCH\0"      魔数
+    // 0008     32 bit integer      2                格式版本
+    // 0012     32 bit integer      n                blob 个数
+    // 0016     64 bit integer      t                Adam 步数（没有优化器状态时为 -1）
+    // 0024     32 bit integer      flags            checkpoint_flag_delta 表示增量检查点
+    // 0028     32 bit integer      0                保留
+    // 0032     64 bit integer      base id          增量检查点对应的基准检查点的 id()，否则为 0
+    // 0040     ...                 0                保留，头部共 64 字节
+    // 0064     CheckpointEntry[n]                   层表，每项 64 字节
+    // xxxx     float[] / int8[]                     blob 数据，起始偏移均为 64 的倍数
+    constexpr char checkpoint_magic[8] = {'C', 'C', 'T', 'O', 'R', 'C', 'H', '\0'};
+    constexpr uint32_t checkpoint_version = 2;
+    constexpr size_t checkpoint_alignment = 64;
+    // 不属于任何层的 blob（优化器状态）使用的层编号
+    constexpr uint32_t checkpoint_no_layer = 0xffffffffu;
+    constexpr uint32_t checkpoint_flag_delta = 1;
+    // 增量检查点中每个 blob 按这么多个 float 分块比较，只保存变化的块
+    constexpr size_t checkpoint_delta_block = 1024;
+
+    enum class CheckpointKind : uint32_t
+    {
+        WEIGHT = 0,
+        BIAS = 1,
+        ADAM_M = 2, // 优化器状态按 parameters() 的顺序展平，层编号为 checkpoint_no_layer
+        ADAM_V = 3,
+        WEIGHT_SCALE = 4, // 量化层：每个输出通道的权重缩放系数
+        INPUT_QUANT = 5   // 量化层：输入的 [scale, zero_point]
+    };
+
+    enum class CheckpointDType : uint32_t
+    {
+        FLOAT32 = 0,
+        // 相对基准检查点同一 blob 的增量：变化块的位图 + 每个变化块的编码。
+        // 块内先与基准按位异或（微小的更新只改动低位），再按字节平面重排，最后压缩连续的 0 字节
+        DELTA_XOR = 1,
+        // 有符号 8 位整数，每个元素 1 字节（量化权重），不参与增量编码
+        INT8 = 2
+    };
+
+    struct CheckpointEntry
+    {
+        uint32_t layer;      // 层编号（从 0 开始）
+        uint32_t layer_type; // 与旧格式相同：1 表示 Linear，优化器状态为 0；量化层见 quantize.h
+        uint32_t kind;       // CheckpointKind
+        uint32_t dtype;      // CheckpointDType
+        uint32_t ndim;
+        int32_t shape[4];
+        uint32_t reserved;
+        uint64_t offset;   // 相对文件开头
+        uint64_t bytes;
+        uint64_t checksum; // 文件中 blob 字节（增量 blob 为编码后的字节）的 FNV-1a 64
+    };
+    static_assert(sizeof(CheckpointEntry) == 64, "CheckpointEntry must stay 64 bytes");
+
+    uint64_t checkpoint_checksum(const void *data, size_t bytes);
+
+    class Checkpoint;
+
+    // 收集要保存的参数块。add 时把数值拷贝一份，所以写文件时不再访问模型。
+    // clear() 之后再次填充会复用之前的缓冲区，校验和在 write 时才计算。
+    //
+    //     cctorch::CheckpointWriter ckpt;
+    //     linear1.save_to_checkpoint(ckpt);
+    //     linear2.save_to_checkpoint(ckpt);
+    //     ckpt.add_optimizer(optimizer); // 可选，用于恢复训练
+    //     ckpt.write("mlp.ckpt");
+    class CheckpointWriter
+    {
+    public:
+        // 开始新的一层，返回层编号
+        uint32_t begin_layer(uint32_t layer_type);
+        // 追加一个 blob 并返回它的缓冲区，调用方直接写入 shape 对应个数的 float
+        float *allocate(uint32_t layer, CheckpointKind kind, const std::vector<int> &shape);
+        void add(uint32_t layer, CheckpointKind kind, const std::vector<int> &shape, const float *values);
+        void add(uint32_t layer, CheckpointKind kind, const std::vector<int> &shape, const std::vector<float> &values);
+        // 同 allocate，但 blob 的 dtype 为 INT8，调用方写入 shape 对应个数的 int8_t
+        int8_t *allocate_int8(uint32_t layer, CheckpointKind kind, const std::vector<int> &shape);
+        void add_optimizer(const Adam &optimizer);
+
+        // 清空内容但保留缓冲区
+        void clear();
+
+        // 写到 filename.tmp 并 fsync，再原子地重命名为 filename，读者不会看到写了一半的文件。
+        // 头部和层表一次写出，随后每个 blob 一次写出
+        void write(const std::string &filename);
+        // 写增量检查点：与 base 中层、种类、形状都相同的 blob 只保存变化的块（压缩后），其余照常完整保存。
+        // 读取时需要同一个 base：Checkpoint(filename, base)
+        void write_delta(const std::string &filename, const Checkpoint &base);
+
+        size_t num_blobs() const { return count; }
+
+    private:
+        struct blob
+        {
+            CheckpointEntry entry;
+            std::vector<float> values; // INT8 blob 也存放在这里，按字节使用
+            CheckpointDType dtype = CheckpointDType::FLOAT32;
+            uint64_t bytes = 0; // 原始数据的字节数（增量编码前）
+        };
+
+        blob &append_blob(uint32_t layer, CheckpointKind kind, const std::vector<int> &shape, CheckpointDType dtype);
+
+        void write_file(const std::string &filename, const Checkpoint *base);
+
+        std::vector<blob> blobs; // 前 count 个有效，其余是留待复用的缓冲区
+        size_t count = 0;
+        std::vector<std::vector<uint8_t>> encoded; // write_delta 的编码缓冲区，同样复用
+        std::vector<uint32_t> layer_types;
+        int64_t adam_t = -1;
+    };
+
+    // 后台保存检查点：训练线程只把参数拷贝进快照缓冲区，序列化、fsync 和重命名都在后台线程完成。
+    // 两个快照缓冲区交替使用，一个正在写盘时另一个可以填充；上一次保存还没完成时 commit 会等待（反压），
+    // 所以同一时刻最多只有一个保存在进行。
+    //
+    //     cctorch::AsyncCheckpointWriter checkpointer;
+    //     ...
+    //     auto &snapshot = checkpointer.snapshot();
+    //     linear1.save_to_checkpoint(snapshot);
+    //     linear2.save_to_checkpoint(snapshot);
+    //     checkpointer.commit("mlp.ckpt");
+    class AsyncCheckpointWriter
+    {
+    public:
+        AsyncCheckpointWriter();
+        // 等待正在进行的保存完成
+        ~AsyncCheckpointWriter();
+
+        AsyncCheckpointWriter(const AsyncCheckpointWriter &) = delete;
+        AsyncCheckpointWriter &operator=(const AsyncCheckpointWriter &) = delete;
+
+        // 返回一个已清空的快照缓冲区，在 commit 之前填充
+        CheckpointWriter &snapshot();
+        // 把快照交给后台线程写入 filename；上一次保存未完成时先等待。
+        // base 非空时写增量检查点，base 必须存活到这次保存完成（wait() 返回）
+        void commit(const std::string &filename, const Checkpoint *base = nullptr);
+        // 等待正在进行的保存完成。后台写入失败时在这里（或下一次 commit 时）抛出异常
+        void wait();
+        bool busy() const;
+
+    private:
+        void worker_loop();
+        void rethrow_error();
+
+        CheckpointWriter buffers[2];
+        int front = 0; // 训练线程正在填充的缓冲区
+
+        mutable std::mutex mutex;
+        std::condition_variable cv;
+        CheckpointWriter *pending = nullptr; // 后台线程正在（或即将）写入的快照
+        std::string pending_path;
+        const Checkpoint *pending_base = nullptr;
+        std::exception_ptr error;
+        bool stopping = false;
+        std::thread worker; // 最后构造，启动时其余成员都已初始化
+    };
+
+    // 只读、内存映射的检查点。打开时校验头部、层表边界和（默认）每个 blob 的校验和。
+    class Checkpoint
+    {
+    public:
+        explicit Checkpoint(const std::string &filename, bool verify = true);
+        // 打开增量检查点，变化的块叠加到 base 上解码（base 可以本身也是增量检查点）
+        Checkpoint(const std::string &filename, const Checkpoint &base, bool verify = true);
+
+        // 文件是否以 v2 魔数开头（用于和旧格式区分）
+        static bool is_checkpoint(const std::string &filename);
+
+        bool is_delta() const { return flags & checkpoint_flag_delta; }
+        // 头部和层表（含每个 blob 的校验和）的哈希，增量检查点用它确认基准没有被换掉
+        uint64_t id() const { return checkpoint_id; }
+
+        const std::vector<CheckpointEntry> &entries() const { return table; }
+        // 找到指定层的指定 blob，不存在时抛出异常
+        const CheckpointEntry &find(uint32_t layer, CheckpointKind kind) const;
+        // 不存在时返回 nullptr
+        const CheckpointEntry *lookup(uint32_t layer, CheckpointKind kind) const;
+        // blob 的 float 数据：完整 blob 直接指向映射的文件，增量 blob 指向解码后的缓冲区
+        const float *values(const CheckpointEntry &entry) const;
+        // INT8 blob 的数据，dtype 不是 INT8 时抛出异常
+        const int8_t *int8_values(const CheckpointEntry &entry) const;
+
+        bool has_optimizer_state() const { return adam_t >= 0; }
+        // 恢复 Adam 的 m、v 和 t，要求参数个数一致
+        void load_optimizer(Adam &optimizer) const;
+
+    private:
+        void open(bool verify);
+        void decode(const Checkpoint &base);
+
+        std::string path;
+        MappedFile file;
+        std::vector<CheckpointEntry> table;
+        std::vector<std::vector<float>> decoded; // 与 table 对应，只有增量 blob 非空
+        int64_t adam_t = -1;
+        uint32_t flags = 0;
+        uint64_t base_id = 0;
+        uint64_t checkpoint_id = 0;
+    };
+
+} // namespace cctorch
+
+#endif // CHECKPOINT_H
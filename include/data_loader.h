@@ -0,0 +1,107 @@
+#ifndef DATA_LOADER_H
+#define DATA_LOADER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "tensor.h"
+#include "dense_tensor.h"
+#include "idx_dataset.h"
+
+namespace cctorch
+{
+
+    struct DataLoaderOptions
+    {
+        size_t batch_size = 64;
+        size_t num_workers = 1;
+        size_t prefetch = 4;         // 预取的 batch 个数（缓冲区个数），至少为 2
+        bool shuffle = true;         // 每个 epoch 使用新的样本顺序
+        bool drop_last = false;      // 丢弃每个 epoch 末尾不满 batch_size 的 batch
+        bool scalar_tensors = false; // 同时填充标量 Tensor 形式，供逐样本的 Model 前向使用
+        float mean = 0.0f;           // 像素缩放到 [0, 1] 后减去 mean 再除以 std
+        float std = 1.0f;
+        uint64_t seed = 0;           // 打乱顺序的随机种子，0 表示随机
+    };
+
+    // 一个准备好的 batch。缓冲区属于 DataLoader，在下一次调用 next() 时被回收复用。
+    struct DataBatch
+    {
+        DenseTensor images;                       // [size, image_size]，已按 mean/std 归一化；requires_grad = false
+        std::vector<std::vector<Tensor>> tensors; // 与 images 相同的数据（仅在 scalar_tensors 时填充）
+        std::vector<unsigned char> labels;
+        size_t size = 0;
+        size_t epoch = 0; // 从 0 开始
+        size_t index = 0; // 在本 epoch 中的编号
+    };
+
+    // 后台预取的数据加载器：N 个工作线程提前完成打乱、切片、归一化和转换，训练线程只取现成的 batch。
+    //
+    //     cctorch::DataLoader loader(train_data, options);
+    //     for (int epoch = 0; epoch < epochs; ++epoch)
+    //     {
+    //         while (const cctorch::DataBatch *batch = loader.next())
+    //         {
+    //             auto outputs = mlp(batch->images);
+    //             ...
+    //         }
+    //     }
+    //
+    // batch 按全局序号依次放入 prefetch 个槽位组成的环形缓冲区，序号 t 固定使用槽位 t % prefetch，
+    // 每个槽位用一个原子序号交接（无锁），所以多个工作线程并行生产时顺序仍然确定。
+    class DataLoader
+    {
+    public:
+        DataLoader(const IDXDataset &dataset, const DataLoaderOptions &options);
+        ~DataLoader();
+
+        DataLoader(const DataLoader &) = delete;
+        DataLoader &operator=(const DataLoader &) = delete;
+
+        // 取出当前 epoch 的下一个 batch（必要时等待）。本 epoch 已经取完时返回 nullptr，
+        // 之后的调用从下一个 epoch 开始。返回的指针在下一次调用 next() 之前有效。
+        const DataBatch *next();
+
+        size_t batches_per_epoch() const { return per_epoch; }
+        size_t epoch() const { return consumer_epoch; }
+
+    private:
+        struct slot
+        {
+            // 2t 表示空闲、等待序号 t 的 batch；2t + 1 表示序号 t 的 batch 已就绪
+            std::atomic<uint64_t> state;
+            DataBatch batch;
+        };
+
+        void worker_loop();
+        void fill(DataBatch &batch, uint64_t ticket);
+        std::shared_ptr<const std::vector<uint32_t>> order_for(size_t epoch);
+        // 等待 state 变为 expected，DataLoader 停止时返回 false
+        bool wait_for(const std::atomic<uint64_t> &state, uint64_t expected) const;
+
+        const IDXDataset &dataset;
+        DataLoaderOptions options;
+        size_t per_epoch;
+        std::vector<std::unique_ptr<slot>> slots;
+        std::vector<std::thread> workers;
+        std::atomic<uint64_t> next_ticket; // 工作线程领取的下一个序号
+        std::atomic<bool> stopping;
+
+        uint64_t consumer_ticket = 0; // 训练线程下一个要取的序号
+        size_t consumer_epoch = 0;
+        size_t consumer_index = 0;
+        bool holding = false; // 是否还持有上一次返回的槽位
+
+        std::mutex order_mutex;
+        std::map<size_t, std::shared_ptr<const std::vector<uint32_t>>> orders; // 正在使用的各 epoch 的样本顺序
+        std::atomic<size_t> oldest_epoch;
+    };
+
+} // namespace cctorch
+
+#endif // DATA_LOADER_H
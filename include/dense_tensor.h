@@ -0,0 +1,248 @@
+#ifndef DENSE_TENSOR_H
+#define DENSE_TENSOR_H
+
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <functional>
+#include "tensor.h"
+#include "half.h"
+
+namespace cctorch
+{
+
+    struct dense_data;
+
+    // 连续存储的 N 维张量：一块 64 字节对齐的 float 缓冲区 + 同样大小的梯度缓冲区。
+    // 与标量 Tensor 不同，计算图按算子记录（每个 matmul/add/relu... 一个节点），而不是按元素记录。
+    class DenseTensor
+    {
+    public:
+        enum class back_type
+        {
+            NONE,
+            FROM_TENSORS,
+            CAST,
+            MATMUL,
+            LINEAR,
+            LINEAR_RELU,
+            ADD,
+            ADD_ROW,
+            RELU,
+            EXP,
+            LOG,
+            SUM,
+            CROSS_ENTROPY,
+            MSE,
+            CHECKPOINT
+        };
+
+        std::shared_ptr<dense_data> data;
+
+        DenseTensor() = default;
+        // requires_grad = false 的叶子不分配梯度缓冲区，反向传播到这里截断，不为它计算 dX（用于输入的一批数据）
+        explicit DenseTensor(const std::vector<int> &shape, float fill = 0.0f, bool requires_grad = true);
+        DenseTensor(const std::vector<int> &shape, const std::vector<float> &values, bool requires_grad = true);
+
+        const std::vector<int> &shape() const;
+        const std::vector<int> &strides() const;
+        int dim() const;
+        size_t numel() const;
+
+        // fp32 张量的数值；半精度张量没有 float 缓冲区，调用时抛出异常（用 half_ptr()、value(i) 或 to()）
+        float *value_ptr();
+        const float *value_ptr() const;
+        // 数值的存储精度：BF16/FP16 张量的数值按位存放在 half_ptr()，梯度总是 fp32
+        Precision dtype() const;
+        uint16_t *half_ptr();
+        const uint16_t *half_ptr() const;
+        float *grad_ptr();
+        const float *grad_ptr() const;
+        // 是否有梯度缓冲区；requires_grad = false 的叶子和 NoGradGuard 下算出的张量没有
+        bool requires_grad() const;
+
+        // 按存储精度转换成 float
+        float value(size_t i) const;
+        float grad(size_t i) const;
+        float item() const;
+
+        bool topo_decent() const;
+
+        // seed 为输出梯度的初值（梯度累加时按 micro-batch 所占的比例缩放损失）。
+        // NoGradGuard 作用域内算出的张量是没有梯度缓冲区的叶子，梯度传到那里就截断
+        void backward(float seed = 1.0f);
+
+        // 转换存储精度，记录一个 CAST 节点（反向时梯度原样传回，仍为 fp32）；精度相同时返回自身。
+        // 源张量没有梯度缓冲区时结果是不记录计算图的叶子
+        DenseTensor to(Precision precision) const;
+
+        // AutocastGuard 作用域内 matmul/linear/linear_relu 先把激活输入转换成半精度，输出也以半精度存储；
+        // 叶子（权重、偏置、输入）保持 fp32，GEMM 打包时直接读取，不产生副本。relu 保持输入的精度；其余算子先把半精度输入转换回 fp32。
+        // 逐元素加法；other 为一维且长度等于最后一维时按行广播（用于偏置）
+        DenseTensor operator+(const DenseTensor &other) const;
+        DenseTensor matmul(const DenseTensor &other) const;
+        // 融合的全连接算子：this[batch, in] * weight[in, out] + bias[out]，只记录一个节点
+        DenseTensor linear(const DenseTensor &weight, const DenseTensor &bias) const;
+        // linear 后接 relu 的融合算子：激活在同一个节点里完成，不产生中间张量
+        DenseTensor linear_relu(const DenseTensor &weight, const DenseTensor &bias) const;
+        DenseTensor relu() const;
+        DenseTensor exp() const;
+        DenseTensor log() const;
+        DenseTensor sum() const;
+        // 融合的 softmax 交叉熵：this 为 [batch, classes] 的 logits，返回 batch 平均损失 [1]。
+        // 用减去行最大值的 log-sum-exp 保证数值稳定，反向梯度为 (softmax - onehot) / batch。
+        DenseTensor cross_entropy(const std::vector<unsigned char> &targets) const;
+        // 融合的均方误差：mean((this - targets)^2)，返回 [1]，反向梯度为 2(p - t) / N
+        DenseTensor mse(const DenseTensor &targets) const;
+
+        // 激活检查点：前向时在 NoGradGuard 下执行 segment(*this)，段内的中间结果算完即释放，只记录一个保存输入和输出的节点；
+        // 反向时用同样的输入（和前向时的 AutocastGuard 设置）重新执行 segment 建立段内的计算图，
+        // 把输出梯度传回段内参数和输入。以大约多一次段的前向换取段内激活的内存。
+        // segment 必须是确定性的，并且它引用的模型要存活到反向结束；NoGradGuard 作用域内直接返回 segment(*this)
+        using Segment = std::function<DenseTensor(const DenseTensor &)>;
+        DenseTensor checkpointed(Segment segment) const;
+
+        // 清零梯度；有标量视图时视图节点的梯度一起清零
+        void zero_grad();
+        void drop_par();
+
+        // 参数的标量视图：每个元素一个标量 Tensor 叶子，供按样本的标量 Tensor 路径参与计算图，第一次调用时创建（线程安全）。
+        // 视图节点的梯度由 merge_view_grad() 合并进本张量的梯度缓冲区，数值由 refresh_view() 从本张量刷新，
+        // 直接修改视图节点的数值不会写回。视图在张量存活期间一直有效，反向传播不会释放它
+        const std::vector<Tensor> &scalar_view() const;
+        bool has_scalar_view() const;
+        // 把视图节点的梯度累加到梯度缓冲区并清零视图梯度；没有视图时什么也不做
+        void merge_view_grad();
+        // 把当前数值写回视图节点（原地修改参数之后调用）；没有视图时什么也不做
+        void refresh_view();
+        // 把旧接口的标量参数列表（Model::parameters()）换成连续参数：整段是某个参数的标量视图时直接返回那个参数，
+        // 其余相邻的标量 Tensor 收集成一个一维参数，它们本身作为这个参数的标量视图
+        static std::vector<DenseTensor> from_parameters(const std::vector<Tensor> &tensors);
+
+        // 与标量 Tensor 互相转换。from_tensors 得到的张量在反向传播时会把梯度累加回源 Tensor 的 grad。
+        static DenseTensor from_tensors(const std::vector<Tensor> &tensors);
+        static DenseTensor from_tensors(const std::vector<std::vector<Tensor>> &tensors);
+        std::vector<Tensor> to_tensors() const;
+        std::vector<std::vector<Tensor>> to_tensors_2d() const;
+
+        // 单个节点的前向/反向公式，供图捕获重放使用：
+        // forward_op 用父节点的当前值重新计算本节点的值（写入已有缓冲区，FROM_TENSORS 重新读取源 Tensor），
+        // targets 只有 CROSS_ENTROPY 节点需要；backward_op 把本节点的梯度累加到父节点，不修改图结构
+        void forward_op(const std::vector<unsigned char> *targets = nullptr);
+        void backward_op() const;
+
+    private:
+        DenseTensor(const std::vector<int> &shape, DenseTensor par1, DenseTensor par2, back_type back, Precision dtype = Precision::FP32);
+        DenseTensor(const std::vector<int> &shape, DenseTensor par1, DenseTensor par2, DenseTensor par3, back_type back, Precision dtype = Precision::FP32);
+
+        // 从本节点开始按拓扑计数反向传播，调用前本节点的梯度已经设好
+        void propagate() const;
+        void _backward() const;
+        void from_tensors_backward() const;
+        void cast_backward() const;
+        void matmul_backward() const;
+        void linear_backward() const;
+        void linear_relu_backward() const;
+        void add_backward() const;
+        void add_row_backward() const;
+        void relu_backward() const;
+        void exp_backward() const;
+        void log_backward() const;
+        void sum_backward() const;
+        void cross_entropy_backward() const;
+        void mse_backward() const;
+        void checkpoint_backward() const;
+    };
+
+    // 记录 DenseTensor 算子的执行顺序（用于图捕获，按线程生效）。
+    // 作用域内每个记录计算图的算子把结果节点按创建顺序追加到 nodes，父节点总是先于子节点出现，
+    // 所以 nodes 就是一个合法的前向拓扑序，逆序即为反向顺序。
+    class DenseTrace
+    {
+    public:
+        class Scope
+        {
+        public:
+            explicit Scope(DenseTrace &trace);
+            ~Scope();
+
+            Scope(const Scope &) = delete;
+            Scope &operator=(const Scope &) = delete;
+
+        private:
+            DenseTrace &trace;
+            DenseTrace *previous;
+        };
+
+        // 当前线程正在记录的 trace，没有时返回 nullptr
+        static DenseTrace *current();
+
+        std::vector<DenseTensor> nodes;
+    };
+
+    // 混合精度作用域（按线程生效）：作用域内 DenseTensor 的矩阵乘法算子以 precision 存储激活，
+    // 参数（主权重）、梯度和优化器状态仍然是 fp32，权重不复制成半精度；GEMM 在打包时把半精度操作数转换回 float 并以 fp32 累加。
+    //
+    //     cctorch::AutocastGuard autocast(cctorch::Precision::BF16);
+    //     float loss = train_step(batch->images, batch->labels);
+    //
+    // BF16 与 fp32 的指数范围相同，可以直接替换；FP16 的最大值只有 65504，前向激活可能溢出成 inf。
+    // 梯度在这里始终以 fp32 存储和累加，所以不需要 loss scaling
+    class AutocastGuard
+    {
+    public:
+        explicit AutocastGuard(Precision precision = Precision::BF16);
+        ~AutocastGuard();
+
+        AutocastGuard(const AutocastGuard &) = delete;
+        AutocastGuard &operator=(const AutocastGuard &) = delete;
+
+        // 当前线程的混合精度设置，不在作用域内时为 FP32
+        static Precision active();
+
+    private:
+        Precision previous;
+    };
+
+    struct aligned_deleter
+    {
+        void operator()(void *ptr) const;
+    };
+
+    using aligned_buffer = std::unique_ptr<float[], aligned_deleter>;
+    using half_buffer = std::unique_ptr<uint16_t[], aligned_deleter>;
+
+    // 分配 n 个 float 的 64 字节对齐缓冲区，并清零
+    aligned_buffer make_aligned_buffer(size_t n);
+    // 分配 n 个 16 位元素的 64 字节对齐缓冲区，并清零
+    half_buffer make_aligned_half_buffer(size_t n);
+
+    struct dense_data
+    {
+        std::vector<int> shape;
+        std::vector<int> strides;
+        size_t numel;
+        Precision dtype;
+        aligned_buffer value; // 仅 FP32
+        half_buffer half;     // 仅 BF16/FP16
+        aligned_buffer grad;
+        DenseTensor par1;
+        DenseTensor par2;
+        DenseTensor par3; // 仅 LINEAR/LINEAR_RELU 使用（偏置）
+        unsigned int sons;
+        DenseTensor::back_type back;
+        std::vector<Tensor> source; // FROM_TENSORS 节点对应的标量 Tensor
+        aligned_buffer partials;    // CROSS_ENTROPY/MSE：输出对 par1 每个元素的偏导；LINEAR_RELU：反向时屏蔽后的梯度
+        DenseTensor::Segment segment;                      // CHECKPOINT：反向时重新执行的段
+        Precision segment_precision = Precision::FP32;     // CHECKPOINT：前向时的混合精度设置
+        std::shared_ptr<std::vector<Tensor>> view;         // 参数的标量视图，用 atomic_load/atomic_compare_exchange 访问
+
+        explicit dense_data(const std::vector<int> &shape, bool with_grad = true, Precision dtype = Precision::FP32);
+        dense_data(const std::vector<int> &shape, DenseTensor par1, DenseTensor par2, DenseTensor::back_type back, Precision dtype = Precision::FP32);
+        dense_data(const std::vector<int> &shape, DenseTensor par1, DenseTensor par2, DenseTensor par3, DenseTensor::back_type back, Precision dtype = Precision::FP32);
+        ~dense_data(); // 存活节点计数，并注销标量视图
+    };
+
+} // namespace cctorch
+
+#endif // DENSE_TENSOR_H
@@ -0,0 +1,39 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+#include "half.h"
+
+namespace cctorch
+{
+
+    /**
+     * 单精度矩阵乘法（行主序）：C = alpha * op(A) * op(B) + beta * C
+     * op(A) 为 m x k，op(B) 为 k x n，C 为 m x n。
+     * 内部按 KC/MC/NC 分块并打包成面板，再由寄存器分块的微内核计算；
+     * 运行时检测到 AVX2+FMA 时使用向量化内核，否则使用标量内核。
+     * @param trans_a 为 true 时 A 按 k x m 存储并取转置
+     * @param trans_b 为 true 时 B 按 n x k 存储并取转置
+     * @param lda/ldb/ldc 各矩阵的行跨度（以 float 计）
+     */
+    void sgemm(bool trans_a, bool trans_b, int m, int n, int k,
+               float alpha, const float *a, int lda,
+               const float *b, int ldb,
+               float beta, float *c, int ldc);
+
+    /**
+     * 同 sgemm，但 A、B 的元素类型分别由 a_type、b_type 指定（BF16/FP16 时按 bfloat16/float16 解释）。
+     * 半精度元素在打包面板时转换成 float，乘加和 C 仍然是 fp32：只减少读取 A、B 的内存带宽，不降低累加精度
+     */
+    void gemm(bool trans_a, bool trans_b, int m, int n, int k,
+              float alpha, const void *a, Precision a_type, int lda,
+              const void *b, Precision b_type, int ldb,
+              float beta, float *c, int ldc);
+
+    /**
+     * 当前进程是否使用 AVX2/FMA 微内核
+     */
+    bool gemm_uses_avx2();
+
+} // namespace cctorch
+
+#endif // GEMM_H
@@ -0,0 +1,118 @@
+#ifndef GRAPH_ARENA_H
+#define GRAPH_ARENA_H
+
+#include <cstddef>
+#include <vector>
+#include <functional>
+
+namespace cctorch
+{
+
+    // 标量 Tensor 计算图节点的 bump 分配器。
+    // 训练循环里每个 batch 打开一个 Scope，期间当前线程创建的中间节点（Tensor 的运算结果）都从 arena 分配，
+    // 省掉每个节点一次 malloc/free；参数等叶子节点和 DenseTensor 仍在普通堆上。
+    //
+    // arena 只替换了内存来源，节点的生命周期不变：每个节点仍由 shared_ptr 的引用计数逐个析构
+    // （原子减计数、释放父节点引用），块的 live 计数归零后才能复用。Scope 结束时把块整体收回
+    // （O(块数)，不逐个访问节点），没有存活节点的块留给下一个 batch。
+    // 其他线程（例如 Model::set_thread_pool 的工作线程）创建的节点不经过这里。
+    //
+    //     cctorch::GraphArena arena;
+    //     for (...)
+    //     {
+    //         cctorch::GraphArena::Scope scope(arena);
+    //         auto outputs = mlp(inputs);
+    //         ...
+    //     }
+    //
+    // Scope 要在本轮的 Tensor 之前声明，让它们先析构、块在 reset 时已经空闲。
+    // 如果 Scope 结束时还有节点存活（例如把 loss 保存到了循环外），对应的块不会被复用，
+    // 而是在最后一个节点释放时归还系统，所以不会产生悬空指针。
+    class GraphArena
+    {
+    public:
+        // 每块 1 MB，并按 1 MB 对齐
+        static constexpr size_t block_size = size_t(1) << 20;
+
+        GraphArena();
+        ~GraphArena();
+
+        GraphArena(const GraphArena &) = delete;
+        GraphArena &operator=(const GraphArena &) = delete;
+
+        // 在当前线程把 arena 设为活动 arena，析构时恢复之前的活动 arena 并回收本次分配的内存
+        class Scope
+        {
+        public:
+            explicit Scope(GraphArena &arena);
+            ~Scope();
+
+            Scope(const Scope &) = delete;
+            Scope &operator=(const Scope &) = delete;
+
+        private:
+            GraphArena &arena;
+            GraphArena *previous;
+        };
+
+        // 当前线程的活动 arena，没有时返回 nullptr
+        static GraphArena *current();
+
+        void *allocate(size_t bytes, size_t align);
+        static void deallocate(void *ptr);
+
+        // 回收所有块：没有存活节点的块留待复用，仍有存活节点的块交给最后一个节点释放
+        void reset();
+
+        size_t bytes_used() const;
+        size_t bytes_reserved() const;
+
+    private:
+        struct block_header;
+
+        block_header *new_block();
+
+        std::vector<block_header *> blocks;
+        size_t current_block;
+        size_t offset;
+    };
+
+    // 供 std::allocate_shared 使用的分配器
+    template <class T>
+    struct arena_allocator
+    {
+        using value_type = T;
+
+        GraphArena *arena;
+
+        explicit arena_allocator(GraphArena *arena) : arena(arena) {}
+        template <class U>
+        arena_allocator(const arena_allocator<U> &other) : arena(other.arena) {}
+
+        T *allocate(size_t n)
+        {
+            return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(T *ptr, size_t)
+        {
+            GraphArena::deallocate(ptr);
+        }
+
+        template <class U>
+        bool operator==(const arena_allocator<U> &other) const { return arena == other.arena; }
+        template <class U>
+        bool operator!=(const arena_allocator<U> &other) const { return arena != other.arena; }
+    };
+
+    // 在 arena 作用域内执行 fn
+    template <class Fn>
+    auto with_arena(GraphArena &arena, Fn &&fn) -> decltype(fn())
+    {
+        GraphArena::Scope scope(arena);
+        return fn();
+    }
+
+} // namespace cctorch
+
+#endif // GRAPH_ARENA_H
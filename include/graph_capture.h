@@ -0,0 +1,94 @@
+#ifndef GRAPH_CAPTURE_H
+#define GRAPH_CAPTURE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "dense_tensor.h"
+#include "loss.h"
+#include "model.h"
+
+namespace cctorch
+{
+
+    // 静态训练步的图捕获与重放（DenseTensor 路径）。
+    // 第一次调用时在 DenseTrace 下 eager 地执行一次前向，把 model 和 CrossEntropyLoss 产生的算子节点冻结成执行计划：
+    // 每个节点保留自己的值/梯度缓冲区作为固定槽位，记录顺序就是前向顺序。之后每一步只把新 batch 拷进输入槽位，
+    // 按顺序重算每个节点，再逆序执行反向公式，不构建计算图、不分配内存、不做拓扑排序。
+    // 参数梯度照常累加到参数的梯度缓冲区上，所以 zero_grad / optimizer.step() 的用法不变。
+    //
+    //     cctorch::GraphCapture train_step(mlp, criterion);
+    //     for (...)
+    //     {
+    //         optimizer.zero_grad();
+    //         float loss = train_step(batch->images, batch->labels);
+    //         optimizer.step();
+    //     }
+    //
+    // 每次重放前都做两项廉价的检查：输入形状或标签个数与捕获时不同（例如每个 epoch 最后一个不满的 batch）时
+    // 这一步退回 eager 执行，计划保持不变；model.dense_parameters() 返回的参数张量不再是捕获时的那些
+    // （例如替换了某层的 weight）时丢弃计划重新捕获。
+    // 控制流的变化（forward 按数据走不同的分支）只有重新记录前向才能发现：每 verify_interval 次重放记录一次并和计划比较，
+    // 算子序列、形状或参数绑定变了就改用新的记录。两次检查之间计划可能已经过时并被静默重放，
+    // 所以非 0 的间隔只适用于真正静态的图；不能确定时传 1，代价是每一步多一次记录下来的前向。
+    // 模型里除输入和参数之外的叶子张量按捕获时的值固定。
+    // 在 AutocastGuard 作用域内调用时计划按该精度捕获，精度设置改变后下一步自动重新捕获。
+    class GraphCapture
+    {
+    public:
+        /**
+         * @param verify_interval 每隔多少次重放重新记录前向、检查计划是否仍然有效，0 表示从不检查（只做廉价检查）
+         */
+        GraphCapture(Model &model, CrossEntropyLoss &criterion, size_t verify_interval = 100);
+
+        GraphCapture(const GraphCapture &) = delete;
+        GraphCapture &operator=(const GraphCapture &) = delete;
+
+        // 一次前向 + 反向，返回 batch 平均损失。反向以 loss_scale 为起点，梯度累加时传入这个 micro-batch 所占的比例
+        float operator()(const DenseTensor &input, const std::vector<unsigned char> &targets, float loss_scale = 1.0f);
+
+        // 最近一步的模型输出（logits），重放时指向计划内的槽位，下一步会被覆盖
+        const DenseTensor &output() const { return last_output; }
+
+        bool captured() const { return !plan.empty(); }
+        // 丢弃计划，下一步重新捕获（例如替换了模型的参数之后）
+        void invalidate();
+
+        size_t captures() const { return num_captures; }
+        size_t replays() const { return num_replays; }
+        size_t eager_steps() const { return num_eager; }
+
+    private:
+        // 前向记录的结构指纹：每个节点的算子、存储精度、形状、父节点位置，以及绑定的参数（叶子和 FROM_TENSORS 的源 Tensor）
+        std::vector<int64_t> signature(const std::vector<DenseTensor> &nodes, const DenseTensor &input) const;
+        void adopt(DenseTrace &trace, const DenseTensor &input, const DenseTensor &output, const DenseTensor &loss, std::vector<int64_t> sig);
+        // 模型当前的参数张量是否还是捕获时的那些
+        bool parameters_changed();
+        void run_backward(float loss_scale);
+        float eager(const DenseTensor &input, const std::vector<unsigned char> &targets, float loss_scale);
+        float replay(const DenseTensor &input, const std::vector<unsigned char> &targets, float loss_scale);
+        // 在 DenseTrace 下前向一次；verify 为 true 且与计划一致时丢弃记录并返回 false
+        bool trace(const DenseTensor &input, const std::vector<unsigned char> &targets, bool verify);
+
+        Model &model;
+        CrossEntropyLoss &criterion;
+        size_t verify_interval;
+
+        std::vector<DenseTensor> plan;   // 前向顺序的算子节点
+        std::vector<int64_t> plan_signature;
+        std::vector<DenseTensor> plan_parameters; // 捕获时 model.dense_parameters() 的结果
+        DenseTensor input_slot;
+        DenseTensor plan_output;
+        DenseTensor plan_loss;
+        DenseTensor last_output;
+        Precision plan_precision = Precision::FP32;
+
+        size_t since_verify = 0;
+        size_t num_captures = 0;
+        size_t num_replays = 0;
+        size_t num_eager = 0;
+    };
+
+} // namespace cctorch
+
+#endif // GRAPH_CAPTURE_H
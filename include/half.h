@@ -0,0 +1,73 @@
+#ifndef HALF_H
+#define HALF_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace cctorch
+{
+
+    // DenseTensor 数值的存储精度。计算（GEMM 累加、逐元素运算）始终在 fp32 中进行，半精度只用于存储
+    enum class Precision : uint8_t
+    {
+        FP32,
+        BF16, // 1 位符号 + 8 位指数 + 7 位尾数：与 fp32 指数范围相同，不需要 loss scaling
+        FP16  // IEEE 754 binary16：5 位指数 + 10 位尾数，最大 65504
+    };
+
+    const char *precision_name(Precision precision);
+    // 每个元素的字节数
+    size_t precision_size(Precision precision);
+
+    // 半精度数值只是 16 位的位模式，用不同的类型区分两种格式
+    struct bfloat16
+    {
+        uint16_t bits;
+    };
+
+    struct float16
+    {
+        uint16_t bits;
+    };
+
+    inline float to_float(float value) { return value; }
+
+    inline float to_float(bfloat16 value)
+    {
+        uint32_t u = static_cast<uint32_t>(value.bits) << 16;
+        float f;
+        std::memcpy(&f, &u, sizeof(f));
+        return f;
+    }
+
+    // 就近舍入到偶数；NaN 保持为（安静的）NaN
+    inline bfloat16 to_bfloat16(float value)
+    {
+        uint32_t u;
+        std::memcpy(&u, &value, sizeof(u));
+        if ((u & 0x7fffffffu) > 0x7f800000u)
+        {
+            return {static_cast<uint16_t>((u >> 16) | 0x40)};
+        }
+        u += 0x7fffu + ((u >> 16) & 1);
+        return {static_cast<uint16_t>(u >> 16)};
+    }
+
+    float to_float(float16 value);
+    // 就近舍入到偶数，超出范围变为 ±inf，过小的数变为非规格化数或 ±0
+    float16 to_float16(float value);
+
+    // 连续数组的批量转换：支持 AVX2 时向量化（fp16 另需 F16C），否则逐个转换
+    void convert(const float *src, bfloat16 *dst, size_t n);
+    void convert(const bfloat16 *src, float *dst, size_t n);
+    void convert(const float *src, float16 *dst, size_t n);
+    void convert(const float16 *src, float *dst, size_t n);
+
+    // 按 precision 解释 src / dst（FP32 时直接拷贝）
+    void convert_from_float(const float *src, void *dst, Precision precision, size_t n);
+    void convert_to_float(const void *src, Precision precision, float *dst, size_t n);
+
+} // namespace cctorch
+
+#endif // HALF_H
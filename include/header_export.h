@@ -0,0 +1,32 @@
+#ifndef HEADER_EXPORT_H
+#define HEADER_EXPORT_H
+
+#include <string>
+#include "checkpoint.h"
+
+namespace cctorch
+{
+
+    struct HeaderExportOptions
+    {
+        // 生成代码所在的命名空间，也用于 include guard
+        std::string name = "mlp_model";
+        // 除最后一层外每个 Linear 之后接 ReLU（与示例中的 MLP 相同）
+        bool relu_between_layers = true;
+    };
+
+    // 把检查点里从第 0 层开始连续的 Linear 层导出为一个独立的 C++17 头文件，用于部署推理。
+    // 生成的头文件只依赖 <cstddef>：权重和偏置是 alignas(64) 的 constexpr 数组，
+    // 推理函数 infer(const float *input, float *output) 对单个样本做前向，所有循环边界都是常量，
+    // ReLU 在写回中间结果时完成，中间结果放在栈上的定长数组里，没有堆分配：
+    //
+    //     #include "mlp_model.h"
+    //     float scores[mlp_model::out_features];
+    //     mlp_model::infer(pixels, scores);
+    //
+    // 浮点数以 9 位有效数字写出，读回后与检查点中的数值逐位相同。层的形状不连贯时抛出异常。
+    void export_header(const Checkpoint &checkpoint, const std::string &filename, const HeaderExportOptions &options = HeaderExportOptions());
+
+} // namespace cctorch
+
+#endif // HEADER_EXPORT_H
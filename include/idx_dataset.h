@@ -0,0 +1,82 @@
+#ifndef IDX_DATASET_H
+#define IDX_DATASET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "mapped_file.h"
+
+namespace cctorch
+{
+
+    // 把 n 个 uint8 像素转换为 (x / 255 - mean) / std 写入 dst，默认参数即归一化到 [0, 1]。
+    // 支持 AVX2 时每次把 32 个像素加宽为 float 并用一条 FMA 完成缩放和平移。
+    void normalize_pixels(const uint8_t *src, float *dst, size_t n, float mean = 0.0f, float std = 1.0f);
+
+    // IDXDataset::batch 返回的轻量视图：只保存指针，不拷贝像素。
+    // 视图在产生它的数据集析构或重新 shuffle 之前有效。
+    struct IDXBatch
+    {
+        const uint8_t *pixels = nullptr;   // 数据集的整块像素
+        const uint8_t *labels = nullptr;   // 数据集的整块标签
+        const uint32_t *indices = nullptr; // 本 batch 的样本编号
+        size_t size = 0;
+        size_t image_size = 0;
+
+        const uint8_t *image(size_t i) const { return pixels + indices[i] * image_size; }
+        uint8_t label(size_t i) const { return labels[indices[i]]; }
+
+        // 把整个 batch 归一化后按行写入 dst（size * image_size 个 float）
+        void normalize(float *dst, float mean = 0.0f, float std = 1.0f) const;
+    };
+
+    // 内存映射的 IDX 数据集（MNIST 格式）：所有图像是一块连续的只读区域，直接指向文件内容。
+    // shuffle 只打乱样本编号，batch 是编号区间上的视图，启动和每个 batch 只触及实际用到的页面。
+    class IDXDataset
+    {
+    public:
+        /**
+         * @param images_file IDX3 图像文件（magic 2051）
+         * @param labels_file IDX1 标签文件（magic 2049）
+         */
+        IDXDataset(const std::string &images_file, const std::string &labels_file);
+
+        static IDXDataset train(const std::string &data_dir = "data");
+        static IDXDataset test(const std::string &data_dir = "data");
+
+        size_t size() const { return count; }
+        int rows() const { return image_rows; }
+        int cols() const { return image_cols; }
+        size_t image_size() const { return (size_t)image_rows * image_cols; }
+
+        // 按文件顺序的整块数据：size() * image_size() 个像素和 size() 个标签
+        const uint8_t *pixels() const { return pixel_base; }
+        const uint8_t *labels() const { return label_base; }
+
+        // 按当前（可能已打乱的）顺序访问第 i 个样本
+        const uint8_t *image(size_t i) const { return pixel_base + (size_t)order[i] * image_size(); }
+        uint8_t label(size_t i) const { return label_base[order[i]]; }
+
+        void shuffle();
+        void shuffle(uint64_t seed);
+        const std::vector<uint32_t> &indices() const { return order; }
+
+        // 当前顺序下从 start 开始的至多 batch_size 个样本
+        IDXBatch batch(size_t start, size_t batch_size) const;
+        size_t num_batches(size_t batch_size, bool drop_last = false) const;
+
+    private:
+        MappedFile image_file;
+        MappedFile label_file;
+        const uint8_t *pixel_base = nullptr;
+        const uint8_t *label_base = nullptr;
+        size_t count = 0;
+        int image_rows = 0;
+        int image_cols = 0;
+        std::vector<uint32_t> order;
+    };
+
+} // namespace cctorch
+
+#endif // IDX_DATASET_H
@@ -0,0 +1,107 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "tensor.h"
+
+namespace cctorch
+{
+
+    struct JitOptions
+    {
+        // 编译器直接执行（不经过 shell）：compiler 和 flags 按空白拆成参数，不支持引号和转义
+        std::string compiler = "c++";
+        std::string flags = "-std=c++17 -O3 -march=native -fPIC -shared";
+        // 编译好的 .so 按图的哈希缓存在这里；为空时使用 $CCTORCH_JIT_CACHE，再退回 $XDG_CACHE_HOME/cctorch_jit、
+        // ~/.cache/cctorch_jit。目录不存在时以 0700 创建；不属于当前用户、是符号链接或其他用户可写的目录会被拒绝，
+        // 因为从这里 dlopen 的代码以当前用户的权限运行
+        std::string cache_dir;
+    };
+
+    // 把一张标量 Tensor 计算图编译成本机代码（可选的 JIT 模式）。
+    // 构造时从 outputs 沿父节点遍历整张图，按（深度，算子）排成一串同种算子的连续区间，
+    // 为每个区间生成一个固定边界的循环（前向和反向各一份），用系统编译器编译成 .so 再 dlopen。
+    // 节点之间的连接放在运行时的下标数组里，生成的代码只取决于区间结构，
+    // 所以同样形状的图（同一个模型、同样大小的 batch）共用一个缓存的 .so，编译只发生一次。
+    // 执行时不再有逐节点的 switch 分派和指针追逐，数值和梯度都在连续数组里。
+    //
+    //     auto inputs = cctorch::to_tensor(std::vector<std::vector<float>>(batch_size, std::vector<float>(784)));
+    //     cctorch::JitGraph jit(cctorch::flatten(inputs), cctorch::flatten(mlp(inputs)));
+    //     for (...)
+    //     {
+    //         const auto &logits = jit.forward(batch->images.value_ptr()); // 叶子 Tensor，顺序与 outputs 相同
+    //         std::vector<std::vector<cctorch::Tensor>> rows(batch_size);
+    //         for (int i = 0; i < batch_size; ++i)
+    //             rows[i].assign(logits.begin() + i * 10, logits.begin() + (i + 1) * 10);
+    //         auto loss = criterion(rows, batch->labels); // 损失照常即时计算
+    //         optimizer.zero_grad();
+    //         loss.backward(); // 梯度停在 logits 上
+    //         jit.backward();  // 继续传到参数
+    //         optimizer.step();
+    //     }
+    //
+    // 支持 ADD/SUB/MUL/DIV/RELU/EXP/LOG；图中出现 REDUCE（损失函数的融合节点）时抛出异常，
+    // 损失应在 forward() 返回的叶子上计算。除 inputs 外的叶子（参数、常量）每次 forward 重新读取当前值，
+    // backward 把梯度累加到它们的 grad 上，所以优化器不需要改动。
+    class JitGraph
+    {
+    public:
+        JitGraph(const std::vector<Tensor> &inputs, const std::vector<Tensor> &outputs, const JitOptions &options = JitOptions());
+        ~JitGraph();
+
+        JitGraph(const JitGraph &) = delete;
+        JitGraph &operator=(const JitGraph &) = delete;
+
+        // values 按 inputs 的顺序给出新的输入值；返回的输出数值已更新、梯度已清零
+        const std::vector<Tensor> &forward(const float *values);
+        const std::vector<Tensor> &forward(const std::vector<float> &values);
+        // 把 outputs() 上的梯度反向传播，累加到参数（以及 inputs）的 grad
+        void backward();
+
+        const std::vector<Tensor> &outputs() const { return results; }
+
+        // 区间结构的哈希，也是缓存文件名的一部分
+        uint64_t hash() const { return graph_hash; }
+        // 是否直接用了缓存里的 .so（没有调用编译器）
+        bool from_cache() const { return cache_hit; }
+        size_t num_nodes() const { return values.size(); }
+        const std::string &library_path() const { return library; }
+
+    private:
+        struct op_run
+        {
+            Tensor::back_type op;
+            uint32_t begin;
+            uint32_t end;
+        };
+
+        std::string generate_source() const;
+        void load(const JitOptions &options);
+
+        using forward_fn = void (*)(float *, const int32_t *, const int32_t *);
+        using backward_fn = void (*)(const float *, float *, const int32_t *, const int32_t *);
+
+        size_t num_inputs = 0;
+        std::vector<Tensor> leaves;    // 数组下标 [0, leaves.size())，前 num_inputs 个是 inputs
+        std::vector<int32_t> in1, in2; // 第 i 个算子节点（数组下标 leaves.size() + i）的父节点
+        std::vector<op_run> runs;
+        std::vector<int32_t> output_index;
+        std::vector<Tensor> results;
+
+        std::vector<float> values;
+        std::vector<float> grads;
+
+        uint64_t graph_hash = 0;
+        bool cache_hit = false;
+        std::string library;
+        void *handle = nullptr;
+        forward_fn forward_kernel = nullptr;
+        backward_fn backward_kernel = nullptr;
+    };
+
+} // namespace cctorch
+
+#endif // JIT_H
@@ -3,14 +3,16 @@
 
 #include <vector>
 #include "tensor.h"
+#include "dense_tensor.h"
 #include "model.h"
+#include "checkpoint.h"
 
 using std::vector;
 
 namespace cctorch
 {
 
-    // 模型格式
+    // save/load 默认使用检查点格式 v2（见 checkpoint.h），load 仍能读取下面的旧格式：
     // [offset] [type]          [value]          [description]
     // 0000     32 bit integer  1(Linear)        layer类型
     // 0004     32 bit integer  in_features      in_features
@@ -25,20 +27,29 @@ namespace cctorch
         int out_features;
 
     public:
-        vector<vector<Tensor>> weights;
-        vector<Tensor> biases;
+        // 参数是连续存储的叶子：权重 [in_features, out_features]，偏置 [out_features]。
+        // 批量前向直接把它们交给 GEMM，优化器原地更新；按样本的标量前向使用它们的标量视图（见 DenseTensor::scalar_view）
+        DenseTensor weight;
+        DenseTensor bias;
         Linear(int in_features, int out_features);
         vector<Tensor> forward(const vector<Tensor> &input);
-        std::vector<Tensor> parameters();
+        // 整个 batch 一次前向：input 为 [batch, in_features]，输出 [batch, out_features]
+        DenseTensor forward(const DenseTensor &input) override;
+        std::vector<DenseTensor> dense_parameters() override;
 
         // 重写保存和加载方法
         void save(const std::string &filename) const override;
         void load(const std::string &filename) override;
 
-        // 支持追加模式的保存和加载方法（用于多层模型）
+        // 支持追加模式的保存和加载方法（用于多层模型，旧格式），加载时数值直接写入现有参数
         void save_to_stream(std::ofstream &file) const;
         void load_from_stream(std::ifstream &file);
 
+        // 检查点格式 v2：权重 [in, out] 和偏置 [out] 各为一个连续 blob，返回层编号
+        uint32_t save_to_checkpoint(CheckpointWriter &checkpoint) const;
+        // 从第 layer 层读取，数值直接写入现有参数
+        void load_from_checkpoint(const Checkpoint &checkpoint, uint32_t layer);
+
         // 获取输入和输出特征数的公开方法（用于加载时验证）
         int get_in_features() const { return in_features; }
         int get_out_features() const { return out_features; }
@@ -49,6 +60,7 @@ namespace cctorch
     public:
         vector<Tensor> operator()(const vector<Tensor> &inputs);
         vector<vector<Tensor>> operator()(const vector<vector<Tensor>> &inputs);
+        DenseTensor operator()(const DenseTensor &inputs);
     };
 
 } // namespace cctorch
@@ -2,54 +2,114 @@
 #define LOSS_H
 
 #include "tensor.h"
+#include "dense_tensor.h"
+#include "profiler.h"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <stdexcept>
 
 namespace cctorch
 {
     class MSELoss
     {
     public:
+        // 整个损失只记录一个归约节点，反向梯度为 2(p - t) / N
         Tensor operator()(const std::vector<Tensor> &predictions, const std::vector<Tensor> &targets)
         {
+            CCTORCH_PROFILE_SCOPE("MSELoss");
             if (predictions.size() != targets.size())
             {
                 throw std::invalid_argument("Predictions and targets must have the same size.");
             }
 
-            Tensor loss = Tensor(0.0f);
-            for (size_t i = 0; i < predictions.size(); ++i)
+            size_t n = predictions.size();
+            std::vector<Tensor> inputs;
+            std::vector<float> partials;
+            inputs.reserve(2 * n);
+            partials.reserve(2 * n);
+            inputs.insert(inputs.end(), predictions.begin(), predictions.end());
+            inputs.insert(inputs.end(), targets.begin(), targets.end());
+            partials.resize(2 * n);
+
+            double total = 0.0;
+            float scale = 2.0f / n;
+            for (size_t i = 0; i < n; ++i)
             {
-                auto diff = predictions[i] - targets[i];
-                loss = loss + (diff * diff);
+                float diff = predictions[i].value() - targets[i].value();
+                total += diff * diff;
+                partials[i] = scale * diff;
+                partials[n + i] = -scale * diff;
             }
-            return loss / Tensor(static_cast<float>(predictions.size()));
+            return Tensor::reduce(static_cast<float>(total / n), std::move(inputs), std::move(partials));
+        }
+
+        DenseTensor operator()(const DenseTensor &predictions, const DenseTensor &targets)
+        {
+            CCTORCH_PROFILE_SCOPE("MSELoss");
+            return predictions.mse(targets);
         }
     };
 
     class CrossEntropyLoss
     {
     public:
+        // 融合的 softmax 交叉熵：减去每行最大值后计算 log-sum-exp，整个 batch 只记录一个归约节点，
+        // 反向梯度为 (softmax - onehot) / batch
         Tensor operator()(const std::vector<std::vector<Tensor>> &predictions, const std::vector<unsigned char> &targets)
         {
+            CCTORCH_PROFILE_SCOPE("CrossEntropyLoss");
             if (predictions.size() != targets.size())
             {
                 throw std::invalid_argument("Predictions and targets must have the same size.");
             }
 
-            Tensor total_loss = Tensor(0.0f);
-            for (size_t i = 0; i < predictions.size(); ++i)
+            size_t batch = predictions.size();
+            std::vector<Tensor> inputs;
+            std::vector<float> partials;
+            for (const auto &pred : predictions)
             {
-                Tensor sum_exp = Tensor(0.0f);
-                for (const auto &pred : predictions[i])
+                inputs.insert(inputs.end(), pred.begin(), pred.end());
+            }
+            partials.reserve(inputs.size());
+
+            double total_loss = 0.0;
+            float inv_batch = 1.0f / batch;
+            for (size_t i = 0; i < batch; ++i)
+            {
+                const auto &pred = predictions[i];
+                if (targets[i] >= pred.size())
+                {
+                    throw std::out_of_range("Target label out of range.");
+                }
+                float mx = pred[0].value();
+                for (const auto &p : pred)
+                {
+                    mx = std::max(mx, p.value());
+                }
+                float sum_exp = 0.0f;
+                size_t row = partials.size();
+                for (const auto &p : pred)
+                {
+                    partials.push_back(std::exp(p.value() - mx));
+                    sum_exp += partials.back();
+                }
+                total_loss += mx + std::log(sum_exp) - pred[targets[i]].value();
+                for (size_t c = 0; c < pred.size(); ++c)
                 {
-                    sum_exp = sum_exp + pred.exp();
+                    partials[row + c] *= inv_batch / sum_exp;
                 }
-                auto loss = sum_exp.log() - predictions[i][targets[i]];
-                total_loss = total_loss + loss;
+                partials[row + targets[i]] -= inv_batch;
             }
-            return total_loss / Tensor(static_cast<float>(predictions.size()));
+            return Tensor::reduce(static_cast<float>(total_loss / batch), std::move(inputs), std::move(partials));
+        }
+
+        DenseTensor operator()(const DenseTensor &predictions, const std::vector<unsigned char> &targets)
+        {
+            CCTORCH_PROFILE_SCOPE("CrossEntropyLoss");
+            return predictions.cross_entropy(targets);
         }
     };
 }
 
-#endif // LOSS_H
\ No newline at end of file
+#endif // LOSS_H
@@ -0,0 +1,40 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cctorch
+{
+
+    // 只读内存映射文件。页面在第一次访问时才由内核读入，打开文件本身不拷贝数据。
+    // 不支持 mmap 的平台（_WIN32）退回到把整个文件读入内存。
+    class MappedFile
+    {
+    public:
+        MappedFile() = default;
+        explicit MappedFile(const std::string &path);
+        ~MappedFile();
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+        MappedFile(MappedFile &&other) noexcept;
+        MappedFile &operator=(MappedFile &&other) noexcept;
+
+        const uint8_t *data() const { return bytes; }
+        size_t size() const { return length; }
+        bool is_open() const { return bytes != nullptr; }
+
+    private:
+        void release();
+
+        const uint8_t *bytes = nullptr;
+        size_t length = 0;
+        std::vector<uint8_t> fallback; // 仅在不使用 mmap 时持有数据
+    };
+
+} // namespace cctorch
+
+#endif // MAPPED_FILE_H
@@ -5,6 +5,7 @@
 #include <string>
 #include <random>
 #include "tensor.h"
+#include "dense_tensor.h"
 
 namespace cctorch
 {
@@ -86,6 +87,16 @@ namespace cctorch
          */
         static std::vector<std::vector<float>> normalize_image(const std::vector<std::vector<uint8_t>> &images);
 
+        /**
+         * Normalize a whole batch into one contiguous [num_images, image_size] DenseTensor
+         * computing (x / 255 - mean) / std, ready for batched layers (no per-pixel Tensor)
+         * @param data The batch to convert
+         * @param mean Mean subtracted after scaling to [0, 1]
+         * @param std Standard deviation divided by after subtracting mean
+         * @return Normalized images as a DenseTensor without a gradient buffer
+         */
+        static DenseTensor normalize_batch(const MNISTData &data, float mean = 0.0f, float std = 1.0f);
+
     private:
         static std::vector<std::vector<uint8_t>> load_images(const std::string &filename);
         static std::vector<uint8_t> load_labels(const std::string &filename);
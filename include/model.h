@@ -2,10 +2,15 @@
 #define MODEL_H
 
 #include "tensor.h"
+#include "dense_tensor.h"
+#include "tape.h"
+#include "thread_pool.h"
+#include "profiler.h"
 #include <vector>
 #include <string>
 #include <iostream>
 #include <cstdlib>
+#include <stdexcept>
 
 namespace cctorch
 {
@@ -13,7 +18,45 @@ namespace cctorch
     {
     public:
         virtual std::vector<Tensor> forward(const std::vector<Tensor> &input) = 0;
-        virtual std::vector<Tensor> parameters() = 0;
+        /**
+         * 逐元素的标量参数（旧接口，已弃用）。原有的子类照常实现它，优化器收到后通过 DenseTensor::from_parameters
+         * 映射回各层的连续参数。默认实现返回 dense_parameters() 的标量视图，第一次调用时为每个元素创建一个节点。
+         * 新代码实现并使用 dense_parameters()；子类至少要实现两者之一
+         */
+        virtual std::vector<Tensor> parameters()
+        {
+            struct restore
+            {
+                const Model *previous;
+                ~restore() { defaulting_parameters = previous; }
+            } guard{defaulting_parameters};
+            defaulting_parameters = this;
+
+            std::vector<Tensor> params;
+            for (const DenseTensor &param : dense_parameters())
+            {
+                const std::vector<Tensor> &view = param.scalar_view();
+                params.insert(params.end(), view.begin(), view.end());
+            }
+            return params;
+        }
+
+        // 模型的参数（连续存储的叶子张量），优化器原地更新它们。默认实现由 parameters() 转换
+        virtual std::vector<DenseTensor> dense_parameters()
+        {
+            if (defaulting_parameters == this)
+            {
+                throw std::logic_error("Model subclasses must implement parameters() or dense_parameters().");
+            }
+            return DenseTensor::from_parameters(parameters());
+        }
+
+        // 整个 batch 一次前向的虚函数（input 为 [batch, features]），默认实现终止程序
+        virtual DenseTensor forward([[maybe_unused]] const DenseTensor &input)
+        {
+            std::cerr << "Error: batched forward() not implemented for this model type!" << std::endl;
+            std::abort();
+        }
 
         // 保存模型到文件的虚函数，默认实现终止程序
         virtual void save(const std::string &filename) const
@@ -31,10 +74,54 @@ namespace cctorch
 
         std::vector<Tensor> operator()(const std::vector<Tensor> &input)
         {
+            CCTORCH_PROFILE_SCOPE("Model::forward");
             return forward(input);
         }
         std::vector<std::vector<Tensor>> operator()(const std::vector<std::vector<Tensor>> &input)
         {
+            CCTORCH_PROFILE_SCOPE("Model::forward");
+            // 各样本的计算图只共享参数节点（sons 为原子计数），可以分给线程池并行构建。
+            // 正在录制 Tape 时每个样本录制到 tape 的一个分片，完成后按样本顺序合并，与串行录制的 tape 相同。
+            if (pool && pool->size() > 1 && input.size() > 1)
+            {
+                std::vector<std::vector<Tensor>> output(input.size());
+                bool no_grad = NoGradGuard::active();
+                Tape *tape = no_grad ? nullptr : Tape::current();
+                std::vector<Tape> *shards = tape ? &tape->shards(input.size()) : nullptr;
+                try
+                {
+                    pool->parallel_for(input.size(), [&](size_t begin, size_t end)
+                                       {
+                                           NoGradGuard guard(no_grad); // 推理模式按线程生效，传给工作线程
+                                           for (size_t i = begin; i < end; ++i)
+                                           {
+                                               if (shards)
+                                               {
+                                                   Tape::Scope scope((*shards)[i], true);
+                                                   output[i] = forward(input[i]);
+                                               }
+                                               else
+                                               {
+                                                   output[i] = forward(input[i]);
+                                               }
+                                           } });
+                }
+                catch (...)
+                {
+                    // forward 抛出的异常由 parallel_for 在所有区间结束后重新抛出；分片里不完整的记录丢弃，tape 保持调用前的样子
+                    for (size_t i = 0; shards && i < input.size(); ++i)
+                    {
+                        (*shards)[i].clear();
+                    }
+                    throw;
+                }
+                if (tape)
+                {
+                    tape->merge_shards(input.size());
+                }
+                return output;
+            }
+
             std::vector<std::vector<Tensor>> output;
             for (const auto &batch : input)
             {
@@ -43,6 +130,58 @@ namespace cctorch
             }
             return output;
         }
+        DenseTensor operator()(const DenseTensor &input)
+        {
+            CCTORCH_PROFILE_SCOPE("Model::forward");
+            return forward(input);
+        }
+
+        /**
+         * 设置后按 batch 调用 operator() 时会把样本分给线程池并行前向，传 nullptr 恢复串行。
+         * 要求 forward() 可以被多个线程同时调用（只读参数，不修改成员状态）。
+         * 参数梯度可以配合 Tensor::backward(ThreadPool &) 并行累加。正在录制 Tape 时同样并行前向，
+         * 各样本的记录按样本顺序合并到 tape 上。某个样本的 forward() 抛出异常时，等其余样本结束后在调用线程重新抛出
+         */
+        void set_thread_pool(ThreadPool *thread_pool)
+        {
+            pool = thread_pool;
+        }
+
+    private:
+        ThreadPool *pool = nullptr;
+        // 正在执行默认 parameters() 的模型，用于发现两个默认实现互相调用
+        static inline thread_local const Model *defaulting_parameters = nullptr;
+    };
+
+    // 激活检查点包装：批量前向时 segment 内部的中间激活不保留，反向时重新前向一遍（见 DenseTensor::checkpointed）。
+    // segment 的参数照常出现在 dense_parameters() 里；标量 Tensor 路径和推理模式下直接转发给 segment。
+    //
+    //     cctorch::ActivationCheckpoint block(encoder); // encoder 要比 block 活得久
+    //     auto logits = head(block(batch->images));
+    class ActivationCheckpoint : public Model
+    {
+    public:
+        explicit ActivationCheckpoint(Model &segment) : segment(segment) {}
+
+        std::vector<Tensor> forward(const std::vector<Tensor> &input) override
+        {
+            return segment.forward(input);
+        }
+
+        DenseTensor forward(const DenseTensor &input) override
+        {
+            Model *inner = &segment;
+            return input.checkpointed([inner](const DenseTensor &x)
+                                      { return inner->forward(x); });
+        }
+
+        std::vector<DenseTensor> dense_parameters() override
+        {
+            return segment.dense_parameters();
+        }
+
+    private:
+        Model &segment;
     };
 
 } // namespace cctorch
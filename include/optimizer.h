@@ -2,70 +2,300 @@
 #define OPTIMIZER_H
 
 #include "tensor.h"
+#include "dense_tensor.h"
+#include "thread_pool.h"
+#include "profiler.h"
+#include <algorithm>
 #include <vector>
 #include <cmath>
+#include <utility>
 
 namespace cctorch
 {
+    // 一次 Adam 更新用到的常量，偏差修正项每步只算一次
+    struct adam_step_params
+    {
+        float step_size;    // learning_rate / (1 - beta1^t)
+        float beta1;
+        float beta2;
+        float inv_sqrt_bc2; // 1 / sqrt(1 - beta2^t)
+        float epsilon;
+        float decay;        // 1 - learning_rate * weight_decay（AdamW 解耦权重衰减）
+        float grad_scale;   // 梯度先乘以它（梯度累加时为 1 / micro-batch 数）
+    };
+
+    // 连续数组上的融合更新内核，支持 AVX2 时自动使用向量化版本
+    void sgd_update(float *value, const float *grad, size_t n, float learning_rate, float decay);
+    void adam_update(float *value, const float *grad, float *m, float *v, size_t n, const adam_step_params &p);
+
+    // 多张量模式下每个并行区间的最小元素个数
+    constexpr size_t optimizer_grain = 16384;
+
+    // 把 [0, n) 切给线程池执行 fn(begin, end)。区间边界对齐到 8 个元素（一个 AVX2 向量），
+    // 标量的尾部处理只出现在数组末尾，结果与不切分时逐位相同，不随线程数变化
+    template <class Fn>
+    void parallel_update(ThreadPool &pool, size_t n, Fn &&fn)
+    {
+        constexpr size_t width = 8;
+        pool.parallel_for((n + width - 1) / width, [&](size_t begin, size_t end)
+                          { fn(begin * width, std::min(n, end * width)); }, optimizer_grain / width);
+    }
+
+    // 检查参数都是带梯度缓冲区的 fp32 张量，否则抛出 std::invalid_argument
+    void check_parameters(const std::vector<DenseTensor> &parameters);
+
     class SGD
     {
     public:
-        std::vector<Tensor> parameters;
+        // 参数的连续缓冲区，更新时原地修改
+        std::vector<DenseTensor> parameters;
         float learning_rate;
+        float weight_decay;
+
+        SGD(std::vector<DenseTensor> parameters, float learning_rate, float weight_decay = 0.0f)
+            : parameters(std::move(parameters)), learning_rate(learning_rate), weight_decay(weight_decay)
+        {
+            check_parameters(this->parameters);
+        }
 
-        SGD(std::vector<Tensor> parameters, float learning_rate) : parameters(parameters), learning_rate(learning_rate) {}
+        // 旧接口（Model::parameters() 的标量参数）：映射回各层的连续参数，见 DenseTensor::from_parameters
+        SGD(const std::vector<Tensor> &parameters, float learning_rate, float weight_decay = 0.0f)
+            : SGD(DenseTensor::from_parameters(parameters), learning_rate, weight_decay) {}
 
+        /**
+         * 清零参数梯度。set_accumulation_steps(k > 1) 时，一组 micro-batch 的中途（accumulating() 为 true，
+         * 已经 step() 过但还没有更新参数）调用是空操作，这样每个 micro-batch 照常 zero_grad() / backward() / step()
+         * 的训练循环不需要改动；需要丢弃已经累加的梯度时先 flush() 或 discard()
+         */
         void zero_grad()
         {
-            for (int i = 0; i < parameters.size(); i++)
+            if (accumulated > 0)
+                return;
+            for (size_t i = 0; i < parameters.size(); i++)
                 parameters[i].zero_grad();
         }
 
-        void step()
+        /**
+         * 梯度累加：每 steps 次 step() 才更新一次参数，期间 zero_grad() 不清零，各 micro-batch 的梯度在参数上累加，
+         * 更新时再乘以 1 / steps。每个 micro-batch 的损失照常取 batch 平均，micro-batch 大小相同时与大 batch 的一步等价，
+         * 训练循环不需要改动。1 表示每次 step() 都更新
+         */
+        void set_accumulation_steps(size_t steps)
+        {
+            accumulation_steps = std::max<size_t>(steps, 1);
+        }
+
+        /**
+         * 多张量模式：用向量化内核原地更新每个参数的连续缓冲区
+         * @param pool 非空时把更新切分到线程池上执行
+         */
+        void set_multi_tensor(bool enable, ThreadPool *pool = nullptr)
+        {
+            multi_tensor = enable;
+            this->pool = pool;
+        }
+
+        // 返回这次调用是否更新了参数（梯度累加时只有每组的最后一次更新）
+        bool step()
         {
-            for (int i = 0; i < parameters.size(); i++)
-                parameters[i].data->value -= parameters[i].data->grad * learning_rate;
+            if (++accumulated < accumulation_steps)
+                return false;
+            return flush();
         }
+
+        // 立即用已经累加的 micro-batch 更新（例如 epoch 结束时凑不满一组），没有累加的梯度时返回 false
+        bool flush()
+        {
+            if (accumulated == 0)
+                return false;
+            update(1.0f / accumulated);
+            accumulated = 0;
+            return true;
+        }
+
+        // 是否处在一组 micro-batch 的中途（此时 zero_grad() 不清零）
+        bool accumulating() const { return accumulated > 0; }
+
+        // 放弃这一组已经累加的梯度，不更新参数，下一次 zero_grad() 重新清零
+        void discard() { accumulated = 0; }
+
+    private:
+        void update(float grad_scale)
+        {
+            CCTORCH_PROFILE_SCOPE("SGD::step");
+            float decay = 1.0f - learning_rate * weight_decay;
+            float rate = learning_rate * grad_scale;
+            for (DenseTensor &param : parameters)
+            {
+                param.merge_view_grad();
+                float *value = param.value_ptr();
+                const float *grad = param.grad_ptr();
+                size_t n = param.numel();
+                if (!multi_tensor)
+                {
+                    for (size_t i = 0; i < n; i++)
+                        value[i] = value[i] * decay - grad[i] * rate;
+                }
+                else if (pool)
+                {
+                    parallel_update(*pool, n, [&](size_t begin, size_t end)
+                                    { sgd_update(value + begin, grad + begin, end - begin, rate, decay); });
+                }
+                else
+                {
+                    sgd_update(value, grad, n, rate, decay);
+                }
+                param.refresh_view();
+            }
+        }
+
+        bool multi_tensor = false;
+        ThreadPool *pool = nullptr;
+        size_t accumulation_steps = 1;
+        size_t accumulated = 0; // 自上次更新以来 step() 的次数
     };
 
     class Adam
     {
     public:
-        std::vector<Tensor> parameters;
+        // 参数的连续缓冲区，更新时原地修改
+        std::vector<DenseTensor> parameters;
         float learning_rate;
         float beta1;
         float beta2;
         float epsilon;
-        std::vector<float> m; // First moment
-        std::vector<float> v; // Second moment
+        float weight_decay;   // 解耦权重衰减（AdamW），0 时为普通 Adam
+        aligned_buffer m;     // First moment，按 parameters 的顺序展平成一块 64 字节对齐的连续缓冲区
+        aligned_buffer v;     // Second moment
         int t;                // Time step
 
-        Adam(std::vector<Tensor> parameters, float learning_rate = 0.001, float beta1 = 0.9, float beta2 = 0.999, float epsilon = 1e-8)
-            : parameters(parameters), learning_rate(learning_rate), beta1(beta1), beta2(beta2), epsilon(epsilon), t(0), m(parameters.size(), 0.0f), v(parameters.size(), 0.0f)
+        Adam(std::vector<DenseTensor> parameters, float learning_rate = 0.001, float beta1 = 0.9, float beta2 = 0.999, float epsilon = 1e-8, float weight_decay = 0.0f)
+            : parameters(std::move(parameters)), learning_rate(learning_rate), beta1(beta1), beta2(beta2), epsilon(epsilon), weight_decay(weight_decay), t(0)
         {
+            check_parameters(this->parameters);
+            for (const DenseTensor &param : this->parameters)
+                state_size += param.numel();
+            m = make_aligned_buffer(state_size);
+            v = make_aligned_buffer(state_size);
         }
 
+        // 旧接口（Model::parameters() 的标量参数）：映射回各层的连续参数，见 DenseTensor::from_parameters
+        Adam(const std::vector<Tensor> &parameters, float learning_rate = 0.001, float beta1 = 0.9, float beta2 = 0.999, float epsilon = 1e-8, float weight_decay = 0.0f)
+            : Adam(DenseTensor::from_parameters(parameters), learning_rate, beta1, beta2, epsilon, weight_decay) {}
+
+        // m、v 的元素个数（所有参数的元素总数）
+        size_t numel() const { return state_size; }
+
+        /**
+         * 清零参数梯度。set_accumulation_steps(k > 1) 时，一组 micro-batch 的中途（accumulating() 为 true，
+         * 已经 step() 过但还没有更新参数）调用是空操作，这样每个 micro-batch 照常 zero_grad() / backward() / step()
+         * 的训练循环不需要改动；需要丢弃已经累加的梯度时先 flush() 或 discard()
+         */
         void zero_grad()
         {
-            for (int i = 0; i < parameters.size(); i++)
+            if (accumulated > 0)
+                return;
+            for (size_t i = 0; i < parameters.size(); i++)
                 parameters[i].zero_grad();
         }
 
-        void step()
+        /**
+         * 梯度累加：每 steps 次 step() 才更新一次参数，期间 zero_grad() 不清零，各 micro-batch 的梯度在参数上累加，
+         * 更新时再乘以 1 / steps。每个 micro-batch 的损失照常取 batch 平均，micro-batch 大小相同时与大 batch 的一步等价，
+         * 训练循环不需要改动。1 表示每次 step() 都更新
+         */
+        void set_accumulation_steps(size_t steps)
         {
-            ++t;
-            for (int i = 0; i < parameters.size(); ++i)
-            {
-                m[i] = beta1 * m[i] + (1 - beta1) * parameters[i].grad();
-                v[i] = beta2 * v[i] + (1 - beta2) * parameters[i].grad() * parameters[i].grad();
+            accumulation_steps = std::max<size_t>(steps, 1);
+        }
 
-                float m_hat = m[i] / (1 - std::pow(beta1, t));
-                float v_hat = v[i] / (1 - std::pow(beta2, t));
+        /**
+         * 多张量模式：用向量化内核原地更新每个参数的连续缓冲区和对应的 m、v
+         * @param pool 非空时把更新切分到线程池上执行
+         */
+        void set_multi_tensor(bool enable, ThreadPool *pool = nullptr)
+        {
+            multi_tensor = enable;
+            this->pool = pool;
+        }
 
-                parameters[i].data->value -= learning_rate * m_hat / (std::sqrt(v_hat) + epsilon);
+        // 返回这次调用是否更新了参数（梯度累加时只有每组的最后一次更新，t 也只在更新时增加）
+        bool step()
+        {
+            if (++accumulated < accumulation_steps)
+                return false;
+            return flush();
+        }
+
+        // 立即用已经累加的 micro-batch 更新（例如 epoch 结束时凑不满一组），没有累加的梯度时返回 false
+        bool flush()
+        {
+            if (accumulated == 0)
+                return false;
+            update(1.0f / accumulated);
+            accumulated = 0;
+            return true;
+        }
+
+        // 是否处在一组 micro-batch 的中途（此时 zero_grad() 不清零）
+        bool accumulating() const { return accumulated > 0; }
+
+        // 放弃这一组已经累加的梯度，不更新参数，下一次 zero_grad() 重新清零
+        void discard() { accumulated = 0; }
+
+    private:
+        void update(float grad_scale)
+        {
+            CCTORCH_PROFILE_SCOPE("Adam::step");
+            ++t;
+            adam_step_params p;
+            p.step_size = learning_rate / (1 - std::pow(beta1, t));
+            p.beta1 = beta1;
+            p.beta2 = beta2;
+            p.inv_sqrt_bc2 = 1.0f / std::sqrt(1 - std::pow(beta2, t));
+            p.epsilon = epsilon;
+            p.decay = 1.0f - learning_rate * weight_decay;
+            p.grad_scale = grad_scale;
+
+            size_t offset = 0;
+            for (DenseTensor &param : parameters)
+            {
+                param.merge_view_grad();
+                float *value = param.value_ptr();
+                const float *grad = param.grad_ptr();
+                float *pm = m.get() + offset;
+                float *pv = v.get() + offset;
+                size_t n = param.numel();
+                if (!multi_tensor)
+                {
+                    for (size_t i = 0; i < n; ++i)
+                    {
+                        float g = grad[i] * grad_scale;
+                        pm[i] = beta1 * pm[i] + (1 - beta1) * g;
+                        pv[i] = beta2 * pv[i] + (1 - beta2) * g * g;
+                        value[i] = value[i] * p.decay - p.step_size * pm[i] / (std::sqrt(pv[i]) * p.inv_sqrt_bc2 + epsilon);
+                    }
+                }
+                else if (pool)
+                {
+                    parallel_update(*pool, n, [&](size_t begin, size_t end)
+                                    { adam_update(value + begin, grad + begin, pm + begin, pv + begin, end - begin, p); });
+                }
+                else
+                {
+                    adam_update(value, grad, pm, pv, n, p);
+                }
+                param.refresh_view();
+                offset += n;
             }
         }
+
+        bool multi_tensor = false;
+        ThreadPool *pool = nullptr;
+        size_t accumulation_steps = 1;
+        size_t accumulated = 0; // 自上次更新以来 step() 的次数
+        size_t state_size = 0;
     };
 }
 
-#endif // OPTIMIZER_H
\ No newline at end of file
+#endif // OPTIMIZER_H
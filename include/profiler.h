@@ -0,0 +1,110 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// 内置的训练步分析器。用 -DCCTORCH_PROFILE=ON 配置（定义宏 CCTORCH_PROFILE）时，
+// 前向、各层、反向、损失、优化器、取 batch 和检查点保存处的 CCTORCH_PROFILE_SCOPE 会记录时间区间，
+// 计算图节点的构造和析构会更新计数；没有定义时这些宏展开为空，下面的函数都是空的内联函数，不产生任何代码。
+//
+//     cctorch::profiler::start();
+//     for (...)
+//     {
+//         float loss = trainer.step(batch->images, batch->labels);
+//         cctorch::profiler::step();   // 一个训练步结束：记录本步的节点数、分配字节数和存活节点峰值
+//     }
+//     cctorch::profiler::stop();
+//     cctorch::profiler::write_chrome_trace("trace.json"); // chrome://tracing 或 https://ui.perfetto.dev 打开
+//     cctorch::profiler::print_summary(std::cout);
+namespace cctorch
+{
+    namespace profiler
+    {
+
+        // 一个训练步（两次 step() 之间）的计数
+        struct StepStats
+        {
+            int64_t begin_ns = 0;
+            int64_t end_ns = 0;
+            int64_t nodes_created = 0;   // 新建的 tensor_data 和 dense_data 节点
+            int64_t bytes_allocated = 0; // 这些节点本身及其数值/梯度缓冲区的字节数
+            int64_t peak_live_nodes = 0; // 本步内同时存活的节点数的最大值（包括参数等长期存活的节点）
+        };
+
+#ifdef CCTORCH_PROFILE
+
+        // 清空之前的记录并开始记录；区间的时间从这里开始计。可以在其他线程的区间进行中调用，
+        // 那些区间开始于本次记录之前，不会被记录
+        void start();
+        // 停止记录，导出前调用；之后开始的区间不再记录
+        void stop();
+        bool recording();
+
+        // 结束当前训练步并开始下一步
+        void step();
+        std::vector<StepStats> steps();
+
+        // Chrome trace_event 格式（JSON）：每个区间一个 "X" 事件，每个训练步一组 "C" 计数器事件
+        void write_chrome_trace(const std::string &filename);
+        // 按区间名字汇总：调用次数、总时间、平均、最大和占记录时长的比例（嵌套区间的时间包含在外层里），以及每步的计数
+        void print_summary(std::ostream &out);
+
+        // 由 CCTORCH_PROFILE_SCOPE 使用：构造时记下开始时间，析构时记录区间。name 必须是静态字符串
+        class Span
+        {
+        public:
+            explicit Span(const char *name);
+            ~Span();
+
+            Span(const Span &) = delete;
+            Span &operator=(const Span &) = delete;
+
+        private:
+            const char *name;
+            int64_t begin_ns; // steady_clock 的纳秒数，没有在记录时为 -1
+        };
+
+        // 节点计数，由节点的构造和析构函数调用
+        void node_created(size_t bytes);
+        void node_destroyed();
+
+#define CCTORCH_PROFILE_CONCAT_INNER(a, b) a##b
+#define CCTORCH_PROFILE_CONCAT(a, b) CCTORCH_PROFILE_CONCAT_INNER(a, b)
+#define CCTORCH_PROFILE_SCOPE(name) ::cctorch::profiler::Span CCTORCH_PROFILE_CONCAT(cctorch_profile_span_, __LINE__)(name)
+#define CCTORCH_PROFILE_NODE_CREATED(bytes) ::cctorch::profiler::node_created(bytes)
+#define CCTORCH_PROFILE_NODE_DESTROYED() ::cctorch::profiler::node_destroyed()
+
+#else
+
+        inline void start() {}
+        inline void stop() {}
+        inline bool recording() { return false; }
+        inline void step() {}
+        inline std::vector<StepStats> steps() { return {}; }
+        inline void write_chrome_trace(const std::string &) {}
+        inline void print_summary(std::ostream &) {}
+
+#define CCTORCH_PROFILE_SCOPE(name) ((void)0)
+#define CCTORCH_PROFILE_NODE_CREATED(bytes) ((void)0)
+#define CCTORCH_PROFILE_NODE_DESTROYED() ((void)0)
+
+#endif
+
+        // 编译时是否启用了分析器
+        constexpr bool enabled()
+        {
+#ifdef CCTORCH_PROFILE
+            return true;
+#else
+            return false;
+#endif
+        }
+
+    } // namespace profiler
+} // namespace cctorch
+
+#endif // PROFILER_H
@@ -0,0 +1,104 @@
+#ifndef QUANTIZE_H
+#define QUANTIZE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "checkpoint.h"
+
+namespace cctorch
+{
+
+    // 量化 Linear 在检查点中的 layer_type：权重为 INT8 [in, out]，另有 float 的 BIAS [out]、
+    // WEIGHT_SCALE [out] 和 INPUT_QUANT [2]（输入的 scale 与 zero_point）。带 ReLU 的层单独编号
+    constexpr uint32_t quantized_linear_layer = 2;
+    constexpr uint32_t quantized_linear_relu_layer = 3;
+
+    // 激活量化到 [0, 127]（只用 7 位）：AVX2 的 vpmaddubsw 把相邻两对 u8 x s8 的乘积饱和相加到 int16，
+    // 127 * 127 * 2 不会溢出，所以各个内核的结果逐位相同
+    constexpr int quantized_activation_max = 127;
+
+    // pack_int8_weights 输出的字节数：列补齐到 16 的倍数，k 补齐到 4 的倍数
+    size_t int8_packed_size(int k, int n);
+    // 把行主序的 int8 矩阵 B [k, n] 打包成 igemm_u8s8 使用的布局：每 16 列一个面板，
+    // 面板内每 4 个 k 一组、每列 4 个字节连续（正好是一条 vpmaddubsw / vpdpbusd 的操作数），补齐部分为 0
+    void pack_int8_weights(const int8_t *b, int k, int n, int8_t *packed);
+
+    /**
+     * 整数矩阵乘法（行主序）：C[m, n] = A[m, k] * B[k, n]，在 int32 中精确累加。
+     * A 为 uint8，取值必须在 [0, quantized_activation_max]；B 由 pack_int8_weights 打包。
+     * A 的每一行要能读到 k 向上取整到 4 的位置（补齐的值乘以 B 中的 0，不影响结果）。
+     * 运行时按 AVX512-VNNI（vpdpbusd）、AVX2（vpmaddubsw + vpmaddwd）、标量的顺序选择内核。
+     */
+    void igemm_u8s8(int m, int n, int k, const uint8_t *a, int lda, const int8_t *packed_b, int32_t *c, int ldc);
+
+    // 当前进程使用的整数矩阵乘法内核："avx512-vnni"、"avx2" 或 "scalar"
+    const char *igemm_kernel_name();
+
+    struct QuantizeOptions
+    {
+        // 除最后一层外每个 Linear 之后接 ReLU（与示例中的 MLP 相同）
+        bool relu_between_layers = true;
+    };
+
+    // 训练后量化的顺序 Linear 模型，只用于推理：
+    //   - 权重按输出通道对称量化为 int8（scale = max|w| / 127），偏置保持 float；
+    //   - 每层输入按校准数据上观察到的 [min, max] 非对称量化为 [0, 127] 的 uint8；
+    //   - 每层做一次 u8 x s8 -> int32 的 igemm_u8s8，再用 scale、零点修正和偏置还原为 float，
+    //     隐藏层在同一遍里做 ReLU 并重新量化成下一层的输入。
+    //
+    //     cctorch::Checkpoint fp32("mlp_final.bin");
+    //     cctorch::QuantizedMLP int8(fp32, calibration.data(), 1000); // 1000 个归一化后的样本
+    //     int8.save("mlp_int8.bin");
+    //     int8.predict(images, logits, batch);
+    class QuantizedMLP
+    {
+    public:
+        // 量化检查点里从第 0 层开始连续的 fp32 Linear 层。calibration 为 num_samples 行归一化后的输入
+        // （与推理时的预处理相同），用 fp32 前向统计每层输入的取值范围
+        QuantizedMLP(const Checkpoint &checkpoint, const float *calibration, size_t num_samples,
+                     const QuantizeOptions &options = QuantizeOptions());
+        // 读取 save 保存的量化模型
+        explicit QuantizedMLP(const std::string &filename);
+
+        // 对 batch 行输入前向，output 为 [batch, out_features()]。只读成员，可以被多个线程同时调用
+        void predict(const float *input, float *output, size_t batch) const;
+
+        // 以检查点格式 v2 保存：每层一个 INT8 权重 blob 加上 float 的偏置、权重 scale 和输入量化参数
+        void save(const std::string &filename) const;
+        void save_to_checkpoint(CheckpointWriter &checkpoint) const;
+
+        int in_features() const { return layers.front().in; }
+        int out_features() const { return layers.back().out; }
+        size_t num_layers() const { return layers.size(); }
+        // 参数占用的字节数（int8 权重 + float 偏置和 scale），同样形状的 fp32 模型为 4 * (权重数 + 偏置数)
+        size_t weight_bytes() const;
+
+    private:
+        struct layer
+        {
+            int in = 0;
+            int out = 0;
+            int in_padded = 0; // 输入补齐到 4 的倍数，也是量化输入缓冲区的行跨度
+            int out_padded = 0;
+            bool relu = false;
+            float input_scale = 1.0f;
+            int input_zero = 0;
+            std::vector<int8_t> weight; // [in, out]，与 fp32 检查点的布局相同
+            std::vector<float> weight_scale;
+            std::vector<float> bias;
+            // 由上面的数据推出：打包后的权重，以及 y = acc * multiplier[j] + offset[j] 的系数
+            std::vector<int8_t> packed;
+            std::vector<float> multiplier;
+            std::vector<float> offset;
+        };
+
+        void prepare(layer &l);
+
+        std::vector<layer> layers;
+    };
+
+} // namespace cctorch
+
+#endif // QUANTIZE_H
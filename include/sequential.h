@@ -0,0 +1,504 @@
+#ifndef SEQUENTIAL_H
+#define SEQUENTIAL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "checkpoint.h"
+#include "dense_tensor.h"
+#include "layer.h"
+#include "model.h"
+#include "optimizer.h"
+#include "profiler.h"
+#include "simd.h"
+
+// 固定尺寸内核的循环体强制内联，这样 AVX2 版本的包装函数会用 AVX2 指令重新编译它
+#ifdef CCTORCH_X86_SIMD
+#define CCTORCH_FIXED_INLINE __attribute__((always_inline)) inline
+#else
+#define CCTORCH_FIXED_INLINE inline
+#endif
+
+namespace cctorch
+{
+
+    // 形状在编译期确定的层和顺序模型：
+    //
+    //     using MLP = cctorch::fixed::Sequential<cctorch::fixed::Linear<784, 128>,
+    //                                            cctorch::fixed::ReLU,
+    //                                            cctorch::fixed::Linear<128, 10>>;
+    //     MLP mlp;
+    //     cctorch::Adam optimizer(mlp.dense_parameters(), 0.001f);
+    //     auto logits = mlp(batch->images);   // 训练：DenseTensor 计算图，Linear + ReLU 融合成一个节点
+    //     mlp.predict(pixels, scores, n);      // 推理：固定尺寸的内核，不构建计算图
+    //     mlp.save("mlp.ckpt", &optimizer);
+    //
+    // 相邻层的维度不匹配在编译期报错；层之间的调用全部静态展开，没有虚函数分派。
+    // dense_parameters()、保存和加载按层的顺序自动生成，检查点布局与手写的多层模型相同（第 i 个 Linear 为第 i 层）。
+    namespace fixed
+    {
+
+        // 参数就是 cctorch::Linear 的连续权重 [In, Out] 和偏置 [Out]，训练、优化器、检查点和推理内核共用同一份
+        template <int In, int Out>
+        class Linear
+        {
+            static_assert(In > 0 && Out > 0, "Linear dimensions must be positive");
+
+        public:
+            static constexpr int in_features = In;
+            static constexpr int out_features = Out;
+
+            Linear() : layer(In, Out) {}
+
+            DenseTensor forward(const DenseTensor &input) { return layer.forward(input); }
+            std::vector<Tensor> forward(const std::vector<Tensor> &input) { return layer.forward(input); }
+            // 融合下一层的 ReLU
+            DenseTensor forward_relu(const DenseTensor &input)
+            {
+                CCTORCH_PROFILE_SCOPE("Linear+ReLU::forward");
+                return input.linear_relu(layer.weight, layer.bias);
+            }
+
+            void dense_parameters(std::vector<DenseTensor> &params)
+            {
+                params.push_back(layer.weight);
+                params.push_back(layer.bias);
+            }
+
+            cctorch::Linear &base() { return layer; }
+            const cctorch::Linear &base() const { return layer; }
+
+            // R 行输入（行距 ldx）乘当前权重写到 y（行距 Out），Relu 为 true 时顺带做激活。
+            // 循环边界都是编译期常量，内层沿 Out 连续访问，编译器可以完全展开并向量化；
+            // avx2 为 true 时使用按 AVX2/FMA 编译的同一份代码
+            template <int R, bool Relu>
+            void kernel(const float *x, size_t ldx, float *y, bool avx2) const
+            {
+#ifdef CCTORCH_X86_SIMD
+                if (avx2)
+                {
+                    kernel_avx2<R, Relu>(layer.weight.value_ptr(), layer.bias.value_ptr(), x, ldx, y);
+                    return;
+                }
+#else
+                (void)avx2;
+#endif
+                kernel_body<R, Relu>(layer.weight.value_ptr(), layer.bias.value_ptr(), x, ldx, y);
+            }
+
+        private:
+            template <int R, bool Relu>
+            static CCTORCH_FIXED_INLINE void kernel_body(const float *w, const float *b, const float *x, size_t ldx, float *y)
+            {
+                float acc[R][Out];
+                for (int r = 0; r < R; ++r)
+                {
+                    for (int j = 0; j < Out; ++j)
+                    {
+                        acc[r][j] = b[j];
+                    }
+                }
+                for (int i = 0; i < In; ++i)
+                {
+                    const float *row = w + static_cast<size_t>(i) * Out;
+                    for (int r = 0; r < R; ++r)
+                    {
+                        const float xv = x[r * ldx + i];
+                        for (int j = 0; j < Out; ++j)
+                        {
+                            acc[r][j] += xv * row[j];
+                        }
+                    }
+                }
+                for (int r = 0; r < R; ++r)
+                {
+                    for (int j = 0; j < Out; ++j)
+                    {
+                        y[r * Out + j] = Relu ? std::max(acc[r][j], 0.0f) : acc[r][j];
+                    }
+                }
+            }
+
+#ifdef CCTORCH_X86_SIMD
+            template <int R, bool Relu>
+            __attribute__((target("avx2,fma"))) static void kernel_avx2(const float *w, const float *b, const float *x, size_t ldx, float *y)
+            {
+                kernel_body<R, Relu>(w, b, x, ldx, y);
+            }
+#endif
+
+            cctorch::Linear layer;
+        };
+
+        // 不改变宽度、没有参数
+        class ReLU
+        {
+        public:
+            DenseTensor forward(const DenseTensor &input)
+            {
+                CCTORCH_PROFILE_SCOPE("ReLU");
+                return input.relu();
+            }
+            std::vector<Tensor> forward(const std::vector<Tensor> &input) { return cctorch::ReLU()(input); }
+            void dense_parameters(std::vector<DenseTensor> &) {}
+        };
+
+        template <class T>
+        struct is_linear : std::false_type
+        {
+        };
+
+        template <int In, int Out>
+        struct is_linear<Linear<In, Out>> : std::true_type
+        {
+        };
+
+        template <class... Layers>
+        class Sequential final : public Model
+        {
+            static_assert(sizeof...(Layers) > 0, "Sequential needs at least one layer");
+
+            using layer_tuple = std::tuple<Layers...>;
+            static constexpr size_t num_layers = sizeof...(Layers);
+
+            template <size_t I>
+            using layer_t = std::tuple_element_t<I, layer_tuple>;
+
+            // 第 I 层之后的宽度；Width 为第 I 层的输入宽度，遇到 Linear 时检查是否匹配
+            template <size_t I, int Width>
+            static constexpr int width_after()
+            {
+                if constexpr (I == num_layers)
+                {
+                    return Width;
+                }
+                else if constexpr (is_linear<layer_t<I>>::value)
+                {
+                    static_assert(Width == 0 || layer_t<I>::in_features == Width, "Sequential: adjacent layer dimensions do not match");
+                    return width_after<I + 1, layer_t<I>::out_features>();
+                }
+                else
+                {
+                    return width_after<I + 1, Width>();
+                }
+            }
+
+            template <size_t I>
+            static constexpr int first_width()
+            {
+                if constexpr (I == num_layers)
+                {
+                    return 0;
+                }
+                else if constexpr (is_linear<layer_t<I>>::value)
+                {
+                    return layer_t<I>::in_features;
+                }
+                else
+                {
+                    return first_width<I + 1>();
+                }
+            }
+
+            template <size_t I>
+            static constexpr int max_width()
+            {
+                if constexpr (I == num_layers)
+                {
+                    return first_width<0>();
+                }
+                else if constexpr (is_linear<layer_t<I>>::value)
+                {
+                    return std::max(layer_t<I>::out_features, max_width<I + 1>());
+                }
+                else
+                {
+                    return max_width<I + 1>();
+                }
+            }
+
+            // Linear 后面紧跟 ReLU 时两层合成一个算子
+            template <size_t I>
+            static constexpr bool fuses_relu()
+            {
+                if constexpr (I + 1 < num_layers)
+                {
+                    return is_linear<layer_t<I>>::value && std::is_same<layer_t<I + 1>, ReLU>::value;
+                }
+                else
+                {
+                    return false;
+                }
+            }
+
+        public:
+            static constexpr int in_features = first_width<0>();
+            static constexpr int out_features = width_after<0, first_width<0>()>();
+            static_assert(in_features > 0, "Sequential needs at least one Linear layer");
+
+            std::vector<Tensor> forward(const std::vector<Tensor> &input) override { return scalar_forward<0>(input); }
+            DenseTensor forward(const DenseTensor &input) override { return dense_forward<0>(input); }
+
+            std::vector<DenseTensor> dense_parameters() override
+            {
+                std::vector<DenseTensor> params;
+                std::apply([&](auto &...layer)
+                           { (layer.dense_parameters(params), ...); },
+                           layers);
+                return params;
+            }
+
+            template <size_t I>
+            layer_t<I> &layer() { return std::get<I>(layers); }
+
+            // 激活检查点：批量训练前向时每 steps 步（一层，或融合的 Linear + ReLU）作为一段，
+            // 段内的中间激活不保留，反向时重算（见 DenseTensor::checkpointed），0 表示关闭。
+            // 检查点输出和重算中的一段同时存在，n 步的模型取 k 约为 sqrt(n) 时激活内存最少；额外的计算约为一次前向
+            void set_checkpoint_every(size_t steps) { checkpoint_every = steps; }
+            size_t checkpoint_steps() const { return checkpoint_every; }
+
+            // 推理：input 为 [batch, in_features]，output 为 [batch, out_features]，都按行连续存放。
+            // 每 4 行一组依次经过各层，中间结果放在栈上固定大小的缓冲区里，权重直接从参数的连续缓冲区读取
+            void predict(const float *input, float *output, size_t batch) const
+            {
+                const bool avx2 = cpu_has_avx2_fma();
+                size_t row = 0;
+                for (; row + 4 <= batch; row += 4)
+                {
+                    predict_rows<4>(input + row * in_features, output + row * out_features, avx2);
+                }
+                for (; row < batch; ++row)
+                {
+                    predict_rows<1>(input + row * in_features, output + row * out_features, avx2);
+                }
+            }
+
+            void save(const std::string &filename) const override
+            {
+                save(filename, nullptr);
+            }
+
+            // optimizer 非空时一并保存 Adam 的 m、v、t
+            void save(const std::string &filename, const Adam *optimizer) const
+            {
+                CheckpointWriter checkpoint;
+                snapshot(checkpoint, optimizer);
+                checkpoint.write(filename);
+                std::cout << "Sequential model saved to " << filename << std::endl;
+            }
+
+            // 把参数（和可选的优化器状态）拷贝进检查点缓冲区，可交给 AsyncCheckpointWriter
+            void snapshot(CheckpointWriter &checkpoint, const Adam *optimizer = nullptr) const
+            {
+                CCTORCH_PROFILE_SCOPE("Sequential::snapshot");
+                std::apply([&](const auto &...layer)
+                           { (save_layer(layer, checkpoint), ...); },
+                           layers);
+                if (optimizer)
+                {
+                    checkpoint.add_optimizer(*optimizer);
+                }
+            }
+
+            void load(const std::string &filename) override
+            {
+                load(filename, nullptr);
+            }
+
+            // 读取检查点格式 v2，或逐层拼接的旧格式
+            void load(const std::string &filename, Adam *optimizer)
+            {
+                if (Checkpoint::is_checkpoint(filename))
+                {
+                    restore(Checkpoint(filename), optimizer);
+                    std::cout << "Sequential model loaded from " << filename << std::endl;
+                    return;
+                }
+                std::ifstream file(filename, std::ios::binary);
+                if (!file.is_open())
+                {
+                    throw std::runtime_error("Failed to open file for reading: " + filename);
+                }
+                std::apply([&](auto &...layer)
+                           { (load_layer(layer, file), ...); },
+                           layers);
+                std::cout << "Sequential model loaded from " << filename << std::endl;
+            }
+
+            // 参数原地写入，之前构造的优化器不需要重新绑定
+            void restore(const Checkpoint &checkpoint, Adam *optimizer = nullptr)
+            {
+                uint32_t index = 0;
+                std::apply([&](auto &...layer)
+                           { (restore_layer(layer, checkpoint, index), ...); },
+                           layers);
+                if (optimizer && checkpoint.has_optimizer_state())
+                {
+                    checkpoint.load_optimizer(*optimizer);
+                }
+            }
+
+        private:
+            template <size_t I>
+            std::vector<Tensor> scalar_forward(const std::vector<Tensor> &x)
+            {
+                if constexpr (I == num_layers)
+                {
+                    return x;
+                }
+                else
+                {
+                    return scalar_forward<I + 1>(std::get<I>(layers).forward(x));
+                }
+            }
+
+            // 前向的一步：单独一层，或者融合的 Linear + ReLU
+            template <size_t I>
+            static constexpr size_t next_step()
+            {
+                return I + (fuses_relu<I>() ? 2 : 1);
+            }
+
+            template <size_t I>
+            DenseTensor step(const DenseTensor &x)
+            {
+                if constexpr (fuses_relu<I>())
+                {
+                    return std::get<I>(layers).forward_relu(x);
+                }
+                else
+                {
+                    return std::get<I>(layers).forward(x);
+                }
+            }
+
+            template <size_t I>
+            DenseTensor dense_forward(const DenseTensor &x)
+            {
+                if constexpr (I == num_layers)
+                {
+                    return x;
+                }
+                else
+                {
+                    if (checkpoint_every > 0 && !NoGradGuard::active())
+                    {
+                        size_t steps = checkpoint_every;
+                        DenseTensor y = x.checkpointed([this, steps](const DenseTensor &in)
+                                                       { return dense_steps<I>(in, steps); });
+                        return skip_steps<I>(y, steps);
+                    }
+                    return dense_forward<next_step<I>()>(step<I>(x));
+                }
+            }
+
+            // 从第 I 层开始执行 count 步（检查点段的内容）
+            template <size_t I>
+            DenseTensor dense_steps(const DenseTensor &x, size_t count)
+            {
+                if constexpr (I == num_layers)
+                {
+                    return x;
+                }
+                else
+                {
+                    return count == 0 ? x : dense_steps<next_step<I>()>(step<I>(x), count - 1);
+                }
+            }
+
+            // 跳过第 I 层开始的 count 步，从下一段继续前向
+            template <size_t I>
+            DenseTensor skip_steps(const DenseTensor &y, size_t count)
+            {
+                if constexpr (I == num_layers)
+                {
+                    return y;
+                }
+                else
+                {
+                    return count == 0 ? dense_forward<I>(y) : skip_steps<next_step<I>()>(y, count - 1);
+                }
+            }
+
+            template <int R>
+            void predict_rows(const float *x, float *y, bool avx2) const
+            {
+                alignas(64) float buffers[2][R * max_width<0>()];
+                predict_from<0, R, in_features>(x, in_features, buffers[0], buffers[1], y, avx2);
+            }
+
+            // src 为第 I 层的输入（R 行、行距 ld、宽度 Width），结果写到 dst，另一个缓冲区留给下一层
+            template <size_t I, int R, int Width>
+            void predict_from(const float *src, size_t ld, float *dst, float *spare, float *y, bool avx2) const
+            {
+                if constexpr (I == num_layers)
+                {
+                    for (int r = 0; r < R; ++r)
+                    {
+                        std::memcpy(y + r * Width, src + r * ld, Width * sizeof(float));
+                    }
+                }
+                else if constexpr (is_linear<layer_t<I>>::value)
+                {
+                    constexpr bool relu = fuses_relu<I>();
+                    constexpr int out = layer_t<I>::out_features;
+                    std::get<I>(layers).template kernel<R, relu>(src, ld, dst, avx2);
+                    predict_from<I + (relu ? 2 : 1), R, out>(dst, out, spare, dst, y, avx2);
+                }
+                else
+                {
+                    for (int r = 0; r < R; ++r)
+                    {
+                        for (int j = 0; j < Width; ++j)
+                        {
+                            dst[r * Width + j] = std::max(src[r * ld + j], 0.0f);
+                        }
+                    }
+                    predict_from<I + 1, R, Width>(dst, Width, spare, dst, y, avx2);
+                }
+            }
+
+            template <class L>
+            static void save_layer(const L &layer, CheckpointWriter &checkpoint)
+            {
+                if constexpr (is_linear<L>::value)
+                {
+                    layer.base().save_to_checkpoint(checkpoint);
+                }
+            }
+
+            template <class L>
+            static void load_layer(L &layer, std::ifstream &file)
+            {
+                if constexpr (is_linear<L>::value)
+                {
+                    layer.base().load_from_stream(file);
+                }
+            }
+
+            template <class L>
+            static void restore_layer(L &layer, const Checkpoint &checkpoint, uint32_t &index)
+            {
+                if constexpr (is_linear<L>::value)
+                {
+                    layer.base().load_from_checkpoint(checkpoint, index++);
+                }
+            }
+
+            layer_tuple layers;
+            size_t checkpoint_every = 0;
+        };
+
+    } // namespace fixed
+
+} // namespace cctorch
+
+#endif // SEQUENTIAL_H
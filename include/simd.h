@@ -0,0 +1,22 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// GCC/Clang 在 x86 上可以用 __attribute__((target(...))) 为单个函数生成 AVX2 代码，
+// 再根据运行时检测结果选择，库本身不需要用 -mavx2 编译
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CCTORCH_X86_SIMD 1
+#endif
+
+namespace cctorch
+{
+
+    // 当前 CPU 是否支持 AVX2 和 FMA（结果在第一次调用时缓存）
+    bool cpu_has_avx2_fma();
+    // 当前 CPU 是否支持 AVX512-VNNI 和 AVX512VL，可以在 256 位寄存器上用 vpdpbusd 做 u8 x s8 点积
+    bool cpu_has_avx512_vnni();
+    // 当前 CPU 是否支持 F16C（fp16 与 fp32 的向量转换）
+    bool cpu_has_f16c();
+
+} // namespace cctorch
+
+#endif // SIMD_H
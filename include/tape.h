@@ -0,0 +1,83 @@
+#ifndef TAPE_H
+#define TAPE_H
+
+#include <vector>
+#include <cstddef>
+#include <memory>
+#include "tensor.h"
+
+namespace cctorch
+{
+
+    // Wengert tape：录制期间每个 Tensor 运算按执行顺序追加一条紧凑记录，
+    // backward 时逆序遍历即为合法的拓扑序，不需要队列和 sons 计数。
+    //
+    //     cctorch::Tape tape;
+    //     for (...)
+    //     {
+    //         cctorch::Tape::Scope tape_scope(tape);
+    //         auto loss = criterion(mlp(inputs), labels);
+    //         loss.backward(); // 自动走 tape
+    //         optimizer.step();
+    //     }
+    //
+    // 每条记录持有结果节点的引用，Scope 内已经析构的临时 Tensor 要到 Scope 结束才释放，
+    // 记录里的裸指针因此始终有效。backward 只执行 root 能够到达的记录，执行过的记录标记为已消耗：
+    // 与 root 无关的临时运算不会向参数累加梯度，同一个 Scope 内再次 backward 也不会重复累加。
+    // Scope 结束时清空记录但保留容量，稳定状态下每步不再有任何分配。
+    //
+    // 多线程录制（Model 按 batch 并行前向时使用）：每个工作单元录制到自己的分片 shards(n)[i]，
+    // 录制时用 Scope(shard, true) 保留记录，全部完成后 merge_shards(n) 按 i 的顺序把记录接到本 tape 末尾，
+    // 得到与串行录制相同的顺序。各分片只能共享录制前已有的节点（例如参数）。
+    class Tape
+    {
+    public:
+        struct tape_record
+        {
+            Tensor::back_type op; // 反向执行过之后置为 NONE
+            std::shared_ptr<tensor_data> out;
+            tensor_data *in1; // 由 out 的父节点引用维持
+            tensor_data *in2;
+        };
+
+        // 在当前线程开启录制，析构时停止录制并清空 tape（keep_records 为 true 时保留记录，用于分片）
+        class Scope
+        {
+        public:
+            explicit Scope(Tape &tape, bool keep_records = false);
+            ~Scope();
+
+            Scope(const Scope &) = delete;
+            Scope &operator=(const Scope &) = delete;
+
+        private:
+            Tape &tape;
+            Tape *previous;
+            bool keep_records;
+        };
+
+        // 当前线程正在录制的 tape，没有时返回 nullptr
+        static Tape *current();
+
+        void record(Tensor::back_type op, std::shared_ptr<tensor_data> out, tensor_data *in1, tensor_data *in2);
+
+        // 从 root 的记录开始逆序执行 root 能够到达、还没有执行过的记录
+        void backward(const Tensor &root);
+
+        // 至少 n 个空分片；返回之后到 merge_shards 之前不要再调用，工作线程各自只访问自己的分片
+        std::vector<Tape> &shards(size_t n);
+        // 把前 n 个分片的记录按顺序追加到本 tape，并清空这些分片（保留容量）
+        void merge_shards(size_t n);
+
+        void clear();
+        size_t size() const;
+
+    private:
+        std::vector<tape_record> records;
+        std::vector<Tape> shard_tapes;
+        std::vector<tensor_data *> reached; // backward 期间打过可达标记的节点，结束时清除标记
+    };
+
+} // namespace cctorch
+
+#endif // TAPE_H
@@ -2,6 +2,7 @@
 #define TENSOR_H
 
 #include <utility>
+#include <atomic>
 #include <memory>
 #include <functional>
 #include <vector>
@@ -10,6 +11,8 @@ namespace cctorch
 {
 
     struct tensor_data;
+    struct reduce_data;
+    class ThreadPool;
 
     class Tensor
     {
@@ -23,7 +26,8 @@ namespace cctorch
             DIV,
             RELU,
             EXP,
-            LOG
+            LOG,
+            REDUCE
         };
 
         std::shared_ptr<tensor_data> data;
@@ -38,6 +42,9 @@ namespace cctorch
         bool topo_decent() const;
 
         void backward();
+        // 多线程反向传播：节点的 sons 计数归零后即可交给任意工作线程，梯度用原子加法累加。
+        // 正在录制 Tape 时退回单线程的 tape 反向传播。不能在 pool 的任务内部调用。
+        void backward(ThreadPool &pool);
 
         Tensor operator+(const Tensor &other) const;
         Tensor operator-(const Tensor &other) const;
@@ -47,18 +54,18 @@ namespace cctorch
         Tensor exp() const;
         Tensor log() const;
 
+        // 多输入融合节点（用于损失函数等归约）：value 由调用者算好，partials[i] 为 d(value)/d(inputs[i])。
+        // 整个归约只占一个图节点，反向时 inputs[i].grad += grad * partials[i]。
+        static Tensor reduce(float value, std::vector<Tensor> inputs, std::vector<float> partials);
+
         void zero_grad();
         void drop_par(int i);
 
+        // 单个节点的反向传播公式，供 backward() 和 Tape 共用
+        static void backward_op(back_type back, tensor_data *out, tensor_data *in1, tensor_data *in2);
+
     private:
         void _backward() const;
-        void add_backward() const;
-        void sub_backward() const;
-        void mul_backward() const;
-        void div_backward() const;
-        void relu_backward() const;
-        void exp_backward() const;
-        void log_backward() const;
     };
 
     struct tensor_data
@@ -67,11 +74,39 @@ namespace cctorch
         float grad;
         Tensor par1;
         Tensor par2;
-        unsigned int sons;
+        std::atomic<unsigned int> sons;
         Tensor::back_type back;
+        std::unique_ptr<reduce_data> reduce; // 仅 REDUCE 节点使用
 
         tensor_data(float value);
         tensor_data(float value, Tensor par1, Tensor par2, Tensor::back_type back);
+#ifdef CCTORCH_PROFILE
+        ~tensor_data(); // 只用于存活节点计数
+#endif
+    };
+
+    // 作用域内关闭梯度记录（推理模式，按线程生效）：Tensor 运算和层的前向只计算数值，
+    // 结果是没有父节点的叶子，不更新 sons，也不录制到 Tape；DenseTensor 的结果不分配梯度缓冲区。
+    class NoGradGuard
+    {
+    public:
+        // no_grad 为 false 时保持当前状态（方便把调用线程的状态传给工作线程）
+        explicit NoGradGuard(bool no_grad = true);
+        ~NoGradGuard();
+
+        NoGradGuard(const NoGradGuard &) = delete;
+        NoGradGuard &operator=(const NoGradGuard &) = delete;
+
+        static bool active();
+
+    private:
+        bool previous;
+    };
+
+    struct reduce_data
+    {
+        std::vector<Tensor> inputs;
+        std::vector<float> partials;
     };
 
     std::vector<Tensor> to_tensor(const std::vector<float> &vec);
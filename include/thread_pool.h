@@ -0,0 +1,78 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cctorch
+{
+
+    // 工作窃取线程池：每个工作线程有自己的任务队列，从队尾取自己的任务（LIFO，缓存友好），
+    // 空闲时从其他线程的队首窃取。工作线程内提交的任务进入自己的队列，外部线程提交的任务轮流分配。
+    // 任务抛出的异常不会终止工作线程：submit 的任务由 wait() 重新抛出，parallel_for 的区间由 parallel_for 自己重新抛出。
+    class ThreadPool
+    {
+    public:
+        /**
+         * @param num_threads 工作线程数，0 表示使用硬件线程数
+         */
+        explicit ThreadPool(size_t num_threads = 0);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        size_t size() const;
+
+        void submit(std::function<void()> task);
+
+        // 等待所有已提交（包括任务中再提交）的任务完成；调用线程也会参与执行。不能在任务内部调用。
+        // 全部完成后重新抛出这期间 submit 的任务抛出的第一个异常（其余的丢弃）
+        void wait();
+
+        /**
+         * 把 [0, n) 切成若干连续区间并行执行 fn(begin, end)，返回前等待全部完成。
+         * 某个区间抛出异常时其余区间照常执行完，再重新抛出第一个异常
+         * @param grain 每个区间的最小长度
+         */
+        void parallel_for(size_t n, const std::function<void(size_t, size_t)> &fn, size_t grain = 1);
+
+        // 当前线程所属工作线程的编号（0..size()-1）；不是本线程池的工作线程时返回 size()
+        size_t worker_index() const;
+
+    private:
+        struct worker_queue
+        {
+            std::mutex mutex;
+            std::deque<std::function<void()>> tasks;
+        };
+
+        void worker_loop(size_t index);
+        bool try_pop(size_t index, std::function<void()> &task);
+        void run_task(std::function<void()> &task);
+        void finish_task();
+
+        std::vector<std::unique_ptr<worker_queue>> queues;
+        std::vector<std::thread> threads;
+        std::mutex wake_mutex;
+        std::condition_variable wake;
+        std::condition_variable done;
+        std::atomic<size_t> pending; // 已提交但未完成
+        std::atomic<size_t> queued;  // 仍在队列中
+        std::atomic<size_t> next_queue;
+        bool stopping;
+        std::mutex error_mutex;
+        std::exception_ptr error; // submit 的任务抛出的第一个异常，由 wait() 取走
+    };
+
+} // namespace cctorch
+
+#endif // THREAD_POOL_H
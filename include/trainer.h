@@ -0,0 +1,182 @@
+#ifndef TRAINER_H
+#define TRAINER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+#include "dense_tensor.h"
+#include "graph_capture.h"
+#include "loss.h"
+#include "model.h"
+#include "profiler.h"
+
+namespace cctorch
+{
+
+    // 带 micro-batch 的训练步：一个逻辑 batch 按 micro_batch_size 行切开，依次前向 + 反向，
+    // 第 i 块的损失按样本比例 b_i / B 缩放，梯度在参数上累加后正好是整个 batch 的平均梯度，最后只调用一次 optimizer.step()。
+    // 峰值激活内存只取决于 micro-batch 的大小，更新与直接用整个 batch 训练相同。
+    // 损失为 CrossEntropyLoss 时每块都交给 GraphCapture，形状与捕获时相同的块直接重放（最后一个不满的块 eager 执行）。
+    // 也可以传任意损失函数 loss(outputs, labels)，返回 [1] 的块平均损失，这时每块 eager 执行：
+    // GraphCapture 只能重放读取标签的 cross_entropy 节点，其他损失从标签构造的目标张量会在捕获时被固定。
+    //
+    //     auto mse = [](const cctorch::DenseTensor &outputs, const std::vector<unsigned char> &labels)
+    //     { return outputs.mse(one_hot(labels, outputs.shape()[1])); }; // one_hot 由调用者提供
+    //     cctorch::Trainer<cctorch::SGD> trainer(model, mse, optimizer, 32);
+    //
+    //     cctorch::Trainer<cctorch::Adam> trainer(mlp, criterion, optimizer, 32); // 逻辑 batch 的大小由 DataLoader 决定
+    //     while (const cctorch::DataBatch *batch = loader.next())
+    //     {
+    //         float loss = trainer.step(batch->images, batch->labels);
+    //     }
+    //
+    // Optimizer 为 SGD 或 Adam。optimizer.set_accumulation_steps(K) 可以叠加使用：每 K 个逻辑 batch 更新一次参数。
+    template <class Optimizer>
+    class Trainer
+    {
+    public:
+        using Loss = std::function<DenseTensor(const DenseTensor &outputs, const std::vector<unsigned char> &labels)>;
+
+        /**
+         * @param micro_batch_size 每次前向的最大行数，0 表示不切分
+         */
+        Trainer(Model &model, CrossEntropyLoss &criterion, Optimizer &optimizer, size_t micro_batch_size = 0)
+            : model(model), optimizer(optimizer), micro_batch_size(micro_batch_size)
+        {
+            capture.emplace(model, criterion);
+        }
+
+        Trainer(Model &model, Loss criterion, Optimizer &optimizer, size_t micro_batch_size = 0)
+            : model(model), loss(std::move(criterion)), optimizer(optimizer), micro_batch_size(micro_batch_size)
+        {
+            if (!loss)
+            {
+                throw std::invalid_argument("Trainer requires a loss function.");
+            }
+        }
+
+        Trainer(const Trainer &) = delete;
+        Trainer &operator=(const Trainer &) = delete;
+
+        // 一个逻辑 batch（images 为 [batch, features]）的训练步，返回整个 batch 的平均损失
+        float step(const DenseTensor &images, const std::vector<unsigned char> &labels)
+        {
+            CCTORCH_PROFILE_SCOPE("Trainer::step");
+            if (images.dim() != 2 || (size_t)images.shape()[0] != labels.size() || labels.empty())
+            {
+                throw std::invalid_argument("Trainer::step expects images of shape [batch, features] and one label per row.");
+            }
+            size_t rows = labels.size();
+            size_t chunk = micro_batch_size == 0 ? rows : std::min(micro_batch_size, rows);
+
+            optimizer.zero_grad();
+            num_correct = 0;
+            num_micro_batches = 0;
+            double total = 0.0;
+            if (chunk == rows)
+            {
+                // 不切分时直接使用整个 batch，不拷贝
+                total = forward_backward(images, labels, 1.0f);
+                count_correct(labels);
+                num_micro_batches = 1;
+            }
+            else
+            {
+                for (size_t begin = 0; begin < rows; begin += chunk)
+                {
+                    size_t n = std::min(chunk, rows - begin);
+                    float scale = static_cast<float>(n) / rows;
+                    micro_labels.assign(labels.begin() + begin, labels.begin() + begin + n);
+                    total += forward_backward(slice(images, begin, n), micro_labels, scale) * scale;
+                    count_correct(micro_labels);
+                    ++num_micro_batches;
+                }
+            }
+            optimizer.step();
+            return static_cast<float>(total);
+        }
+
+        // 最近一个逻辑 batch 中预测正确的样本数，以及它被切成的块数
+        size_t correct() const { return num_correct; }
+        size_t micro_batches() const { return num_micro_batches; }
+
+        void set_micro_batch_size(size_t rows) { micro_batch_size = rows; }
+        size_t micro_batch() const { return micro_batch_size; }
+
+        // 只有以 CrossEntropyLoss 构造时才有 GraphCapture
+        GraphCapture &graph()
+        {
+            if (!capture)
+            {
+                throw std::logic_error("Trainer::graph() is only available when training with CrossEntropyLoss.");
+            }
+            return *capture;
+        }
+
+    private:
+        // 一块的前向 + 反向，反向以 scale 为起点；返回这一块的平均损失
+        float forward_backward(const DenseTensor &input, const std::vector<unsigned char> &labels, float scale)
+        {
+            if (capture)
+            {
+                float value = (*capture)(input, labels, scale);
+                outputs = capture->output();
+                return value;
+            }
+            outputs = model(input);
+            DenseTensor value = loss(outputs, labels);
+            value.backward(scale);
+            return value.item();
+        }
+
+        // 把 images 的第 [begin, begin + n) 行拷进可复用的 micro-batch 张量
+        const DenseTensor &slice(const DenseTensor &images, size_t begin, size_t n)
+        {
+            int cols = images.shape()[1];
+            DenseTensor &part = n == micro_batch_size ? full_part : tail_part;
+            if (!part.data || (size_t)part.shape()[0] != n || part.shape()[1] != cols)
+            {
+                part = DenseTensor({static_cast<int>(n), cols}, 0.0f, false);
+            }
+            std::memcpy(part.value_ptr(), images.value_ptr() + begin * cols, n * cols * sizeof(float));
+            return part;
+        }
+
+        void count_correct(const std::vector<unsigned char> &labels)
+        {
+            size_t classes = outputs.shape()[1];
+            for (size_t r = 0; r < labels.size(); ++r)
+            {
+                size_t best = 0;
+                for (size_t c = 1; c < classes; ++c)
+                {
+                    if (outputs.value(r * classes + c) > outputs.value(r * classes + best))
+                    {
+                        best = c;
+                    }
+                }
+                num_correct += best == labels[r];
+            }
+        }
+
+        Model &model;
+        Loss loss;
+        Optimizer &optimizer;
+        std::optional<GraphCapture> capture;
+        size_t micro_batch_size;
+
+        DenseTensor outputs; // 最近一块的模型输出
+        DenseTensor full_part;
+        DenseTensor tail_part;
+        std::vector<unsigned char> micro_labels;
+        size_t num_correct = 0;
+        size_t num_micro_batches = 0;
+    };
+
+} // namespace cctorch
+
+#endif // TRAINER_H
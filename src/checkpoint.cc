@@ -0,0 +1,812 @@
+#include "../include/checkpoint.h"
+#include "../include/profiler.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <fstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace cctorch
+{
+
+    namespace
+    {
+        constexpr size_t header_size = 64;
+
+        struct checkpoint_header
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t num_blobs;
+            int64_t adam_t;
+            uint32_t flags;
+            uint32_t reserved0;
+            uint64_t base_id;
+            uint8_t reserved[24];
+        };
+        static_assert(sizeof(checkpoint_header) == header_size, "checkpoint header must stay 64 bytes");
+
+        size_t align_up(size_t n)
+        {
+            return (n + checkpoint_alignment - 1) / checkpoint_alignment * checkpoint_alignment;
+        }
+
+        size_t entry_numel(const CheckpointEntry &entry)
+        {
+            size_t numel = 1;
+            for (uint32_t d = 0; d < entry.ndim && d < 4; ++d)
+            {
+                numel *= entry.shape[d];
+            }
+            return numel;
+        }
+
+        bool same_shape(const CheckpointEntry &a, const CheckpointEntry &b)
+        {
+            return a.ndim == b.ndim && std::equal(a.shape, a.shape + a.ndim, b.shape);
+        }
+
+        void append(std::vector<uint8_t> &out, const void *data, size_t bytes)
+        {
+            const uint8_t *p = static_cast<const uint8_t *>(data);
+            out.insert(out.end(), p, p + bytes);
+        }
+
+        void append_u32(std::vector<uint8_t> &out, uint32_t value)
+        {
+            append(out, &value, sizeof(value));
+        }
+
+        // 增量 blob 的编码（均为小端序）：
+        //   u32 块大小、u32 块数、变化块位图（按 4 字节补齐），
+        //   然后每个变化块：u8 模式、u32 负载字节数、负载。
+        // 负载是块内与基准异或后的 32 位字按字节平面排列（最高字节平面在前）：
+        // 模式 0 把每段连续的 0 字节写成 (0, 长度)，模式 1 原样保存（压缩反而变大时）。
+        enum block_mode : uint8_t
+        {
+            BLOCK_RLE = 0,
+            BLOCK_RAW = 1
+        };
+
+        void encode_block(const float *current, const float *base, size_t n, std::vector<uint8_t> &planes, std::vector<uint8_t> &out)
+        {
+            planes.resize(4 * n);
+            for (size_t i = 0; i < n; ++i)
+            {
+                uint32_t a, b;
+                std::memcpy(&a, current + i, sizeof(a));
+                std::memcpy(&b, base + i, sizeof(b));
+                uint32_t x = a ^ b;
+                planes[i] = x >> 24;
+                planes[n + i] = x >> 16;
+                planes[2 * n + i] = x >> 8;
+                planes[3 * n + i] = x;
+            }
+
+            size_t header = out.size();
+            out.push_back(BLOCK_RLE);
+            append_u32(out, 0);
+            size_t start = out.size();
+            for (size_t i = 0; i < planes.size() && out.size() - start < planes.size();)
+            {
+                if (planes[i] != 0)
+                {
+                    out.push_back(planes[i++]);
+                    continue;
+                }
+                size_t run = 1;
+                while (run < 255 && i + run < planes.size() && planes[i + run] == 0)
+                {
+                    ++run;
+                }
+                out.push_back(0);
+                out.push_back(static_cast<uint8_t>(run));
+                i += run;
+            }
+            if (out.size() - start >= planes.size())
+            {
+                out.resize(start);
+                append(out, planes.data(), planes.size());
+                out[header] = BLOCK_RAW;
+            }
+            uint32_t payload = out.size() - start;
+            std::memcpy(out.data() + header + 1, &payload, sizeof(payload));
+        }
+
+        // 解码一个块并叠加到 base 上，输入损坏时返回 false
+        bool decode_block(const uint8_t *&p, const uint8_t *end, const float *base, size_t n, std::vector<uint8_t> &planes, float *out)
+        {
+            if (end - p < 5)
+            {
+                return false;
+            }
+            uint8_t mode = p[0];
+            uint32_t payload;
+            std::memcpy(&payload, p + 1, sizeof(payload));
+            p += 5;
+            if ((size_t)(end - p) < payload)
+            {
+                return false;
+            }
+            const uint8_t *src = p, *src_end = p + payload;
+            p = src_end;
+
+            planes.resize(4 * n);
+            if (mode == BLOCK_RAW)
+            {
+                if (payload != planes.size())
+                {
+                    return false;
+                }
+                std::memcpy(planes.data(), src, payload);
+            }
+            else if (mode == BLOCK_RLE)
+            {
+                size_t j = 0;
+                while (src < src_end)
+                {
+                    if (*src != 0)
+                    {
+                        if (j == planes.size())
+                        {
+                            return false;
+                        }
+                        planes[j++] = *src++;
+                        continue;
+                    }
+                    if (src_end - src < 2 || src[1] == 0 || planes.size() - j < src[1])
+                    {
+                        return false;
+                    }
+                    std::memset(planes.data() + j, 0, src[1]);
+                    j += src[1];
+                    src += 2;
+                }
+                if (j != planes.size())
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                return false;
+            }
+
+            for (size_t i = 0; i < n; ++i)
+            {
+                uint32_t x = (uint32_t)planes[i] << 24 | (uint32_t)planes[n + i] << 16 | (uint32_t)planes[2 * n + i] << 8 | planes[3 * n + i];
+                uint32_t b;
+                std::memcpy(&b, base + i, sizeof(b));
+                b ^= x;
+                std::memcpy(out + i, &b, sizeof(b));
+            }
+            return true;
+        }
+
+        void encode_delta(const float *current, const float *base, size_t numel, std::vector<uint8_t> &planes, std::vector<uint8_t> &out)
+        {
+            size_t num_blocks = (numel + checkpoint_delta_block - 1) / checkpoint_delta_block;
+            out.clear();
+            append_u32(out, checkpoint_delta_block);
+            append_u32(out, num_blocks);
+            size_t bitmap = out.size();
+            out.resize(bitmap + (num_blocks + 31) / 32 * 4, 0);
+            for (size_t b = 0; b < num_blocks; ++b)
+            {
+                size_t begin = b * checkpoint_delta_block;
+                size_t n = std::min(checkpoint_delta_block, numel - begin);
+                if (std::memcmp(current + begin, base + begin, n * sizeof(float)) == 0)
+                {
+                    continue; // 未变化的块不保存
+                }
+                out[bitmap + b / 8] |= 1u << (b % 8);
+                encode_block(current + begin, base + begin, n, planes, out);
+            }
+        }
+
+        bool decode_delta(const uint8_t *p, size_t bytes, const float *base, size_t numel, float *out)
+        {
+            const uint8_t *end = p + bytes;
+            uint32_t block, num_blocks;
+            if (bytes < 8)
+            {
+                return false;
+            }
+            std::memcpy(&block, p, sizeof(block));
+            std::memcpy(&num_blocks, p + 4, sizeof(num_blocks));
+            if (block == 0 || num_blocks != (numel + block - 1) / block)
+            {
+                return false;
+            }
+            const uint8_t *bitmap = p + 8;
+            size_t bitmap_bytes = (num_blocks + 31) / 32 * 4;
+            if ((size_t)(end - bitmap) < bitmap_bytes)
+            {
+                return false;
+            }
+            p = bitmap + bitmap_bytes;
+
+            std::vector<uint8_t> planes;
+            for (size_t b = 0; b < num_blocks; ++b)
+            {
+                size_t begin = b * block;
+                size_t n = std::min<size_t>(block, numel - begin);
+                if (!(bitmap[b / 8] & (1u << (b % 8))))
+                {
+                    std::memcpy(out + begin, base + begin, n * sizeof(float));
+                }
+                else if (!decode_block(p, end, base + begin, n, planes, out + begin))
+                {
+                    return false;
+                }
+            }
+            return p == end;
+        }
+
+        // 顺序写文件，关闭前把数据刷到磁盘；不支持 POSIX 的平台退回 ofstream（不 fsync）
+        class output_file
+        {
+        public:
+            explicit output_file(const std::string &path) : path(path)
+            {
+#ifdef _WIN32
+                stream.open(path, std::ios::binary | std::ios::trunc);
+                if (!stream.is_open())
+#else
+                fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                if (fd < 0)
+#endif
+                {
+                    throw std::runtime_error("Failed to open file for writing: " + path);
+                }
+            }
+
+            ~output_file()
+            {
+#ifndef _WIN32
+                if (fd >= 0)
+                {
+                    ::close(fd);
+                }
+#endif
+            }
+
+            void write(const void *data, size_t bytes)
+            {
+#ifdef _WIN32
+                stream.write(static_cast<const char *>(data), bytes);
+                if (!stream)
+                {
+                    throw std::runtime_error("Failed to write checkpoint: " + path);
+                }
+#else
+                const char *p = static_cast<const char *>(data);
+                while (bytes > 0)
+                {
+                    ssize_t n = ::write(fd, p, bytes);
+                    if (n < 0 && errno == EINTR)
+                    {
+                        continue;
+                    }
+                    if (n <= 0)
+                    {
+                        throw std::runtime_error("Failed to write checkpoint: " + path);
+                    }
+                    p += n;
+                    bytes -= n;
+                }
+#endif
+            }
+
+            void sync_and_close()
+            {
+#ifdef _WIN32
+                stream.close();
+                if (!stream)
+#else
+                int result = ::fsync(fd);
+                result |= ::close(fd);
+                fd = -1;
+                if (result != 0)
+#endif
+                {
+                    throw std::runtime_error("Failed to flush checkpoint: " + path);
+                }
+            }
+
+        private:
+            std::string path;
+#ifdef _WIN32
+            std::ofstream stream;
+#else
+            int fd = -1;
+#endif
+        };
+
+        // 让重命名本身也落盘
+        void sync_directory(const std::string &filename)
+        {
+#ifndef _WIN32
+            std::string dir = std::filesystem::path(filename).parent_path().string();
+            int fd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY);
+            if (fd >= 0)
+            {
+                ::fsync(fd);
+                ::close(fd);
+            }
+#endif
+        }
+    }
+
+    uint64_t checkpoint_checksum(const void *data, size_t bytes)
+    {
+        const uint8_t *p = static_cast<const uint8_t *>(data);
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < bytes; ++i)
+        {
+            hash ^= p[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    uint32_t CheckpointWriter::begin_layer(uint32_t layer_type)
+    {
+        layer_types.push_back(layer_type);
+        return layer_types.size() - 1;
+    }
+
+    CheckpointWriter::blob &CheckpointWriter::append_blob(uint32_t layer, CheckpointKind kind, const std::vector<int> &shape, CheckpointDType dtype)
+    {
+        if (shape.empty() || shape.size() > 4)
+        {
+            throw std::invalid_argument("CheckpointWriter::add supports 1 to 4 dimensions, got " + std::to_string(shape.size()));
+        }
+        size_t numel = 1;
+        for (int d : shape)
+        {
+            numel *= d;
+        }
+
+        if (count == blobs.size())
+        {
+            blobs.emplace_back();
+        }
+        blob &b = blobs[count++];
+        b.entry = CheckpointEntry{};
+        b.entry.layer = layer;
+        b.entry.layer_type = layer < layer_types.size() ? layer_types[layer] : 0;
+        b.entry.kind = static_cast<uint32_t>(kind);
+        b.entry.dtype = static_cast<uint32_t>(dtype);
+        b.entry.ndim = shape.size();
+        for (size_t i = 0; i < shape.size(); ++i)
+        {
+            b.entry.shape[i] = shape[i];
+        }
+        b.dtype = dtype;
+        b.bytes = dtype == CheckpointDType::INT8 ? numel : numel * sizeof(float);
+        b.entry.bytes = b.bytes;
+        // 复用时容量通常已经足够，不会重新分配
+        b.values.resize((b.bytes + sizeof(float) - 1) / sizeof(float));
+        return b;
+    }
+
+    float *CheckpointWriter::allocate(uint32_t layer, CheckpointKind kind, const std::vector<int> &shape)
+    {
+        return append_blob(layer, kind, shape, CheckpointDType::FLOAT32).values.data();
+    }
+
+    int8_t *CheckpointWriter::allocate_int8(uint32_t layer, CheckpointKind kind, const std::vector<int> &shape)
+    {
+        return reinterpret_cast<int8_t *>(append_blob(layer, kind, shape, CheckpointDType::INT8).values.data());
+    }
+
+    void CheckpointWriter::add(uint32_t layer, CheckpointKind kind, const std::vector<int> &shape, const float *values)
+    {
+        float *dst = allocate(layer, kind, shape);
+        std::memcpy(dst, values, blobs[count - 1].entry.bytes);
+    }
+
+    void CheckpointWriter::add(uint32_t layer, CheckpointKind kind, const std::vector<int> &shape, const std::vector<float> &values)
+    {
+        float *dst = allocate(layer, kind, shape);
+        if (blobs[count - 1].entry.bytes != values.size() * sizeof(float))
+        {
+            --count;
+            throw std::invalid_argument("CheckpointWriter::add: shape does not match " + std::to_string(values.size()) + " values");
+        }
+        std::memcpy(dst, values.data(), values.size() * sizeof(float));
+    }
+
+    void CheckpointWriter::add_optimizer(const Adam &optimizer)
+    {
+        int n = (int)optimizer.numel();
+        add(checkpoint_no_layer, CheckpointKind::ADAM_M, {n}, optimizer.m.get());
+        add(checkpoint_no_layer, CheckpointKind::ADAM_V, {n}, optimizer.v.get());
+        adam_t = optimizer.t;
+    }
+
+    void CheckpointWriter::clear()
+    {
+        count = 0;
+        layer_types.clear();
+        adam_t = -1;
+    }
+
+    void CheckpointWriter::write(const std::string &filename)
+    {
+        write_file(filename, nullptr);
+    }
+
+    void CheckpointWriter::write_delta(const std::string &filename, const Checkpoint &base)
+    {
+        write_file(filename, &base);
+    }
+
+    void CheckpointWriter::write_file(const std::string &filename, const Checkpoint *base)
+    {
+        CCTORCH_PROFILE_SCOPE("CheckpointWriter::write");
+        // 增量模式下先把能对上基准的 blob 编码，其余 blob 仍写原始数据
+        if (encoded.size() < count)
+        {
+            encoded.resize(count);
+        }
+        std::vector<uint8_t> planes;
+        std::vector<const void *> payloads(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            CheckpointEntry &entry = blobs[i].entry;
+            entry.dtype = static_cast<uint32_t>(blobs[i].dtype);
+            entry.bytes = blobs[i].bytes;
+            payloads[i] = blobs[i].values.data();
+            // 只对 float blob 做增量编码，基准中对应的 blob 也必须是 float（完整或增量）
+            const CheckpointEntry *reference = base && blobs[i].dtype == CheckpointDType::FLOAT32
+                                                   ? base->lookup(entry.layer, static_cast<CheckpointKind>(entry.kind))
+                                                   : nullptr;
+            if (reference && reference->dtype != static_cast<uint32_t>(CheckpointDType::INT8) && same_shape(entry, *reference))
+            {
+                encode_delta(blobs[i].values.data(), base->values(*reference), blobs[i].values.size(), planes, encoded[i]);
+                entry.dtype = static_cast<uint32_t>(CheckpointDType::DELTA_XOR);
+                entry.bytes = encoded[i].size();
+                payloads[i] = encoded[i].data();
+            }
+        }
+
+        // 再算出每个 blob 的对齐偏移和校验和，头部和层表拼成一块写出
+        size_t offset = align_up(header_size + count * sizeof(CheckpointEntry));
+        std::vector<uint8_t> head(offset, 0);
+        checkpoint_header header{};
+        std::memcpy(header.magic, checkpoint_magic, sizeof(header.magic));
+        header.version = checkpoint_version;
+        header.num_blobs = count;
+        header.adam_t = adam_t;
+        header.flags = base ? checkpoint_flag_delta : 0;
+        header.base_id = base ? base->id() : 0;
+        std::memcpy(head.data(), &header, sizeof(header));
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            CheckpointEntry &entry = blobs[i].entry;
+            entry.offset = offset;
+            entry.checksum = checkpoint_checksum(payloads[i], entry.bytes);
+            std::memcpy(head.data() + header_size + i * sizeof(CheckpointEntry), &entry, sizeof(entry));
+            offset = align_up(offset + entry.bytes);
+        }
+
+        std::string temp = filename + ".tmp";
+        {
+            output_file file(temp);
+            file.write(head.data(), head.size());
+            static const char padding[checkpoint_alignment] = {};
+            size_t position = head.size();
+            for (size_t i = 0; i < count; ++i)
+            {
+                const CheckpointEntry &entry = blobs[i].entry;
+                file.write(padding, entry.offset - position);
+                file.write(payloads[i], entry.bytes);
+                position = entry.offset + entry.bytes;
+            }
+            file.sync_and_close();
+        }
+        std::error_code ec;
+        std::filesystem::rename(temp, filename, ec);
+        if (ec)
+        {
+            throw std::runtime_error("Failed to rename " + temp + " to " + filename + ": " + ec.message());
+        }
+        sync_directory(filename);
+    }
+
+    AsyncCheckpointWriter::AsyncCheckpointWriter()
+        : worker(&AsyncCheckpointWriter::worker_loop, this)
+    {
+    }
+
+    AsyncCheckpointWriter::~AsyncCheckpointWriter()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        worker.join();
+    }
+
+    CheckpointWriter &AsyncCheckpointWriter::snapshot()
+    {
+        // front 永远不是后台线程正在写的那个缓冲区
+        buffers[front].clear();
+        return buffers[front];
+    }
+
+    void AsyncCheckpointWriter::commit(const std::string &filename, const Checkpoint *base)
+    {
+        CCTORCH_PROFILE_SCOPE("AsyncCheckpointWriter::commit"); // 包括等待上一次写完的时间
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]
+                { return pending == nullptr; });
+        rethrow_error();
+        pending = &buffers[front];
+        pending_path = filename;
+        pending_base = base;
+        front ^= 1;
+        lock.unlock();
+        cv.notify_all();
+    }
+
+    void AsyncCheckpointWriter::wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]
+                { return pending == nullptr; });
+        rethrow_error();
+    }
+
+    bool AsyncCheckpointWriter::busy() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return pending != nullptr;
+    }
+
+    void AsyncCheckpointWriter::rethrow_error()
+    {
+        if (error)
+        {
+            std::exception_ptr e = error;
+            error = nullptr;
+            std::rethrow_exception(e);
+        }
+    }
+
+    void AsyncCheckpointWriter::worker_loop()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            // 退出前把已经提交的快照写完
+            cv.wait(lock, [&]
+                    { return pending != nullptr || stopping; });
+            if (!pending)
+            {
+                return;
+            }
+            CheckpointWriter *job = pending;
+            std::string path = pending_path;
+            const Checkpoint *base = pending_base;
+            lock.unlock();
+            std::exception_ptr failure;
+            try
+            {
+                if (base)
+                {
+                    job->write_delta(path, *base);
+                }
+                else
+                {
+                    job->write(path);
+                }
+            }
+            catch (...)
+            {
+                failure = std::current_exception();
+            }
+            lock.lock();
+            if (failure)
+            {
+                error = failure;
+            }
+            pending = nullptr;
+            cv.notify_all();
+        }
+    }
+
+    Checkpoint::Checkpoint(const std::string &filename, bool verify)
+        : path(filename), file(filename)
+    {
+        open(verify);
+        if (is_delta())
+        {
+            throw std::runtime_error("Checkpoint " + filename + " is a delta checkpoint; open it together with its base");
+        }
+    }
+
+    Checkpoint::Checkpoint(const std::string &filename, const Checkpoint &base, bool verify)
+        : path(filename), file(filename)
+    {
+        open(verify);
+        if (is_delta())
+        {
+            if (base_id != base.id())
+            {
+                throw std::runtime_error("Delta checkpoint " + filename + " was written against a different base than " + base.path);
+            }
+            decode(base);
+        }
+    }
+
+    void Checkpoint::open(bool verify)
+    {
+        if (file.size() < header_size || std::memcmp(file.data(), checkpoint_magic, sizeof(checkpoint_magic)) != 0)
+        {
+            throw std::runtime_error("Not a CcTorch checkpoint: " + path);
+        }
+        checkpoint_header header;
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (header.version != checkpoint_version)
+        {
+            throw std::runtime_error("Unsupported checkpoint version " + std::to_string(header.version) + " in " + path);
+        }
+        size_t table_end = header_size + (size_t)header.num_blobs * sizeof(CheckpointEntry);
+        if (table_end > file.size())
+        {
+            throw std::runtime_error("Truncated checkpoint table in " + path);
+        }
+        table.resize(header.num_blobs);
+        std::memcpy(table.data(), file.data() + header_size, header.num_blobs * sizeof(CheckpointEntry));
+        adam_t = header.adam_t;
+        flags = header.flags;
+        base_id = header.base_id;
+        checkpoint_id = checkpoint_checksum(file.data(), table_end);
+
+        for (size_t i = 0; i < table.size(); ++i)
+        {
+            const CheckpointEntry &entry = table[i];
+            bool delta = entry.dtype == static_cast<uint32_t>(CheckpointDType::DELTA_XOR);
+            bool int8 = entry.dtype == static_cast<uint32_t>(CheckpointDType::INT8);
+            if (entry.dtype != static_cast<uint32_t>(CheckpointDType::FLOAT32) && !int8 && !(delta && is_delta()))
+            {
+                throw std::runtime_error("Unsupported dtype in checkpoint blob " + std::to_string(i) + " of " + path);
+            }
+            // 维度必须为正：两个负数相乘也能凑出与字节数吻合的元素个数
+            bool positive = entry.ndim > 0 && entry.ndim <= 4 &&
+                            std::all_of(entry.shape, entry.shape + entry.ndim, [](int32_t d)
+                                        { return d > 0; });
+            if (!positive || (!delta && entry.bytes != entry_numel(entry) * (int8 ? 1 : sizeof(float))))
+            {
+                throw std::runtime_error("Invalid shape in checkpoint blob " + std::to_string(i) + " of " + path);
+            }
+            if (entry.offset % checkpoint_alignment != 0 || entry.offset < table_end ||
+                entry.bytes > file.size() || entry.offset > file.size() - entry.bytes)
+            {
+                throw std::runtime_error("Checkpoint blob " + std::to_string(i) + " is out of bounds in " + path);
+            }
+            if (verify && checkpoint_checksum(file.data() + entry.offset, entry.bytes) != entry.checksum)
+            {
+                throw std::runtime_error("Checksum mismatch in checkpoint blob " + std::to_string(i) + " of " + path);
+            }
+        }
+    }
+
+    void Checkpoint::decode(const Checkpoint &base)
+    {
+        decoded.resize(table.size());
+        for (size_t i = 0; i < table.size(); ++i)
+        {
+            const CheckpointEntry &entry = table[i];
+            if (entry.dtype != static_cast<uint32_t>(CheckpointDType::DELTA_XOR))
+            {
+                continue;
+            }
+            const CheckpointEntry *reference = base.lookup(entry.layer, static_cast<CheckpointKind>(entry.kind));
+            if (!reference || reference->dtype == static_cast<uint32_t>(CheckpointDType::INT8) || !same_shape(entry, *reference))
+            {
+                throw std::runtime_error("Base checkpoint " + base.path + " has no matching blob for delta blob " + std::to_string(i) + " of " + path);
+            }
+            size_t numel = entry_numel(entry);
+            decoded[i].resize(numel);
+            if (!decode_delta(file.data() + entry.offset, entry.bytes, base.values(*reference), numel, decoded[i].data()))
+            {
+                throw std::runtime_error("Corrupt delta blob " + std::to_string(i) + " in " + path);
+            }
+        }
+    }
+
+    bool Checkpoint::is_checkpoint(const std::string &filename)
+    {
+        std::ifstream file(filename, std::ios::binary);
+        char magic[sizeof(checkpoint_magic)];
+        if (!file.read(magic, sizeof(magic)))
+        {
+            return false;
+        }
+        return std::memcmp(magic, checkpoint_magic, sizeof(magic)) == 0;
+    }
+
+    const CheckpointEntry *Checkpoint::lookup(uint32_t layer, CheckpointKind kind) const
+    {
+        for (const auto &entry : table)
+        {
+            if (entry.layer == layer && entry.kind == static_cast<uint32_t>(kind))
+            {
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+    const CheckpointEntry &Checkpoint::find(uint32_t layer, CheckpointKind kind) const
+    {
+        const CheckpointEntry *entry = lookup(layer, kind);
+        if (!entry)
+        {
+            throw std::runtime_error("Checkpoint " + path + " has no blob of kind " + std::to_string(static_cast<uint32_t>(kind)) +
+                                     " for layer " + std::to_string(layer));
+        }
+        return *entry;
+    }
+
+    const float *Checkpoint::values(const CheckpointEntry &entry) const
+    {
+        if (entry.dtype == static_cast<uint32_t>(CheckpointDType::INT8))
+        {
+            throw std::runtime_error("Checkpoint blob of layer " + std::to_string(entry.layer) + " in " + path + " is int8, not float");
+        }
+        // 增量 blob 的数据在 decoded 里，entry 必须来自本检查点的 entries()/find()/lookup()
+        if (!decoded.empty() && std::less_equal<const CheckpointEntry *>()(table.data(), &entry) &&
+            std::less<const CheckpointEntry *>()(&entry, table.data() + table.size()))
+        {
+            const std::vector<float> &values = decoded[&entry - table.data()];
+            if (!values.empty())
+            {
+                return values.data();
+            }
+        }
+        return reinterpret_cast<const float *>(file.data() + entry.offset);
+    }
+
+    const int8_t *Checkpoint::int8_values(const CheckpointEntry &entry) const
+    {
+        if (entry.dtype != static_cast<uint32_t>(CheckpointDType::INT8))
+        {
+            throw std::runtime_error("Checkpoint blob of layer " + std::to_string(entry.layer) + " in " + path + " is not int8");
+        }
+        return reinterpret_cast<const int8_t *>(file.data() + entry.offset);
+    }
+
+    void Checkpoint::load_optimizer(Adam &optimizer) const
+    {
+        if (!has_optimizer_state())
+        {
+            throw std::runtime_error("Checkpoint " + path + " has no optimizer state");
+        }
+        const CheckpointEntry &m = find(checkpoint_no_layer, CheckpointKind::ADAM_M);
+        const CheckpointEntry &v = find(checkpoint_no_layer, CheckpointKind::ADAM_V);
+        size_t n = optimizer.numel();
+        if (entry_numel(m) != n || entry_numel(v) != n)
+        {
+            throw std::runtime_error("Optimizer state in " + path + " has " + std::to_string(entry_numel(m)) +
+                                     " entries, optimizer has " + std::to_string(n));
+        }
+        std::memcpy(optimizer.m.get(), values(m), n * sizeof(float));
+        std::memcpy(optimizer.v.get(), values(v), n * sizeof(float));
+        optimizer.t = (int)adam_t;
+    }
+
+} // namespace cctorch
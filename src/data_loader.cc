@@ -0,0 +1,197 @@
+#include "../include/data_loader.h"
+#include "../include/profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+
+namespace cctorch
+{
+
+    DataLoader::DataLoader(const IDXDataset &dataset, const DataLoaderOptions &options)
+        : dataset(dataset), options(options), next_ticket(0), stopping(false), oldest_epoch(0)
+    {
+        if (this->options.batch_size == 0 || this->options.num_workers == 0)
+        {
+            throw std::invalid_argument("DataLoader requires batch_size > 0 and num_workers > 0.");
+        }
+        if (this->options.std <= 0.0f)
+        {
+            throw std::invalid_argument("DataLoader requires std > 0.");
+        }
+        this->options.prefetch = std::max<size_t>(this->options.prefetch, 2);
+        if (this->options.seed == 0)
+        {
+            this->options.seed = std::random_device{}();
+        }
+        per_epoch = dataset.num_batches(this->options.batch_size, this->options.drop_last);
+        if (per_epoch == 0)
+        {
+            throw std::invalid_argument("DataLoader: dataset has fewer samples than one batch.");
+        }
+
+        for (size_t i = 0; i < this->options.prefetch; ++i)
+        {
+            slots.push_back(std::make_unique<slot>());
+            slots.back()->state.store(2 * i, std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < this->options.num_workers; ++i)
+        {
+            workers.emplace_back(&DataLoader::worker_loop, this);
+        }
+    }
+
+    DataLoader::~DataLoader()
+    {
+        stopping.store(true, std::memory_order_release);
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    bool DataLoader::wait_for(const std::atomic<uint64_t> &state, uint64_t expected) const
+    {
+        // 先让出时间片，等待时间变长后改为短暂休眠，避免空转占满 CPU
+        for (int spin = 0; state.load(std::memory_order_acquire) != expected; ++spin)
+        {
+            if (stopping.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+            if (spin < 64)
+            {
+                std::this_thread::yield();
+            }
+            else
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        }
+        return true;
+    }
+
+    const DataBatch *DataLoader::next()
+    {
+        CCTORCH_PROFILE_SCOPE("DataLoader::next"); // 训练线程等待 batch 的时间
+        size_t n = slots.size();
+        if (holding)
+        {
+            // 归还上一次的槽位，留给 n 个序号之后的 batch
+            slots[(consumer_ticket - 1) % n]->state.store(2 * (consumer_ticket - 1 + n), std::memory_order_release);
+            holding = false;
+        }
+        if (consumer_index == per_epoch)
+        {
+            consumer_index = 0;
+            ++consumer_epoch;
+            oldest_epoch.store(consumer_epoch, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        slot &s = *slots[consumer_ticket % n];
+        if (!wait_for(s.state, 2 * consumer_ticket + 1))
+        {
+            return nullptr;
+        }
+        ++consumer_ticket;
+        ++consumer_index;
+        holding = true;
+        return &s.batch;
+    }
+
+    void DataLoader::worker_loop()
+    {
+        size_t n = slots.size();
+        while (!stopping.load(std::memory_order_acquire))
+        {
+            uint64_t ticket = next_ticket.fetch_add(1, std::memory_order_relaxed);
+            slot &s = *slots[ticket % n];
+            if (!wait_for(s.state, 2 * ticket))
+            {
+                return;
+            }
+            fill(s.batch, ticket);
+            s.state.store(2 * ticket + 1, std::memory_order_release);
+        }
+    }
+
+    std::shared_ptr<const std::vector<uint32_t>> DataLoader::order_for(size_t epoch)
+    {
+        std::lock_guard<std::mutex> lock(order_mutex);
+        // 训练线程已经离开的 epoch 不会再被用到
+        orders.erase(orders.begin(), orders.lower_bound(oldest_epoch.load(std::memory_order_relaxed)));
+        auto it = orders.find(epoch);
+        if (it != orders.end())
+        {
+            return it->second;
+        }
+        auto order = std::make_shared<std::vector<uint32_t>>(dataset.size());
+        std::iota(order->begin(), order->end(), 0u);
+        if (options.shuffle)
+        {
+            std::mt19937_64 rng(options.seed + epoch);
+            std::shuffle(order->begin(), order->end(), rng);
+        }
+        orders.emplace(epoch, order);
+        return order;
+    }
+
+    void DataLoader::fill(DataBatch &batch, uint64_t ticket)
+    {
+        CCTORCH_PROFILE_SCOPE("DataLoader::fill"); // 工作线程组装 batch 的时间
+        size_t epoch = ticket / per_epoch;
+        size_t index = ticket % per_epoch;
+        auto order = order_for(epoch);
+
+        size_t start = index * options.batch_size;
+        size_t size = std::min(options.batch_size, dataset.size() - start);
+        size_t image_size = dataset.image_size();
+        batch.epoch = epoch;
+        batch.index = index;
+        batch.size = size;
+
+        // 缓冲区只在 batch 大小变化时（每个 epoch 最后一个不满的 batch）重新分配
+        if (!batch.images.data || batch.images.shape()[0] != (int)size)
+        {
+            batch.images = DenseTensor({(int)size, (int)image_size}, 0.0f, false);
+        }
+        batch.labels.resize(size);
+
+        float *dst = batch.images.value_ptr();
+        const uint8_t *pixels = dataset.pixels();
+        const uint8_t *labels = dataset.labels();
+        for (size_t i = 0; i < size; ++i)
+        {
+            uint32_t sample = (*order)[start + i];
+            normalize_pixels(pixels + (size_t)sample * image_size, dst + i * image_size, image_size, options.mean, options.std);
+            batch.labels[i] = labels[sample];
+        }
+
+        if (options.scalar_tensors)
+        {
+            // 复用已有的叶子节点，只更新数值
+            batch.tensors.resize(size);
+            for (size_t i = 0; i < size; ++i)
+            {
+                auto &row = batch.tensors[i];
+                if (row.size() != image_size)
+                {
+                    row.clear();
+                    for (size_t p = 0; p < image_size; ++p)
+                    {
+                        row.emplace_back(0.0f);
+                    }
+                }
+                const float *values = dst + i * image_size;
+                for (size_t p = 0; p < image_size; ++p)
+                {
+                    row[p].data->value = values[p];
+                    row[p].data->grad = 0.0f;
+                }
+            }
+        }
+    }
+
+} // namespace cctorch
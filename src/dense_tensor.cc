@@ -0,0 +1,1498 @@
+#include "../include/dense_tensor.h"
+#include "../include/gemm.h"
+#include "../include/profiler.h"
+#include <queue>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+namespace cctorch
+{
+
+    namespace
+    {
+        constexpr size_t kAlignment = 64;
+
+        // 记录一次对 t 的引用；NoGradGuard 作用域内不建立计算图，也就不需要计数
+        void link(const DenseTensor &t)
+        {
+            if (!NoGradGuard::active())
+            {
+                t.data->sons++;
+            }
+        }
+
+        // 标量视图的第一个节点 -> 拥有这个视图的参数。from_parameters 用它把旧接口返回的标量参数映射回原来的连续参数
+        std::mutex view_owners_mutex;
+        std::unordered_map<const tensor_data *, std::weak_ptr<dense_data>> view_owners;
+
+        void register_view(const std::shared_ptr<dense_data> &owner)
+        {
+            auto view = std::atomic_load(&owner->view);
+            if (view && !view->empty())
+            {
+                std::lock_guard<std::mutex> lock(view_owners_mutex);
+                view_owners[view->front().data.get()] = owner;
+            }
+        }
+
+        // 在拥有者析构时调用，此时它的 weak_ptr 已经失效
+        void unregister_view(const std::vector<Tensor> &view)
+        {
+            if (view.empty())
+            {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(view_owners_mutex);
+            auto it = view_owners.find(view.front().data.get());
+            if (it != view_owners.end() && it->second.expired())
+            {
+                view_owners.erase(it);
+            }
+        }
+
+        std::shared_ptr<dense_data> view_owner(const tensor_data *first)
+        {
+            std::lock_guard<std::mutex> lock(view_owners_mutex);
+            auto it = view_owners.find(first);
+            return it == view_owners.end() ? nullptr : it->second.lock();
+        }
+
+        std::vector<int> contiguous_strides(const std::vector<int> &shape)
+        {
+            std::vector<int> strides(shape.size(), 1);
+            for (int i = (int)shape.size() - 2; i >= 0; --i)
+            {
+                strides[i] = strides[i + 1] * shape[i + 1];
+            }
+            return strides;
+        }
+
+        size_t shape_numel(const std::vector<int> &shape)
+        {
+            size_t n = 1;
+            for (int d : shape)
+            {
+                if (d < 0)
+                {
+                    throw std::invalid_argument("DenseTensor shape must be non-negative.");
+                }
+                n *= d;
+            }
+            return n;
+        }
+
+        std::string shape_str(const std::vector<int> &shape)
+        {
+            std::string s = "[";
+            for (size_t i = 0; i < shape.size(); ++i)
+            {
+                s += (i ? ", " : "") + std::to_string(shape[i]);
+            }
+            return s + "]";
+        }
+
+        thread_local DenseTrace *active_trace = nullptr;
+        thread_local Precision autocast_precision = Precision::FP32;
+
+        // GEMM 的操作数：按 dtype 取 float 或 16 位缓冲区
+        const void *storage(const dense_data &d)
+        {
+            if (d.dtype == Precision::FP32)
+            {
+                return d.value.get();
+            }
+            return d.half.get();
+        }
+
+        // 半精度输出先在 fp32 的线程局部缓冲区中计算，再由 finish_output 转换；fp32 输出直接写入
+        float *output_buffer(dense_data &out)
+        {
+            if (out.dtype == Precision::FP32)
+            {
+                return out.value.get();
+            }
+            thread_local aligned_buffer scratch;
+            thread_local size_t capacity = 0;
+            if (out.numel > capacity)
+            {
+                scratch = make_aligned_buffer(out.numel);
+                capacity = out.numel;
+            }
+            return scratch.get();
+        }
+
+        void finish_output(dense_data &out, const float *z)
+        {
+            if (out.dtype != Precision::FP32)
+            {
+                convert_from_float(z, out.half.get(), out.dtype, out.numel);
+            }
+        }
+
+        // 16 位的 ReLU 只看位模式：符号位为 1 的数（含 -0）置零，正数原样保留
+        bool half_positive(uint16_t bits)
+        {
+            return bits != 0 && !(bits & 0x8000);
+        }
+
+        // 激活前的值是否为正：fp32 直接比较，半精度按位判断，不需要转换
+        void positive_mask(const dense_data &d, const float *g, float *masked)
+        {
+            if (d.dtype == Precision::FP32)
+            {
+                const float *z = d.value.get();
+                for (size_t i = 0; i < d.numel; ++i)
+                {
+                    masked[i] = z[i] > 0 ? g[i] : 0;
+                }
+                return;
+            }
+            const uint16_t *z = d.half.get();
+            for (size_t i = 0; i < d.numel; ++i)
+            {
+                masked[i] = half_positive(z[i]) ? g[i] : 0;
+            }
+        }
+
+        // 是否有人读取 d 的梯度：requires_grad = false 的叶子和 NoGradGuard 下算出的张量没有梯度缓冲区，
+        // 由它们转换精度得到的副本也不需要
+        bool needs_grad(const dense_data &d)
+        {
+            if (!d.grad)
+            {
+                return false;
+            }
+            if (d.back == DenseTensor::back_type::CAST)
+            {
+                return d.par1.data && needs_grad(*d.par1.data);
+            }
+            return true;
+        }
+
+        // 非矩阵乘法的算子只处理 fp32：半精度输入先转换回来
+        DenseTensor as_fp32(const DenseTensor &t)
+        {
+            return t.dtype() == Precision::FP32 ? t : t.to(Precision::FP32);
+        }
+
+        // AutocastGuard 作用域内矩阵乘法的激活输入转换成半精度。叶子（参数、输入）和 FROM_TENSORS 收集的参数不复制，
+        // GEMM 打包时直接读取 fp32，也就没有额外的 CAST 节点和它的梯度缓冲区
+        DenseTensor autocast(const DenseTensor &t)
+        {
+            DenseTensor::back_type back = t.data->back;
+            if (autocast_precision == Precision::FP32 || back == DenseTensor::back_type::NONE || back == DenseTensor::back_type::FROM_TENSORS)
+            {
+                return t;
+            }
+            return t.to(autocast_precision);
+        }
+
+        // 各算子的前向计算，只读写已经分配好的缓冲区，供 eager 执行和 DenseTensor::forward_op 共用
+        void add_forward(dense_data &out, const dense_data &a, const dense_data &b)
+        {
+            const float *x = a.value.get();
+            const float *y = b.value.get();
+            float *z = out.value.get();
+            for (size_t i = 0; i < out.numel; ++i)
+            {
+                z[i] = x[i] + y[i];
+            }
+        }
+
+        void add_row_forward(dense_data &out, const dense_data &a, const dense_data &b)
+        {
+            size_t cols = b.numel;
+            size_t rows = cols ? out.numel / cols : 0;
+            const float *x = a.value.get();
+            const float *y = b.value.get();
+            float *z = out.value.get();
+            for (size_t r = 0; r < rows; ++r)
+            {
+                for (size_t c = 0; c < cols; ++c)
+                {
+                    z[r * cols + c] = x[r * cols + c] + y[c];
+                }
+            }
+        }
+
+        void matmul_forward(dense_data &out, const dense_data &a, const dense_data &b)
+        {
+            int m = a.shape[0], k = a.shape[1], n = b.shape[1];
+            float *z = output_buffer(out);
+            gemm(false, false, m, n, k, 1.0f, storage(a), a.dtype, k, storage(b), b.dtype, n, 0.0f, z, n);
+            finish_output(out, z);
+        }
+
+        // 结果写入 fp32 的 z（可能是 out 自身的缓冲区，也可能是半精度输出的临时空间）
+        void linear_into(float *z, const dense_data &x, const dense_data &w, const dense_data &b)
+        {
+            int m = x.shape[0], k = x.shape[1], n = w.shape[1];
+            // 先用偏置填充每一行，再以 beta = 1 累加 X * W
+            const float *bv = b.value.get();
+            for (int i = 0; i < m; ++i)
+            {
+                std::memcpy(z + (size_t)i * n, bv, n * sizeof(float));
+            }
+            gemm(false, false, m, n, k, 1.0f, storage(x), x.dtype, k, storage(w), w.dtype, n, 1.0f, z, n);
+        }
+
+        void linear_forward(dense_data &out, const dense_data &x, const dense_data &w, const dense_data &b)
+        {
+            float *z = output_buffer(out);
+            linear_into(z, x, w, b);
+            finish_output(out, z);
+        }
+
+        void linear_relu_forward(dense_data &out, const dense_data &x, const dense_data &w, const dense_data &b)
+        {
+            float *z = output_buffer(out);
+            linear_into(z, x, w, b);
+            for (size_t i = 0; i < out.numel; ++i)
+            {
+                z[i] = z[i] > 0 ? z[i] : 0;
+            }
+            finish_output(out, z);
+        }
+
+        void cast_forward(dense_data &out, const dense_data &a)
+        {
+            if (a.dtype == Precision::FP32)
+            {
+                convert_from_float(a.value.get(), out.half.get(), out.dtype, out.numel);
+            }
+            else if (out.dtype == Precision::FP32)
+            {
+                convert_to_float(a.half.get(), a.dtype, out.value.get(), out.numel);
+            }
+            else
+            {
+                float *z = output_buffer(out);
+                convert_to_float(a.half.get(), a.dtype, z, out.numel);
+                finish_output(out, z);
+            }
+        }
+
+        // Y = X * W + b  =>  dW += X^T * dY, db += sum_rows(dY), dX += dY * W^T
+        void linear_grads(const dense_data &out, const float *gy)
+        {
+            auto &x = *out.par1.data;
+            auto &w = *out.par2.data;
+            auto &b = *out.par3.data;
+            int m = x.shape[0], k = x.shape[1], n = w.shape[1];
+            if (w.grad)
+            {
+                gemm(true, false, k, n, m, 1.0f, storage(x), x.dtype, k, gy, Precision::FP32, n, 1.0f, w.grad.get(), n);
+            }
+            if (float *gb = b.grad.get())
+            {
+                for (int i = 0; i < m; ++i)
+                {
+                    const float *row = gy + (size_t)i * n;
+                    for (int j = 0; j < n; ++j)
+                    {
+                        gb[j] += row[j];
+                    }
+                }
+            }
+            // 没有人读取 dX 时跳过这次 GEMM（DataLoader 的批次等 requires_grad = false 的输入）
+            if (!needs_grad(x))
+            {
+                return;
+            }
+            gemm(false, true, m, k, n, 1.0f, gy, Precision::FP32, n, storage(w), w.dtype, n, 1.0f, x.grad.get(), k);
+        }
+
+        void relu_forward(dense_data &out, const dense_data &a)
+        {
+            if (a.dtype != Precision::FP32)
+            {
+                const uint16_t *x = a.half.get();
+                uint16_t *z = out.half.get();
+                for (size_t i = 0; i < out.numel; ++i)
+                {
+                    z[i] = half_positive(x[i]) ? x[i] : 0;
+                }
+                return;
+            }
+            const float *x = a.value.get();
+            float *z = out.value.get();
+            for (size_t i = 0; i < out.numel; ++i)
+            {
+                z[i] = x[i] > 0 ? x[i] : 0;
+            }
+        }
+
+        void exp_forward(dense_data &out, const dense_data &a)
+        {
+            const float *x = a.value.get();
+            float *z = out.value.get();
+            for (size_t i = 0; i < out.numel; ++i)
+            {
+                z[i] = std::exp(x[i]);
+            }
+        }
+
+        void log_forward(dense_data &out, const dense_data &a)
+        {
+            const float *x = a.value.get();
+            float *z = out.value.get();
+            for (size_t i = 0; i < out.numel; ++i)
+            {
+                z[i] = std::log(x[i]);
+            }
+        }
+
+        void sum_forward(dense_data &out, const dense_data &a)
+        {
+            const float *x = a.value.get();
+            float total = 0.0f;
+            for (size_t i = 0; i < a.numel; ++i)
+            {
+                total += x[i];
+            }
+            out.value[0] = total;
+        }
+
+        void check_targets(const std::vector<unsigned char> &targets, int cols)
+        {
+            for (unsigned char t : targets)
+            {
+                if (t >= cols)
+                {
+                    throw std::out_of_range("cross_entropy target " + std::to_string(t) + " out of range for " + std::to_string(cols) + " classes");
+                }
+            }
+        }
+
+        // partials 为 [rows, cols] 的偏导；per_row 为 false 时只有一行的临时空间（不记录计算图）。
+        // 调用前 targets 已经用 check_targets 检查过
+        void cross_entropy_forward(dense_data &out, const dense_data &a, const std::vector<unsigned char> &targets, float *partials, bool per_row)
+        {
+            int rows = a.shape[0], cols = a.shape[1];
+            const float *z = a.value.get();
+            float inv_rows = 1.0f / rows;
+            double total = 0.0;
+            for (int r = 0; r < rows; ++r)
+            {
+                const float *row = z + (size_t)r * cols;
+                float *prow = per_row ? partials + (size_t)r * cols : partials;
+                float mx = row[0];
+                for (int c = 1; c < cols; ++c)
+                {
+                    mx = std::max(mx, row[c]);
+                }
+                float sum = 0.0f;
+                for (int c = 0; c < cols; ++c)
+                {
+                    prow[c] = std::exp(row[c] - mx);
+                    sum += prow[c];
+                }
+                total += mx + std::log(sum) - row[targets[r]];
+                float scale = inv_rows / sum;
+                for (int c = 0; c < cols; ++c)
+                {
+                    prow[c] *= scale;
+                }
+                prow[targets[r]] -= inv_rows;
+            }
+            out.value[0] = (float)(total / rows);
+        }
+
+        void mse_forward(dense_data &out, const dense_data &a, const dense_data &t, float *partials)
+        {
+            size_t n = a.numel;
+            const float *x = a.value.get();
+            const float *y = t.value.get();
+            float scale = 2.0f / n;
+            double total = 0.0;
+            for (size_t i = 0; i < n; ++i)
+            {
+                float diff = x[i] - y[i];
+                total += diff * diff;
+                if (partials)
+                {
+                    partials[i] = scale * diff;
+                }
+            }
+            out.value[0] = (float)(total / n);
+        }
+
+        void *mutable_storage(dense_data &d)
+        {
+            if (d.dtype == Precision::FP32)
+            {
+                return d.value.get();
+            }
+            return d.half.get();
+        }
+
+        // 不记录计算图地执行一次检查点段
+        DenseTensor run_segment(const DenseTensor::Segment &segment, const DenseTensor &input, Precision precision)
+        {
+            NoGradGuard no_grad;
+            AutocastGuard autocast(precision);
+            return segment(input);
+        }
+
+        // 段的结果拷进检查点节点已有的缓冲区；重放时段的输出形状或精度变了说明段不是静态的
+        void checkpoint_store(dense_data &out, const dense_data &result)
+        {
+            if (result.shape != out.shape || result.dtype != out.dtype)
+            {
+                throw std::logic_error("checkpointed segment changed its output from " + shape_str(out.shape) + " to " + shape_str(result.shape));
+            }
+            std::memcpy(mutable_storage(out), storage(result), out.numel * precision_size(out.dtype));
+        }
+
+        void checkpoint_forward(dense_data &out)
+        {
+            DenseTensor result = run_segment(out.segment, out.par1, out.segment_precision);
+            checkpoint_store(out, *result.data);
+        }
+
+        void from_tensors_forward(dense_data &out)
+        {
+            float *v = out.value.get();
+            for (size_t i = 0; i < out.source.size(); ++i)
+            {
+                v[i] = out.source[i].value();
+            }
+        }
+    }
+
+    DenseTrace::Scope::Scope(DenseTrace &trace) : trace(trace), previous(active_trace)
+    {
+        active_trace = &trace;
+    }
+
+    DenseTrace::Scope::~Scope()
+    {
+        active_trace = previous;
+    }
+
+    DenseTrace *DenseTrace::current()
+    {
+        return active_trace;
+    }
+
+    AutocastGuard::AutocastGuard(Precision precision) : previous(autocast_precision)
+    {
+        autocast_precision = precision;
+    }
+
+    AutocastGuard::~AutocastGuard()
+    {
+        autocast_precision = previous;
+    }
+
+    Precision AutocastGuard::active()
+    {
+        return autocast_precision;
+    }
+
+    void aligned_deleter::operator()(void *ptr) const
+    {
+#ifdef _WIN32
+        _aligned_free(ptr);
+#else
+        std::free(ptr);
+#endif
+    }
+
+    namespace
+    {
+        void *aligned_zeroed(size_t bytes)
+        {
+            // aligned_alloc 要求大小是对齐值的整数倍
+            bytes = (bytes + kAlignment - 1) / kAlignment * kAlignment;
+            if (bytes == 0)
+            {
+                bytes = kAlignment;
+            }
+#ifdef _WIN32
+            void *ptr = _aligned_malloc(bytes, kAlignment);
+#else
+            void *ptr = std::aligned_alloc(kAlignment, bytes);
+#endif
+            if (!ptr)
+            {
+                throw std::bad_alloc();
+            }
+            std::memset(ptr, 0, bytes);
+            return ptr;
+        }
+    }
+
+    aligned_buffer make_aligned_buffer(size_t n)
+    {
+        return aligned_buffer(static_cast<float *>(aligned_zeroed(n * sizeof(float))));
+    }
+
+    half_buffer make_aligned_half_buffer(size_t n)
+    {
+        return half_buffer(static_cast<uint16_t *>(aligned_zeroed(n * sizeof(uint16_t))));
+    }
+
+    // Constructor implementations
+    // 数值只分配 dtype 对应的一份缓冲区，梯度总是 fp32
+    dense_data::dense_data(const std::vector<int> &shape, bool with_grad, Precision dtype)
+        : shape(shape), strides(contiguous_strides(shape)), numel(shape_numel(shape)), dtype(dtype),
+          value(dtype == Precision::FP32 ? make_aligned_buffer(numel) : aligned_buffer()),
+          half(dtype == Precision::FP32 ? half_buffer() : make_aligned_half_buffer(numel)),
+          grad(with_grad ? make_aligned_buffer(numel) : aligned_buffer()),
+          sons(0), back(DenseTensor::back_type::NONE)
+    {
+        CCTORCH_PROFILE_NODE_CREATED(sizeof(dense_data) + numel * (precision_size(dtype) + (with_grad ? sizeof(float) : 0)));
+    }
+
+    dense_data::~dense_data()
+    {
+        CCTORCH_PROFILE_NODE_DESTROYED();
+        if (view)
+        {
+            unregister_view(*view);
+        }
+    }
+
+    dense_data::dense_data(const std::vector<int> &shape, DenseTensor par1, DenseTensor par2, DenseTensor::back_type back, Precision dtype)
+        : dense_data(shape, true, dtype)
+    {
+        this->par1 = par1;
+        this->par2 = par2;
+        this->back = back;
+    }
+
+    dense_data::dense_data(const std::vector<int> &shape, DenseTensor par1, DenseTensor par2, DenseTensor par3, DenseTensor::back_type back, Precision dtype)
+        : dense_data(shape, true, dtype)
+    {
+        this->par1 = par1;
+        this->par2 = par2;
+        this->par3 = par3;
+        this->back = back;
+    }
+
+    DenseTensor::DenseTensor(const std::vector<int> &shape, float fill, bool requires_grad)
+        : data(std::make_shared<dense_data>(shape, requires_grad))
+    {
+        if (fill != 0.0f)
+        {
+            float *v = data->value.get();
+            for (size_t i = 0; i < data->numel; ++i)
+            {
+                v[i] = fill;
+            }
+        }
+    }
+
+    DenseTensor::DenseTensor(const std::vector<int> &shape, const std::vector<float> &values, bool requires_grad)
+        : data(std::make_shared<dense_data>(shape, requires_grad))
+    {
+        if (values.size() != data->numel)
+        {
+            throw std::invalid_argument("DenseTensor values size does not match shape " + shape_str(shape));
+        }
+        std::memcpy(data->value.get(), values.data(), values.size() * sizeof(float));
+    }
+
+    // NoGradGuard 作用域内算子的结果只有数值：不保存父节点，也不分配梯度缓冲区
+    DenseTensor::DenseTensor(const std::vector<int> &shape, DenseTensor par1, DenseTensor par2, back_type back, Precision dtype)
+        : data(NoGradGuard::active() ? std::make_shared<dense_data>(shape, false, dtype)
+                                     : std::make_shared<dense_data>(shape, par1, par2, back, dtype))
+    {
+        if (active_trace && data->back != back_type::NONE)
+        {
+            active_trace->nodes.push_back(*this);
+        }
+    }
+
+    DenseTensor::DenseTensor(const std::vector<int> &shape, DenseTensor par1, DenseTensor par2, DenseTensor par3, back_type back, Precision dtype)
+        : data(NoGradGuard::active() ? std::make_shared<dense_data>(shape, false, dtype)
+                                     : std::make_shared<dense_data>(shape, par1, par2, par3, back, dtype))
+    {
+        if (active_trace && data->back != back_type::NONE)
+        {
+            active_trace->nodes.push_back(*this);
+        }
+    }
+
+    const std::vector<int> &DenseTensor::shape() const { return data->shape; }
+    const std::vector<int> &DenseTensor::strides() const { return data->strides; }
+    int DenseTensor::dim() const { return (int)data->shape.size(); }
+    size_t DenseTensor::numel() const { return data ? data->numel : 0; }
+
+    float *DenseTensor::value_ptr()
+    {
+        if (data->dtype != Precision::FP32)
+        {
+            throw std::logic_error(std::string("value_ptr() on a ") + precision_name(data->dtype) + " DenseTensor; use half_ptr() or to(Precision::FP32)");
+        }
+        return data->value.get();
+    }
+
+    const float *DenseTensor::value_ptr() const
+    {
+        return const_cast<DenseTensor *>(this)->value_ptr();
+    }
+
+    float *DenseTensor::grad_ptr() { return data->grad.get(); }
+    const float *DenseTensor::grad_ptr() const { return data->grad.get(); }
+    bool DenseTensor::requires_grad() const { return data->grad != nullptr; }
+
+    Precision DenseTensor::dtype() const { return data->dtype; }
+    uint16_t *DenseTensor::half_ptr() { return data->half.get(); }
+    const uint16_t *DenseTensor::half_ptr() const { return data->half.get(); }
+
+    float DenseTensor::value(size_t i) const
+    {
+        switch (data->dtype)
+        {
+        case Precision::BF16:
+            return to_float(bfloat16{data->half[i]});
+        case Precision::FP16:
+            return to_float(float16{data->half[i]});
+        default:
+            return data->value[i];
+        }
+    }
+    float DenseTensor::grad(size_t i) const { return data->grad[i]; }
+
+    float DenseTensor::item() const
+    {
+        if (numel() != 1)
+        {
+            throw std::logic_error("item() requires a tensor with exactly one element, got " + shape_str(data->shape));
+        }
+        return value(0);
+    }
+
+    bool DenseTensor::topo_decent() const
+    {
+        return data != nullptr && --data->sons == 0;
+    }
+
+    void DenseTensor::_backward() const
+    {
+        switch (this->data->back)
+        {
+        case back_type::FROM_TENSORS:
+            from_tensors_backward();
+            break;
+
+        case back_type::CAST:
+            cast_backward();
+            break;
+
+        case back_type::MATMUL:
+            matmul_backward();
+            break;
+
+        case back_type::LINEAR:
+            linear_backward();
+            break;
+
+        case back_type::LINEAR_RELU:
+            linear_relu_backward();
+            break;
+
+        case back_type::ADD:
+            add_backward();
+            break;
+
+        case back_type::ADD_ROW:
+            add_row_backward();
+            break;
+
+        case back_type::RELU:
+            relu_backward();
+            break;
+
+        case back_type::EXP:
+            exp_backward();
+            break;
+
+        case back_type::LOG:
+            log_backward();
+            break;
+
+        case back_type::SUM:
+            sum_backward();
+            break;
+
+        case back_type::CROSS_ENTROPY:
+            cross_entropy_backward();
+            break;
+
+        case back_type::MSE:
+            mse_backward();
+            break;
+
+        case back_type::CHECKPOINT:
+            checkpoint_backward();
+            break;
+
+        case back_type::NONE:
+            return;
+        }
+    }
+
+    void DenseTensor::forward_op(const std::vector<unsigned char> *targets)
+    {
+        dense_data &node = *data;
+        switch (node.back)
+        {
+        case back_type::FROM_TENSORS:
+            from_tensors_forward(node);
+            break;
+
+        case back_type::CAST:
+            cast_forward(node, *node.par1.data);
+            break;
+
+        case back_type::MATMUL:
+            matmul_forward(node, *node.par1.data, *node.par2.data);
+            break;
+
+        case back_type::LINEAR:
+            linear_forward(node, *node.par1.data, *node.par2.data, *node.par3.data);
+            break;
+
+        case back_type::LINEAR_RELU:
+            linear_relu_forward(node, *node.par1.data, *node.par2.data, *node.par3.data);
+            break;
+
+        case back_type::ADD:
+            add_forward(node, *node.par1.data, *node.par2.data);
+            break;
+
+        case back_type::ADD_ROW:
+            add_row_forward(node, *node.par1.data, *node.par2.data);
+            break;
+
+        case back_type::RELU:
+            relu_forward(node, *node.par1.data);
+            break;
+
+        case back_type::EXP:
+            exp_forward(node, *node.par1.data);
+            break;
+
+        case back_type::LOG:
+            log_forward(node, *node.par1.data);
+            break;
+
+        case back_type::SUM:
+            sum_forward(node, *node.par1.data);
+            break;
+
+        case back_type::CROSS_ENTROPY:
+            if (!targets || targets->size() != (size_t)node.par1.data->shape[0])
+            {
+                throw std::invalid_argument("forward_op: cross_entropy needs one target per row");
+            }
+            check_targets(*targets, node.par1.data->shape[1]);
+            cross_entropy_forward(node, *node.par1.data, *targets, node.partials.get(), true);
+            break;
+
+        case back_type::MSE:
+            mse_forward(node, *node.par1.data, *node.par2.data, node.partials.get());
+            break;
+
+        case back_type::CHECKPOINT:
+            checkpoint_forward(node);
+            break;
+
+        case back_type::NONE:
+            return;
+        }
+    }
+
+    void DenseTensor::backward_op() const
+    {
+        _backward();
+    }
+
+    void DenseTensor::backward(float seed)
+    {
+        CCTORCH_PROFILE_SCOPE("DenseTensor::backward");
+        if (!this->data->grad)
+        {
+            throw std::logic_error("backward() called on a DenseTensor created under NoGradGuard.");
+        }
+        float *g = this->data->grad.get();
+        for (size_t i = 0; i < this->data->numel; ++i)
+        {
+            g[i] = seed;
+        }
+        propagate();
+    }
+
+    void DenseTensor::propagate() const
+    {
+        // 与 Tensor::backward 相同的按拓扑计数的 BFS，只是每个节点是一个完整的算子
+        std::queue<DenseTensor> que;
+        que.push(*this);
+        while (!que.empty())
+        {
+            DenseTensor current = que.front();
+            que.pop();
+            current._backward();
+
+            if (current.data->par1.topo_decent())
+            {
+                que.push(current.data->par1);
+            }
+            if (current.data->par2.topo_decent())
+            {
+                que.push(current.data->par2);
+            }
+            if (current.data->par3.topo_decent())
+            {
+                que.push(current.data->par3);
+            }
+            current.drop_par();
+        }
+    }
+
+    // Operator implementations
+    DenseTensor DenseTensor::operator+(const DenseTensor &other) const
+    {
+        const auto &a = this->data->shape;
+        const auto &b = other.data->shape;
+        if (a == b)
+        {
+            DenseTensor x = as_fp32(*this), y = as_fp32(other);
+            link(x);
+            link(y);
+            DenseTensor out(a, x, y, back_type::ADD);
+            add_forward(*out.data, *x.data, *y.data);
+            return out;
+        }
+        if (b.size() == 1 && !a.empty() && a.back() == b[0])
+        {
+            DenseTensor x = as_fp32(*this), y = as_fp32(other);
+            link(x);
+            link(y);
+            DenseTensor out(a, x, y, back_type::ADD_ROW);
+            add_row_forward(*out.data, *x.data, *y.data);
+            return out;
+        }
+        throw std::invalid_argument("DenseTensor add shape mismatch: " + shape_str(a) + " vs " + shape_str(b));
+    }
+
+    DenseTensor DenseTensor::matmul(const DenseTensor &other) const
+    {
+        const auto &a = this->data->shape;
+        const auto &b = other.data->shape;
+        if (a.size() != 2 || b.size() != 2 || a[1] != b[0])
+        {
+            throw std::invalid_argument("DenseTensor matmul shape mismatch: " + shape_str(a) + " x " + shape_str(b));
+        }
+        DenseTensor x = autocast(*this), y = autocast(other);
+        link(x);
+        link(y);
+        DenseTensor out({a[0], b[1]}, x, y, back_type::MATMUL, autocast_precision);
+        matmul_forward(*out.data, *x.data, *y.data);
+        return out;
+    }
+
+    DenseTensor DenseTensor::linear(const DenseTensor &weight, const DenseTensor &bias) const
+    {
+        const auto &x = this->data->shape;
+        const auto &w = weight.data->shape;
+        const auto &b = bias.data->shape;
+        if (x.size() != 2 || w.size() != 2 || x[1] != w[0] || b.size() != 1 || b[0] != w[1])
+        {
+            throw std::invalid_argument("DenseTensor linear shape mismatch: " + shape_str(x) + " x " + shape_str(w) + " + " + shape_str(b));
+        }
+        DenseTensor input = autocast(*this), weight_in = autocast(weight), bias_fp32 = as_fp32(bias);
+        link(input);
+        link(weight_in);
+        link(bias_fp32);
+        DenseTensor out({x[0], w[1]}, input, weight_in, bias_fp32, back_type::LINEAR, autocast_precision);
+        linear_forward(*out.data, *input.data, *weight_in.data, *bias_fp32.data);
+        return out;
+    }
+
+    DenseTensor DenseTensor::linear_relu(const DenseTensor &weight, const DenseTensor &bias) const
+    {
+        const auto &x = this->data->shape;
+        const auto &w = weight.data->shape;
+        const auto &b = bias.data->shape;
+        if (x.size() != 2 || w.size() != 2 || x[1] != w[0] || b.size() != 1 || b[0] != w[1])
+        {
+            throw std::invalid_argument("DenseTensor linear_relu shape mismatch: " + shape_str(x) + " x " + shape_str(w) + " + " + shape_str(b));
+        }
+        DenseTensor input = autocast(*this), weight_in = autocast(weight), bias_fp32 = as_fp32(bias);
+        link(input);
+        link(weight_in);
+        link(bias_fp32);
+        DenseTensor out({x[0], w[1]}, input, weight_in, bias_fp32, back_type::LINEAR_RELU, autocast_precision);
+        linear_relu_forward(*out.data, *input.data, *weight_in.data, *bias_fp32.data);
+        return out;
+    }
+
+    DenseTensor DenseTensor::relu() const
+    {
+        link(*this);
+        DenseTensor out(this->data->shape, *this, DenseTensor(), back_type::RELU, this->data->dtype);
+        relu_forward(*out.data, *this->data);
+        return out;
+    }
+
+    DenseTensor DenseTensor::exp() const
+    {
+        DenseTensor a = as_fp32(*this);
+        link(a);
+        DenseTensor out(a.data->shape, a, DenseTensor(), back_type::EXP);
+        exp_forward(*out.data, *a.data);
+        return out;
+    }
+
+    DenseTensor DenseTensor::log() const
+    {
+        DenseTensor a = as_fp32(*this);
+        link(a);
+        DenseTensor out(a.data->shape, a, DenseTensor(), back_type::LOG);
+        log_forward(*out.data, *a.data);
+        return out;
+    }
+
+    DenseTensor DenseTensor::sum() const
+    {
+        DenseTensor a = as_fp32(*this);
+        link(a);
+        DenseTensor out({1}, a, DenseTensor(), back_type::SUM);
+        sum_forward(*out.data, *a.data);
+        return out;
+    }
+
+    DenseTensor DenseTensor::cross_entropy(const std::vector<unsigned char> &targets) const
+    {
+        const auto &a = this->data->shape;
+        if (a.size() != 2 || (size_t)a[0] != targets.size())
+        {
+            throw std::invalid_argument("cross_entropy expects logits of shape [batch, classes] and one target per row, got " + shape_str(a));
+        }
+        // 在连接父节点之前检查，抛出异常时不留下多余的 sons 计数
+        check_targets(targets, a[1]);
+        DenseTensor logits = as_fp32(*this);
+        link(logits);
+        DenseTensor out({1}, logits, DenseTensor(), back_type::CROSS_ENTROPY);
+        // 不记录计算图时偏导只需要一行的临时空间
+        bool record = out.data->back == back_type::CROSS_ENTROPY;
+        aligned_buffer partials = make_aligned_buffer(record ? logits.data->numel : a[1]);
+        cross_entropy_forward(*out.data, *logits.data, targets, partials.get(), record);
+        if (record)
+        {
+            out.data->partials = std::move(partials);
+        }
+        return out;
+    }
+
+    DenseTensor DenseTensor::mse(const DenseTensor &targets) const
+    {
+        if (this->data->shape != targets.data->shape)
+        {
+            throw std::invalid_argument("mse shape mismatch: " + shape_str(this->data->shape) + " vs " + shape_str(targets.data->shape));
+        }
+        DenseTensor a = as_fp32(*this), t = as_fp32(targets);
+        link(a);
+        link(t);
+        DenseTensor out({1}, a, t, back_type::MSE);
+        if (out.data->back == back_type::MSE)
+        {
+            out.data->partials = make_aligned_buffer(a.data->numel);
+        }
+        mse_forward(*out.data, *a.data, *t.data, out.data->partials.get());
+        return out;
+    }
+
+    DenseTensor DenseTensor::to(Precision precision) const
+    {
+        if (precision == this->data->dtype)
+        {
+            return *this;
+        }
+        // 源张量没有梯度缓冲区（NoGradGuard 下算出的）时副本也不会有梯度，得到一个不记录计算图的叶子
+        NoGradGuard no_grad(!this->data->grad);
+        link(*this);
+        DenseTensor out(this->data->shape, *this, DenseTensor(), back_type::CAST, precision);
+        cast_forward(*out.data, *this->data);
+        return out;
+    }
+
+    DenseTensor DenseTensor::checkpointed(Segment segment) const
+    {
+        if (NoGradGuard::active())
+        {
+            return segment(*this);
+        }
+        DenseTensor result = run_segment(segment, *this, autocast_precision);
+        link(*this);
+        DenseTensor out(result.shape(), *this, DenseTensor(), back_type::CHECKPOINT, result.dtype());
+        checkpoint_store(*out.data, *result.data);
+        out.data->segment = std::move(segment);
+        out.data->segment_precision = autocast_precision;
+        return out;
+    }
+
+    void DenseTensor::zero_grad()
+    {
+        if (data && data->grad)
+        {
+            std::memset(data->grad.get(), 0, data->numel * sizeof(float));
+        }
+        if (data)
+        {
+            if (auto view = std::atomic_load(&data->view))
+            {
+                for (Tensor &t : *view)
+                {
+                    t.data->grad = 0.0f;
+                }
+            }
+        }
+    }
+
+    void DenseTensor::drop_par()
+    {
+        if (data)
+        {
+            data->par1.data = nullptr;
+            data->par2.data = nullptr;
+            data->par3.data = nullptr;
+            data->source.clear();
+            data->partials.reset();
+            data->segment = nullptr;
+        }
+    }
+
+    const std::vector<Tensor> &DenseTensor::scalar_view() const
+    {
+        std::shared_ptr<std::vector<Tensor>> view = std::atomic_load(&data->view);
+        if (!view)
+        {
+            auto created = std::make_shared<std::vector<Tensor>>();
+            created->reserve(data->numel);
+            for (size_t i = 0; i < data->numel; ++i)
+            {
+                created->emplace_back(value(i));
+            }
+            // 多个线程同时创建时只保留先写入的一份
+            if (std::atomic_compare_exchange_strong(&data->view, &view, created))
+            {
+                view = std::move(created);
+                register_view(data);
+            }
+        }
+        return *view; // 由 data->view 持有，张量存活期间不会被替换
+    }
+
+    bool DenseTensor::has_scalar_view() const
+    {
+        return data && std::atomic_load(&data->view) != nullptr;
+    }
+
+    void DenseTensor::merge_view_grad()
+    {
+        auto view = data ? std::atomic_load(&data->view) : nullptr;
+        if (!view || !data->grad)
+        {
+            return;
+        }
+        float *g = data->grad.get();
+        for (size_t i = 0; i < view->size(); ++i)
+        {
+            tensor_data &t = *(*view)[i].data;
+            g[i] += t.grad;
+            t.grad = 0.0f;
+        }
+    }
+
+    void DenseTensor::refresh_view()
+    {
+        auto view = data ? std::atomic_load(&data->view) : nullptr;
+        if (!view)
+        {
+            return;
+        }
+        for (size_t i = 0; i < view->size(); ++i)
+        {
+            (*view)[i].data->value = value(i);
+        }
+    }
+
+    std::vector<DenseTensor> DenseTensor::from_parameters(const std::vector<Tensor> &tensors)
+    {
+        std::vector<DenseTensor> params;
+        std::vector<Tensor> loose; // 不属于任何连续参数的标量参数，按出现顺序收集成一个一维参数
+        auto gather_loose = [&]()
+        {
+            if (loose.empty())
+            {
+                return;
+            }
+            DenseTensor param({(int)loose.size()});
+            float *v = param.data->value.get();
+            for (size_t i = 0; i < loose.size(); ++i)
+            {
+                v[i] = loose[i].value();
+            }
+            param.data->view = std::make_shared<std::vector<Tensor>>(std::move(loose));
+            register_view(param.data);
+            params.push_back(param);
+            loose.clear();
+        };
+
+        for (size_t i = 0; i < tensors.size();)
+        {
+            // 整段都是某个参数的标量视图时直接使用那个参数，优化器更新的就是模型自己的缓冲区
+            if (std::shared_ptr<dense_data> owner = view_owner(tensors[i].data.get()))
+            {
+                auto view = std::atomic_load(&owner->view);
+                size_t n = view->size();
+                if (i + n <= tensors.size() &&
+                    std::equal(view->begin(), view->end(), tensors.begin() + i, [](const Tensor &a, const Tensor &b)
+                               { return a.data == b.data; }))
+                {
+                    gather_loose();
+                    DenseTensor param;
+                    param.data = std::move(owner);
+                    params.push_back(param);
+                    i += n;
+                    continue;
+                }
+            }
+            loose.push_back(tensors[i]);
+            ++i;
+        }
+        gather_loose();
+        return params;
+    }
+
+    DenseTensor DenseTensor::from_tensors(const std::vector<Tensor> &tensors)
+    {
+        DenseTensor out({(int)tensors.size()}, DenseTensor(), DenseTensor(), back_type::FROM_TENSORS);
+        float *v = out.data->value.get();
+        for (size_t i = 0; i < tensors.size(); ++i)
+        {
+            v[i] = tensors[i].value();
+        }
+        if (out.data->back == back_type::FROM_TENSORS)
+        {
+            out.data->source = tensors;
+        }
+        return out;
+    }
+
+    DenseTensor DenseTensor::from_tensors(const std::vector<std::vector<Tensor>> &tensors)
+    {
+        int rows = (int)tensors.size();
+        int cols = rows ? (int)tensors[0].size() : 0;
+        DenseTensor out({rows, cols}, DenseTensor(), DenseTensor(), back_type::FROM_TENSORS);
+        bool keep_source = out.data->back == back_type::FROM_TENSORS;
+        if (keep_source)
+        {
+            out.data->source.reserve(out.data->numel);
+        }
+        float *v = out.data->value.get();
+        for (int r = 0; r < rows; ++r)
+        {
+            if ((int)tensors[r].size() != cols)
+            {
+                throw std::invalid_argument("from_tensors requires all rows to have the same size.");
+            }
+            for (int c = 0; c < cols; ++c)
+            {
+                v[r * cols + c] = tensors[r][c].value();
+                if (keep_source)
+                {
+                    out.data->source.push_back(tensors[r][c]);
+                }
+            }
+        }
+        return out;
+    }
+
+    std::vector<Tensor> DenseTensor::to_tensors() const
+    {
+        std::vector<Tensor> tensors;
+        tensors.reserve(data->numel);
+        for (size_t i = 0; i < data->numel; ++i)
+        {
+            tensors.emplace_back(value(i));
+        }
+        return tensors;
+    }
+
+    std::vector<std::vector<Tensor>> DenseTensor::to_tensors_2d() const
+    {
+        if (data->shape.size() != 2)
+        {
+            throw std::logic_error("to_tensors_2d() requires a 2-D tensor, got " + shape_str(data->shape));
+        }
+        int rows = data->shape[0], cols = data->shape[1];
+        std::vector<std::vector<Tensor>> tensors(rows);
+        for (int r = 0; r < rows; ++r)
+        {
+            tensors[r].reserve(cols);
+            for (int c = 0; c < cols; ++c)
+            {
+                tensors[r].emplace_back(value((size_t)r * cols + c));
+            }
+        }
+        return tensors;
+    }
+
+    // Private backward function implementations
+    void DenseTensor::from_tensors_backward() const
+    {
+        const float *g = data->grad.get();
+        for (size_t i = 0; i < data->source.size(); ++i)
+        {
+            if (data->source[i].data)
+            {
+                data->source[i].data->grad += g[i];
+            }
+        }
+    }
+
+    void DenseTensor::cast_backward() const
+    {
+        // 转换精度不改变数值的含义，梯度原样传回（两边的梯度都是 fp32）
+        const float *g = data->grad.get();
+        float *g1 = data->par1.data->grad.get();
+        if (!g1)
+        {
+            return;
+        }
+        for (size_t i = 0; i < data->numel; ++i)
+        {
+            g1[i] += g[i];
+        }
+    }
+
+    void DenseTensor::matmul_backward() const
+    {
+        // C = A * B  =>  dA += dC * B^T, dB += A^T * dC
+        auto &a = *data->par1.data;
+        auto &b = *data->par2.data;
+        int m = a.shape[0], k = a.shape[1], n = b.shape[1];
+        const float *gc = data->grad.get();
+        if (a.grad)
+        {
+            gemm(false, true, m, k, n, 1.0f, gc, Precision::FP32, n, storage(b), b.dtype, n, 1.0f, a.grad.get(), k);
+        }
+        if (b.grad)
+        {
+            gemm(true, false, k, n, m, 1.0f, storage(a), a.dtype, k, gc, Precision::FP32, n, 1.0f, b.grad.get(), n);
+        }
+    }
+
+    void DenseTensor::linear_backward() const
+    {
+        linear_grads(*data, data->grad.get());
+    }
+
+    void DenseTensor::linear_relu_backward() const
+    {
+        // 输出为 0 的位置梯度不回传（与单独的 relu 一样按激活前的值判断，二者符号相同）。
+        // 屏蔽后的梯度放在 partials 里，重放时复用
+        if (!data->partials)
+        {
+            data->partials = make_aligned_buffer(data->numel);
+        }
+        float *masked = data->partials.get();
+        positive_mask(*data, data->grad.get(), masked);
+        linear_grads(*data, masked);
+    }
+
+    void DenseTensor::add_backward() const
+    {
+        const float *g = data->grad.get();
+        for (float *gp : {data->par1.data->grad.get(), data->par2.data->grad.get()})
+        {
+            if (!gp)
+            {
+                continue;
+            }
+            for (size_t i = 0; i < data->numel; ++i)
+            {
+                gp[i] += g[i];
+            }
+        }
+    }
+
+    void DenseTensor::add_row_backward() const
+    {
+        const float *g = data->grad.get();
+        float *g1 = data->par1.data->grad.get();
+        float *g2 = data->par2.data->grad.get();
+        size_t cols = data->par2.data->numel;
+        size_t rows = cols ? data->numel / cols : 0;
+        if (g1)
+        {
+            for (size_t i = 0; i < data->numel; ++i)
+            {
+                g1[i] += g[i];
+            }
+        }
+        if (g2)
+        {
+            for (size_t r = 0; r < rows; ++r)
+            {
+                for (size_t c = 0; c < cols; ++c)
+                {
+                    g2[c] += g[r * cols + c];
+                }
+            }
+        }
+    }
+
+    void DenseTensor::relu_backward() const
+    {
+        const dense_data &x = *data->par1.data;
+        const float *g = data->grad.get();
+        float *g1 = x.grad.get();
+        if (!g1)
+        {
+            return;
+        }
+        if (x.dtype != Precision::FP32)
+        {
+            const uint16_t *h = x.half.get();
+            for (size_t i = 0; i < data->numel; ++i)
+            {
+                if (half_positive(h[i]))
+                {
+                    g1[i] += g[i];
+                }
+            }
+            return;
+        }
+        const float *v = x.value.get();
+        for (size_t i = 0; i < data->numel; ++i)
+        {
+            if (v[i] > 0) // 基于输入值判断，而不是输出值
+            {
+                g1[i] += g[i];
+            }
+        }
+    }
+
+    void DenseTensor::exp_backward() const
+    {
+        const float *g = data->grad.get();
+        const float *y = data->value.get();
+        float *g1 = data->par1.data->grad.get();
+        if (!g1)
+        {
+            return;
+        }
+        for (size_t i = 0; i < data->numel; ++i)
+        {
+            g1[i] += g[i] * y[i];
+        }
+    }
+
+    void DenseTensor::log_backward() const
+    {
+        const float *g = data->grad.get();
+        const float *x = data->par1.data->value.get();
+        float *g1 = data->par1.data->grad.get();
+        if (!g1)
+        {
+            return;
+        }
+        for (size_t i = 0; i < data->numel; ++i)
+        {
+            g1[i] += g[i] / x[i];
+        }
+    }
+
+    void DenseTensor::sum_backward() const
+    {
+        float g = data->grad[0];
+        float *g1 = data->par1.data->grad.get();
+        if (!g1)
+        {
+            return;
+        }
+        for (size_t i = 0; i < data->par1.data->numel; ++i)
+        {
+            g1[i] += g;
+        }
+    }
+
+    void DenseTensor::cross_entropy_backward() const
+    {
+        float g = data->grad[0];
+        const float *p = data->partials.get();
+        float *g1 = data->par1.data->grad.get();
+        if (!g1)
+        {
+            return;
+        }
+        for (size_t i = 0; i < data->par1.data->numel; ++i)
+        {
+            g1[i] += g * p[i];
+        }
+    }
+
+    void DenseTensor::mse_backward() const
+    {
+        float g = data->grad[0];
+        const float *p = data->partials.get();
+        float *g1 = data->par1.data->grad.get();
+        float *g2 = data->par2.data->grad.get();
+        for (size_t i = 0; i < data->par1.data->numel; ++i)
+        {
+            if (g1)
+            {
+                g1[i] += g * p[i];
+            }
+            if (g2)
+            {
+                g2[i] -= g * p[i];
+            }
+        }
+    }
+
+    void DenseTensor::checkpoint_backward() const
+    {
+        CCTORCH_PROFILE_SCOPE("DenseTensor::recompute");
+        // 用同样的输入重新建立段内的计算图。段内对输入的引用计数在传播时全部抵消，
+        // 传播停在输入处：输入的梯度累加在 par1 上，由外层的反向继续传递
+        const DenseTensor &input = data->par1;
+        DenseTensor output;
+        {
+            AutocastGuard autocast(data->segment_precision);
+            output = data->segment(input);
+        }
+        if (output.data->shape != data->shape || !output.data->grad)
+        {
+            throw std::logic_error("checkpointed segment recomputed a different output " + shape_str(output.data->shape));
+        }
+        const float *g = data->grad.get();
+        float *go = output.data->grad.get();
+        if (output.data == input.data)
+        {
+            for (size_t i = 0; i < data->numel; ++i)
+            {
+                go[i] += g[i]; // 段原样返回输入
+            }
+            return;
+        }
+        std::memcpy(go, g, data->numel * sizeof(float));
+        output.propagate();
+    }
+
+} // namespace cctorch
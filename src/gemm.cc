@@ -0,0 +1,341 @@
+#include "../include/gemm.h"
+#include "../include/dense_tensor.h"
+#include "../include/simd.h"
+#include "../include/half.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef CCTORCH_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace cctorch
+{
+
+    namespace
+    {
+        // 微内核寄存器分块：MR x NR 的 C 子块常驻寄存器（AVX2 下为 6 x 2 个 ymm）
+        constexpr int MR = 6;
+        constexpr int NR = 16;
+        // 缓存分块：A 面板 MC x KC 留在 L2，B 面板 KC x NC 留在 L3
+        constexpr int MC = 120;
+        constexpr int KC = 256;
+        constexpr int NC = 4096;
+
+        using micro_kernel = void (*)(int kc, const float *a, const float *b, float *c, int ldc, float alpha);
+
+        // 标量内核：编译器可以自动向量化内层 NR 循环
+        void kernel_scalar(int kc, const float *a, const float *b, float *c, int ldc, float alpha)
+        {
+            float acc[MR][NR] = {};
+            for (int p = 0; p < kc; ++p)
+            {
+                for (int i = 0; i < MR; ++i)
+                {
+                    float av = a[i];
+                    for (int j = 0; j < NR; ++j)
+                    {
+                        acc[i][j] += av * b[j];
+                    }
+                }
+                a += MR;
+                b += NR;
+            }
+            for (int i = 0; i < MR; ++i)
+            {
+                for (int j = 0; j < NR; ++j)
+                {
+                    c[i * ldc + j] += alpha * acc[i][j];
+                }
+            }
+        }
+
+#ifdef CCTORCH_X86_SIMD
+        __attribute__((target("avx2,fma"))) void kernel_avx2(int kc, const float *a, const float *b, float *c, int ldc, float alpha)
+        {
+            __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+            __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+            __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+            __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+            __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+            __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+            for (int p = 0; p < kc; ++p)
+            {
+                __m256 b0 = _mm256_loadu_ps(b);
+                __m256 b1 = _mm256_loadu_ps(b + 8);
+                __m256 av;
+                av = _mm256_broadcast_ss(a + 0);
+                c00 = _mm256_fmadd_ps(av, b0, c00);
+                c01 = _mm256_fmadd_ps(av, b1, c01);
+                av = _mm256_broadcast_ss(a + 1);
+                c10 = _mm256_fmadd_ps(av, b0, c10);
+                c11 = _mm256_fmadd_ps(av, b1, c11);
+                av = _mm256_broadcast_ss(a + 2);
+                c20 = _mm256_fmadd_ps(av, b0, c20);
+                c21 = _mm256_fmadd_ps(av, b1, c21);
+                av = _mm256_broadcast_ss(a + 3);
+                c30 = _mm256_fmadd_ps(av, b0, c30);
+                c31 = _mm256_fmadd_ps(av, b1, c31);
+                av = _mm256_broadcast_ss(a + 4);
+                c40 = _mm256_fmadd_ps(av, b0, c40);
+                c41 = _mm256_fmadd_ps(av, b1, c41);
+                av = _mm256_broadcast_ss(a + 5);
+                c50 = _mm256_fmadd_ps(av, b0, c50);
+                c51 = _mm256_fmadd_ps(av, b1, c51);
+                a += MR;
+                b += NR;
+            }
+            __m256 va = _mm256_set1_ps(alpha);
+            float *row;
+#define CCTORCH_STORE_ROW(i, lo, hi)                                                       \
+    row = c + (i) * ldc;                                                                   \
+    _mm256_storeu_ps(row, _mm256_fmadd_ps(va, lo, _mm256_loadu_ps(row)));                  \
+    _mm256_storeu_ps(row + 8, _mm256_fmadd_ps(va, hi, _mm256_loadu_ps(row + 8)));
+            CCTORCH_STORE_ROW(0, c00, c01)
+            CCTORCH_STORE_ROW(1, c10, c11)
+            CCTORCH_STORE_ROW(2, c20, c21)
+            CCTORCH_STORE_ROW(3, c30, c31)
+            CCTORCH_STORE_ROW(4, c40, c41)
+            CCTORCH_STORE_ROW(5, c50, c51)
+#undef CCTORCH_STORE_ROW
+        }
+#endif
+
+        micro_kernel select_kernel()
+        {
+#ifdef CCTORCH_X86_SIMD
+            if (cpu_has_avx2_fma())
+            {
+                return kernel_avx2;
+            }
+#endif
+            return kernel_scalar;
+        }
+
+        // 连续的一段元素转成 float：半精度在这里转换，所以微内核只处理 float
+        void load_row(const float *src, float *dst, int n)
+        {
+            std::memcpy(dst, src, n * sizeof(float));
+        }
+
+        void load_row(const bfloat16 *src, float *dst, int n)
+        {
+            convert(src, dst, n);
+        }
+
+        void load_row(const float16 *src, float *dst, int n)
+        {
+            convert(src, dst, n);
+        }
+
+        // 将 op(A) 的 mc x kc 子块打包为若干 MR 行面板，每个 p 连续存放 MR 个元素，不足部分补零
+        template <typename T>
+        void pack_a(int mc, int kc, const T *a, int rs, int cs, float *dst)
+        {
+            for (int ir = 0; ir < mc; ir += MR)
+            {
+                int rows = std::min(MR, mc - ir);
+                for (int p = 0; p < kc; ++p)
+                {
+                    const T *src = a + ir * rs + p * cs;
+                    for (int i = 0; i < rows; ++i)
+                    {
+                        dst[i] = to_float(src[i * rs]);
+                    }
+                    for (int i = rows; i < MR; ++i)
+                    {
+                        dst[i] = 0.0f;
+                    }
+                    dst += MR;
+                }
+            }
+        }
+
+        // 将 op(B) 的 kc x nc 子块打包为若干 NR 列面板
+        template <typename T>
+        void pack_b(int kc, int nc, const T *b, int rs, int cs, float *dst)
+        {
+            for (int jr = 0; jr < nc; jr += NR)
+            {
+                int cols = std::min(NR, nc - jr);
+                for (int p = 0; p < kc; ++p)
+                {
+                    const T *src = b + p * rs + jr * cs;
+                    if (cs == 1 && cols == NR)
+                    {
+                        load_row(src, dst, NR);
+                    }
+                    else
+                    {
+                        for (int j = 0; j < cols; ++j)
+                        {
+                            dst[j] = to_float(src[j * cs]);
+                        }
+                        for (int j = cols; j < NR; ++j)
+                        {
+                            dst[j] = 0.0f;
+                        }
+                    }
+                    dst += NR;
+                }
+            }
+        }
+
+        void scale_c(int m, int n, float beta, float *c, int ldc)
+        {
+            if (beta == 1.0f)
+            {
+                return;
+            }
+            for (int i = 0; i < m; ++i)
+            {
+                float *row = c + i * ldc;
+                if (beta == 0.0f)
+                {
+                    std::fill(row, row + n, 0.0f);
+                }
+                else
+                {
+                    for (int j = 0; j < n; ++j)
+                    {
+                        row[j] *= beta;
+                    }
+                }
+            }
+        }
+
+        // 打包缓冲区按线程复用，避免每次调用都分配；各种元素类型的实例共用同一份
+        float *a_pack_buffer()
+        {
+            thread_local aligned_buffer buffer = make_aligned_buffer(MC * KC);
+            return buffer.get();
+        }
+
+        float *b_pack_buffer()
+        {
+            thread_local aligned_buffer buffer = make_aligned_buffer(KC * NC);
+            return buffer.get();
+        }
+
+        template <typename TA, typename TB>
+        void gemm_impl(bool trans_a, bool trans_b, int m, int n, int k,
+                       float alpha, const TA *a, int lda,
+                       const TB *b, int ldb,
+                       float beta, float *c, int ldc)
+        {
+            if (m <= 0 || n <= 0)
+            {
+                return;
+            }
+            scale_c(m, n, beta, c, ldc);
+            if (k <= 0 || alpha == 0.0f)
+            {
+                return;
+            }
+
+            static const micro_kernel kernel = select_kernel();
+            float *a_pack = a_pack_buffer();
+            float *b_pack = b_pack_buffer();
+
+            int rs_a = trans_a ? 1 : lda, cs_a = trans_a ? lda : 1;
+            int rs_b = trans_b ? 1 : ldb, cs_b = trans_b ? ldb : 1;
+            float edge[MR * NR];
+
+            for (int jc = 0; jc < n; jc += NC)
+            {
+                int nc = std::min(NC, n - jc);
+                for (int pc = 0; pc < k; pc += KC)
+                {
+                    int kc = std::min(KC, k - pc);
+                    pack_b(kc, nc, b + pc * rs_b + jc * cs_b, rs_b, cs_b, b_pack);
+                    for (int ic = 0; ic < m; ic += MC)
+                    {
+                        int mc = std::min(MC, m - ic);
+                        pack_a(mc, kc, a + ic * rs_a + pc * cs_a, rs_a, cs_a, a_pack);
+                        for (int jr = 0; jr < nc; jr += NR)
+                        {
+                            int cols = std::min(NR, nc - jr);
+                            const float *bp = b_pack + jr * kc;
+                            for (int ir = 0; ir < mc; ir += MR)
+                            {
+                                int rows = std::min(MR, mc - ir);
+                                const float *ap = a_pack + ir * kc;
+                                float *cp = c + (ic + ir) * ldc + jc + jr;
+                                if (rows == MR && cols == NR)
+                                {
+                                    kernel(kc, ap, bp, cp, ldc, alpha);
+                                }
+                                else
+                                {
+                                    // 边缘块先写入临时缓冲区，再把有效部分加回 C
+                                    std::fill(edge, edge + MR * NR, 0.0f);
+                                    kernel(kc, ap, bp, edge, NR, alpha);
+                                    for (int i = 0; i < rows; ++i)
+                                    {
+                                        for (int j = 0; j < cols; ++j)
+                                        {
+                                            cp[i * ldc + j] += edge[i * NR + j];
+                                        }
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        template <typename TA>
+        void gemm_b(bool trans_a, bool trans_b, int m, int n, int k,
+                    float alpha, const TA *a, int lda,
+                    const void *b, Precision b_type, int ldb,
+                    float beta, float *c, int ldc)
+        {
+            switch (b_type)
+            {
+            case Precision::BF16:
+                gemm_impl(trans_a, trans_b, m, n, k, alpha, a, lda, static_cast<const bfloat16 *>(b), ldb, beta, c, ldc);
+                break;
+            case Precision::FP16:
+                gemm_impl(trans_a, trans_b, m, n, k, alpha, a, lda, static_cast<const float16 *>(b), ldb, beta, c, ldc);
+                break;
+            default:
+                gemm_impl(trans_a, trans_b, m, n, k, alpha, a, lda, static_cast<const float *>(b), ldb, beta, c, ldc);
+                break;
+            }
+        }
+    }
+
+    bool gemm_uses_avx2()
+    {
+        return cpu_has_avx2_fma();
+    }
+
+    void sgemm(bool trans_a, bool trans_b, int m, int n, int k,
+               float alpha, const float *a, int lda,
+               const float *b, int ldb,
+               float beta, float *c, int ldc)
+    {
+        gemm_impl(trans_a, trans_b, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+    }
+
+    void gemm(bool trans_a, bool trans_b, int m, int n, int k,
+              float alpha, const void *a, Precision a_type, int lda,
+              const void *b, Precision b_type, int ldb,
+              float beta, float *c, int ldc)
+    {
+        switch (a_type)
+        {
+        case Precision::BF16:
+            gemm_b(trans_a, trans_b, m, n, k, alpha, static_cast<const bfloat16 *>(a), lda, b, b_type, ldb, beta, c, ldc);
+            break;
+        case Precision::FP16:
+            gemm_b(trans_a, trans_b, m, n, k, alpha, static_cast<const float16 *>(a), lda, b, b_type, ldb, beta, c, ldc);
+            break;
+        default:
+            gemm_b(trans_a, trans_b, m, n, k, alpha, static_cast<const float *>(a), lda, b, b_type, ldb, beta, c, ldc);
+            break;
+        }
+    }
+
+} // namespace cctorch
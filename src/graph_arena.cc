@@ -0,0 +1,153 @@
+#include "../include/graph_arena.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace cctorch
+{
+
+    namespace
+    {
+        thread_local GraphArena *active_arena = nullptr;
+
+        // live 计数的最高位表示该块已被 arena 放弃，由最后一个释放的节点负责归还
+        constexpr size_t kRetired = size_t(1) << (sizeof(size_t) * 8 - 1);
+
+        void *aligned_block()
+        {
+#ifdef _WIN32
+            return _aligned_malloc(GraphArena::block_size, GraphArena::block_size);
+#else
+            return std::aligned_alloc(GraphArena::block_size, GraphArena::block_size);
+#endif
+        }
+
+        void free_block(void *ptr)
+        {
+#ifdef _WIN32
+            _aligned_free(ptr);
+#else
+            std::free(ptr);
+#endif
+        }
+    }
+
+    // 块按 block_size 对齐，释放时把地址向下取整即可找到块头
+    struct GraphArena::block_header
+    {
+        std::atomic<size_t> live;
+    };
+
+    GraphArena::GraphArena()
+        : current_block(0), offset(sizeof(block_header)) {}
+
+    GraphArena::~GraphArena()
+    {
+        reset();
+        for (block_header *block : blocks)
+        {
+            free_block(block);
+        }
+    }
+
+    GraphArena::Scope::Scope(GraphArena &arena) : arena(arena), previous(active_arena)
+    {
+        active_arena = &arena;
+    }
+
+    GraphArena::Scope::~Scope()
+    {
+        active_arena = previous;
+        arena.reset();
+    }
+
+    GraphArena *GraphArena::current()
+    {
+        return active_arena;
+    }
+
+    GraphArena::block_header *GraphArena::new_block()
+    {
+        void *mem = aligned_block();
+        if (!mem)
+        {
+            throw std::bad_alloc();
+        }
+        block_header *block = new (mem) block_header;
+        block->live.store(0, std::memory_order_relaxed);
+        return block;
+    }
+
+    void *GraphArena::allocate(size_t bytes, size_t align)
+    {
+        if (bytes + align + sizeof(block_header) > block_size)
+        {
+            throw std::bad_alloc();
+        }
+        if (blocks.empty())
+        {
+            blocks.push_back(new_block());
+        }
+        size_t start = (offset + align - 1) & ~(align - 1);
+        if (start + bytes > block_size)
+        {
+            if (++current_block == blocks.size())
+            {
+                blocks.push_back(new_block());
+            }
+            start = (sizeof(block_header) + align - 1) & ~(align - 1);
+        }
+        block_header *block = blocks[current_block];
+        block->live.fetch_add(1, std::memory_order_relaxed);
+        offset = start + bytes;
+        return reinterpret_cast<char *>(block) + start;
+    }
+
+    void GraphArena::deallocate(void *ptr)
+    {
+        auto *block = reinterpret_cast<block_header *>(reinterpret_cast<uintptr_t>(ptr) & ~(block_size - 1));
+        size_t old = block->live.fetch_sub(1, std::memory_order_acq_rel);
+        if (old == (kRetired | 1))
+        {
+            free_block(block);
+        }
+    }
+
+    void GraphArena::reset()
+    {
+        size_t kept = 0;
+        for (block_header *block : blocks)
+        {
+            if (block->live.load(std::memory_order_acquire) == 0)
+            {
+                blocks[kept++] = block;
+                continue;
+            }
+            // 仍有节点存活：放弃该块，若恰好在此刻归零则由这里释放
+            size_t old = block->live.fetch_or(kRetired, std::memory_order_acq_rel);
+            if (old == 0)
+            {
+                free_block(block);
+            }
+        }
+        blocks.resize(kept);
+        current_block = 0;
+        offset = sizeof(block_header);
+    }
+
+    size_t GraphArena::bytes_used() const
+    {
+        if (blocks.empty())
+        {
+            return 0;
+        }
+        return current_block * block_size + offset;
+    }
+
+    size_t GraphArena::bytes_reserved() const
+    {
+        return blocks.size() * block_size;
+    }
+
+} // namespace cctorch
@@ -0,0 +1,213 @@
+#include "../include/graph_capture.h"
+#include "../include/profiler.h"
+#include <cstring>
+#include <unordered_map>
+
+namespace cctorch
+{
+
+    namespace
+    {
+        // 父节点在记录中的位置；不在记录里的叶子用负数区分输入和常量
+        constexpr int64_t kNoParent = -1;
+        constexpr int64_t kInputLeaf = -2;
+        constexpr int64_t kConstantLeaf = -3;
+    }
+
+    GraphCapture::GraphCapture(Model &model, CrossEntropyLoss &criterion, size_t verify_interval)
+        : model(model), criterion(criterion), verify_interval(verify_interval)
+    {
+    }
+
+    void GraphCapture::invalidate()
+    {
+        plan.clear();
+        plan_signature.clear();
+        plan_parameters.clear();
+        input_slot = DenseTensor();
+        plan_output = DenseTensor();
+        plan_loss = DenseTensor();
+        since_verify = 0;
+    }
+
+    std::vector<int64_t> GraphCapture::signature(const std::vector<DenseTensor> &nodes, const DenseTensor &input) const
+    {
+        std::unordered_map<const dense_data *, int64_t> index;
+        for (size_t i = 0; i < nodes.size(); ++i)
+        {
+            index[nodes[i].data.get()] = i;
+        }
+        std::vector<int64_t> sig;
+        auto parent = [&](const DenseTensor &p)
+        {
+            if (!p.data)
+            {
+                sig.push_back(kNoParent);
+            }
+            else if (p.data == input.data)
+            {
+                sig.push_back(kInputLeaf);
+            }
+            else if (auto it = index.find(p.data.get()); it != index.end())
+            {
+                sig.push_back(it->second);
+            }
+            else
+            {
+                // 参数等叶子按身份绑定：模型换了一个参数张量后计划里的节点仍引用旧参数，必须重新捕获
+                sig.push_back(kConstantLeaf);
+                sig.push_back(reinterpret_cast<intptr_t>(p.data.get()));
+            }
+        };
+
+
+        for (const auto &node : nodes)
+        {
+            const dense_data &d = *node.data;
+            sig.push_back(static_cast<int64_t>(d.back));
+            sig.push_back(static_cast<int64_t>(d.dtype));
+            sig.push_back(d.shape.size());
+            sig.insert(sig.end(), d.shape.begin(), d.shape.end());
+            parent(d.par1);
+            parent(d.par2);
+            parent(d.par3);
+            // 参数被替换成新的 Tensor 后计划里的 FROM_TENSORS 节点会读到旧参数，必须重新捕获
+            sig.push_back(d.source.size());
+            for (const auto &t : d.source)
+            {
+                sig.push_back(reinterpret_cast<intptr_t>(t.data.get()));
+            }
+        }
+        return sig;
+    }
+
+    void GraphCapture::adopt(DenseTrace &trace, const DenseTensor &input, const DenseTensor &output, const DenseTensor &loss, std::vector<int64_t> sig)
+    {
+        plan = std::move(trace.nodes);
+        plan_signature = std::move(sig);
+        // 保留这些张量：旧接口模型的零散标量参数由 DenseTensor::from_parameters 收集，它们存活时下次得到的仍是同一个
+        plan_parameters = model.dense_parameters();
+        input_slot = input;
+        plan_output = output;
+        plan_loss = loss;
+        plan_precision = AutocastGuard::active();
+        since_verify = 0;
+        ++num_captures;
+    }
+
+    bool GraphCapture::parameters_changed()
+    {
+        std::vector<DenseTensor> current = model.dense_parameters();
+        if (current.size() != plan_parameters.size())
+        {
+            return true;
+        }
+        for (size_t i = 0; i < current.size(); ++i)
+        {
+            if (current[i].data != plan_parameters[i].data)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool GraphCapture::trace(const DenseTensor &input, const std::vector<unsigned char> &targets, bool verify)
+    {
+        // 输入拷贝到一个新的叶子里，捕获后它就是计划的输入槽位；没有人读取它的梯度，不分配梯度缓冲区
+        DenseTensor leaf(input.shape(), 0.0f, false);
+        std::memcpy(leaf.value_ptr(), input.value_ptr(), input.numel() * sizeof(float));
+
+        DenseTrace recording;
+        DenseTensor output, loss;
+        {
+            DenseTrace::Scope scope(recording);
+            output = model(leaf);
+            loss = criterion(output, targets);
+        }
+        std::vector<int64_t> sig = signature(recording.nodes, leaf);
+        if (verify && sig == plan_signature)
+        {
+            since_verify = 0;
+            return false;
+        }
+        adopt(recording, leaf, output, loss, std::move(sig));
+        return true;
+    }
+
+    void GraphCapture::run_backward(float loss_scale)
+    {
+        CCTORCH_PROFILE_SCOPE("GraphCapture::backward");
+        for (auto &node : plan)
+        {
+            node.zero_grad();
+        }
+        // 参数等其余叶子的梯度照常累加，由优化器的 zero_grad() 清零；输入槽位没有梯度缓冲区
+        plan_loss.grad_ptr()[0] = loss_scale;
+        for (size_t i = plan.size(); i-- > 0;)
+        {
+            plan[i].backward_op();
+        }
+    }
+
+    float GraphCapture::eager(const DenseTensor &input, const std::vector<unsigned char> &targets, float loss_scale)
+    {
+        ++num_eager;
+        last_output = model(input);
+        DenseTensor loss = criterion(last_output, targets);
+        loss.backward(loss_scale);
+        return loss.item();
+    }
+
+    float GraphCapture::replay(const DenseTensor &input, const std::vector<unsigned char> &targets, float loss_scale)
+    {
+        ++num_replays;
+        ++since_verify;
+        std::memcpy(input_slot.value_ptr(), input.value_ptr(), input.numel() * sizeof(float));
+        {
+            // 重放不经过 Model::forward 和损失函数，前向整体记为一个区间
+            CCTORCH_PROFILE_SCOPE("GraphCapture::forward");
+            for (auto &node : plan)
+            {
+                node.forward_op(&targets);
+            }
+        }
+        run_backward(loss_scale);
+        last_output = plan_output;
+        return plan_loss.item();
+    }
+
+    float GraphCapture::operator()(const DenseTensor &input, const std::vector<unsigned char> &targets, float loss_scale)
+    {
+        if (NoGradGuard::active())
+        {
+            return eager(input, targets, loss_scale); // 推理模式下不记录计算图，交给 eager 路径报错
+        }
+        if (captured() && plan_precision != AutocastGuard::active())
+        {
+            invalidate(); // 计划里的节点按捕获时的存储精度分配，混合精度设置变了就重新捕获
+        }
+        if (captured() && parameters_changed())
+        {
+            invalidate(); // 计划里的节点仍引用旧的参数张量
+        }
+        if (captured() && (input.shape() != input_slot.shape() || targets.size() != (size_t)input.shape()[0]))
+        {
+            return eager(input, targets, loss_scale); // 形状变了：这一步 eager 执行，计划留给之后形状一致的 batch
+        }
+
+        bool verify = captured() && verify_interval > 0 && since_verify >= verify_interval;
+        if (!captured() || verify)
+        {
+            if (trace(input, targets, verify))
+            {
+                // 新捕获的计划前向已经算过了，只需要反向
+                run_backward(loss_scale);
+                last_output = plan_output;
+                return plan_loss.item();
+            }
+        }
+        return replay(input, targets, loss_scale);
+    }
+
+} // namespace cctorch
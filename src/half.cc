@@ -0,0 +1,274 @@
+#include "../include/half.h"
+#include "../include/simd.h"
+
+#ifdef CCTORCH_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace cctorch
+{
+
+    namespace
+    {
+        float from_bits(uint32_t u)
+        {
+            float f;
+            std::memcpy(&f, &u, sizeof(f));
+            return f;
+        }
+
+#ifdef CCTORCH_X86_SIMD
+        bool use_f16c()
+        {
+            static const bool supported = cpu_has_avx2_fma() && cpu_has_f16c();
+            return supported;
+        }
+
+        // 与 to_bfloat16 相同：加上 0x7fff 和保留位的最低位实现就近舍入到偶数，NaN 单独置安静位。
+        // 两组 8 个 32 位结果用 vpackusdw 压成 16 位（按 128 位通道交错），再用 vpermq 还原顺序
+        __attribute__((target("avx2,fma"))) void float_to_bf16_avx2(const float *src, bfloat16 *dst, size_t n)
+        {
+            const __m256i bias = _mm256_set1_epi32(0x7fff);
+            const __m256i one = _mm256_set1_epi32(1);
+            const __m256i quiet = _mm256_set1_epi32(0x400000);
+            size_t i = 0;
+            for (; i + 16 <= n; i += 16)
+            {
+                __m256i half[2];
+                for (int t = 0; t < 2; ++t)
+                {
+                    __m256 f = _mm256_loadu_ps(src + i + 8 * t);
+                    __m256i u = _mm256_castps_si256(f);
+                    __m256i rounded = _mm256_add_epi32(u, _mm256_add_epi32(bias, _mm256_and_si256(_mm256_srli_epi32(u, 16), one)));
+                    __m256i nan = _mm256_castps_si256(_mm256_cmp_ps(f, f, _CMP_UNORD_Q));
+                    rounded = _mm256_blendv_epi8(rounded, _mm256_or_si256(u, quiet), nan);
+                    half[t] = _mm256_srli_epi32(rounded, 16);
+                }
+                __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(half[0], half[1]), 0xd8);
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), packed);
+            }
+            for (; i < n; ++i)
+            {
+                dst[i] = to_bfloat16(src[i]);
+            }
+        }
+
+        __attribute__((target("avx2,fma"))) void bf16_to_float_avx2(const bfloat16 *src, float *dst, size_t n)
+        {
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8)
+            {
+                __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+                __m256i u = _mm256_slli_epi32(_mm256_cvtepu16_epi32(h), 16);
+                _mm256_storeu_ps(dst + i, _mm256_castsi256_ps(u));
+            }
+            for (; i < n; ++i)
+            {
+                dst[i] = to_float(src[i]);
+            }
+        }
+
+        __attribute__((target("avx2,fma,f16c"))) void float_to_fp16_f16c(const float *src, float16 *dst, size_t n)
+        {
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8)
+            {
+                __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), h);
+            }
+            for (; i < n; ++i)
+            {
+                dst[i] = to_float16(src[i]);
+            }
+        }
+
+        __attribute__((target("avx2,fma,f16c"))) void fp16_to_float_f16c(const float16 *src, float *dst, size_t n)
+        {
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8)
+            {
+                __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+                _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+            }
+            for (; i < n; ++i)
+            {
+                dst[i] = to_float(src[i]);
+            }
+        }
+#endif
+    }
+
+    const char *precision_name(Precision precision)
+    {
+        switch (precision)
+        {
+        case Precision::BF16:
+            return "bf16";
+        case Precision::FP16:
+            return "fp16";
+        default:
+            return "fp32";
+        }
+    }
+
+    size_t precision_size(Precision precision)
+    {
+        return precision == Precision::FP32 ? sizeof(float) : sizeof(uint16_t);
+    }
+
+    float to_float(float16 value)
+    {
+        uint32_t sign = static_cast<uint32_t>(value.bits & 0x8000) << 16;
+        uint32_t exponent = (value.bits >> 10) & 0x1f;
+        uint32_t mantissa = value.bits & 0x3ff;
+        if (exponent == 0x1f)
+        {
+            return from_bits(sign | 0x7f800000u | (mantissa << 13));
+        }
+        if (exponent == 0)
+        {
+            if (mantissa == 0)
+            {
+                return from_bits(sign);
+            }
+            // 非规格化数：左移到隐含位出现，每移一位指数减一
+            exponent = 1;
+            while (!(mantissa & 0x400))
+            {
+                mantissa <<= 1;
+                --exponent;
+            }
+            mantissa &= 0x3ff;
+        }
+        return from_bits(sign | ((exponent + 112) << 23) | (mantissa << 13));
+    }
+
+    float16 to_float16(float value)
+    {
+        uint32_t u;
+        std::memcpy(&u, &value, sizeof(u));
+        uint16_t sign = static_cast<uint16_t>((u >> 16) & 0x8000);
+        u &= 0x7fffffffu;
+        if (u >= 0x7f800000u)
+        {
+            return {static_cast<uint16_t>(sign | (u > 0x7f800000u ? 0x7e00 : 0x7c00))};
+        }
+        if (u >= 0x477ff000u) // >= 65520 舍入后溢出
+        {
+            return {static_cast<uint16_t>(sign | 0x7c00)};
+        }
+        if (u < 0x38800000u) // < 2^-14：非规格化数
+        {
+            if (u < 0x33000000u) // <= 2^-25 舍入为 0
+            {
+                return {sign};
+            }
+            uint32_t exponent = u >> 23;
+            uint32_t mantissa = (u & 0x7fffffu) | 0x800000u;
+            uint32_t shift = 126 - exponent;
+            uint32_t h = mantissa >> shift;
+            uint32_t rest = mantissa & ((1u << shift) - 1);
+            uint32_t halfway = 1u << (shift - 1);
+            h += rest > halfway || (rest == halfway && (h & 1));
+            return {static_cast<uint16_t>(sign | h)};
+        }
+        // 规格化数：重新偏置指数后截掉 13 位尾数，舍入进位可以自然进到指数
+        uint32_t h = (u - 0x38000000u) >> 13;
+        uint32_t rest = u & 0x1fff;
+        h += rest > 0x1000 || (rest == 0x1000 && (h & 1));
+        return {static_cast<uint16_t>(sign | h)};
+    }
+
+    void convert(const float *src, bfloat16 *dst, size_t n)
+    {
+#ifdef CCTORCH_X86_SIMD
+        if (cpu_has_avx2_fma())
+        {
+            float_to_bf16_avx2(src, dst, n);
+            return;
+        }
+#endif
+        for (size_t i = 0; i < n; ++i)
+        {
+            dst[i] = to_bfloat16(src[i]);
+        }
+    }
+
+    void convert(const bfloat16 *src, float *dst, size_t n)
+    {
+#ifdef CCTORCH_X86_SIMD
+        if (cpu_has_avx2_fma())
+        {
+            bf16_to_float_avx2(src, dst, n);
+            return;
+        }
+#endif
+        for (size_t i = 0; i < n; ++i)
+        {
+            dst[i] = to_float(src[i]);
+        }
+    }
+
+    void convert(const float *src, float16 *dst, size_t n)
+    {
+#ifdef CCTORCH_X86_SIMD
+        if (use_f16c())
+        {
+            float_to_fp16_f16c(src, dst, n);
+            return;
+        }
+#endif
+        for (size_t i = 0; i < n; ++i)
+        {
+            dst[i] = to_float16(src[i]);
+        }
+    }
+
+    void convert(const float16 *src, float *dst, size_t n)
+    {
+#ifdef CCTORCH_X86_SIMD
+        if (use_f16c())
+        {
+            fp16_to_float_f16c(src, dst, n);
+            return;
+        }
+#endif
+        for (size_t i = 0; i < n; ++i)
+        {
+            dst[i] = to_float(src[i]);
+        }
+    }
+
+    void convert_from_float(const float *src, void *dst, Precision precision, size_t n)
+    {
+        switch (precision)
+        {
+        case Precision::BF16:
+            convert(src, static_cast<bfloat16 *>(dst), n);
+            break;
+        case Precision::FP16:
+            convert(src, static_cast<float16 *>(dst), n);
+            break;
+        default:
+            std::memcpy(dst, src, n * sizeof(float));
+            break;
+        }
+    }
+
+    void convert_to_float(const void *src, Precision precision, float *dst, size_t n)
+    {
+        switch (precision)
+        {
+        case Precision::BF16:
+            convert(static_cast<const bfloat16 *>(src), dst, n);
+            break;
+        case Precision::FP16:
+            convert(static_cast<const float16 *>(src), dst, n);
+            break;
+        default:
+            std::memcpy(dst, src, n * sizeof(float));
+            break;
+        }
+    }
+
+} // namespace cctorch
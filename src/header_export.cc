@@ -0,0 +1,168 @@
+#include "../include/header_export.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace cctorch
+{
+
+    namespace
+    {
+        struct exported_layer
+        {
+            int in;
+            int out;
+            const float *weight; // [in, out]
+            const float *bias;   // [out]
+        };
+
+        bool is_identifier(const std::string &name)
+        {
+            if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0])))
+            {
+                return false;
+            }
+            for (char c : name)
+            {
+                if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_')
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void write_array(std::ofstream &out, const std::string &name, const float *values, size_t n)
+        {
+            out << "    alignas(64) inline constexpr float " << name << "[" << n << "] = {";
+            char literal[32];
+            for (size_t i = 0; i < n; ++i)
+            {
+                if (!std::isfinite(values[i]))
+                {
+                    throw std::runtime_error("export_header: " + name + " contains a non-finite value");
+                }
+                // 9 位有效数字足以精确还原 float；整数值补上小数点，否则 "0f" 不是合法的字面量
+                std::snprintf(literal, sizeof(literal), "%.9g", values[i]);
+                out << (i % 8 == 0 ? "\n        " : " ") << literal << (std::strpbrk(literal, ".e") ? "f" : ".0f") << (i + 1 < n ? "," : "");
+            }
+            out << "};\n";
+        }
+    }
+
+    void export_header(const Checkpoint &checkpoint, const std::string &filename, const HeaderExportOptions &options)
+    {
+        if (!is_identifier(options.name))
+        {
+            throw std::invalid_argument("export_header: '" + options.name + "' is not a valid C++ identifier");
+        }
+
+        std::vector<exported_layer> layers;
+        for (uint32_t layer = 0;; ++layer)
+        {
+            const CheckpointEntry *weight = checkpoint.lookup(layer, CheckpointKind::WEIGHT);
+            if (!weight)
+            {
+                break;
+            }
+            const CheckpointEntry &bias = checkpoint.find(layer, CheckpointKind::BIAS);
+            if (weight->layer_type != 1 || weight->ndim != 2 || bias.ndim != 1 || bias.shape[0] != weight->shape[1])
+            {
+                throw std::runtime_error("export_header: layer " + std::to_string(layer) + " is not a Linear layer");
+            }
+            if (!layers.empty() && layers.back().out != weight->shape[0])
+            {
+                throw std::runtime_error("export_header: layer " + std::to_string(layer) + " expects " + std::to_string(weight->shape[0]) +
+                                         " inputs but the previous layer has " + std::to_string(layers.back().out) + " outputs");
+            }
+            layers.push_back({weight->shape[0], weight->shape[1], checkpoint.values(*weight), checkpoint.values(bias)});
+        }
+        if (layers.empty())
+        {
+            throw std::runtime_error("export_header: checkpoint has no layers");
+        }
+
+        std::ofstream out(filename);
+        if (!out.is_open())
+        {
+            throw std::runtime_error("Failed to open file for writing: " + filename);
+        }
+
+        std::string guard;
+        for (char c : options.name)
+        {
+            guard += static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+        }
+        guard += "_H";
+
+        int widest = 0;
+        for (size_t l = 0; l + 1 < layers.size(); ++l)
+        {
+            widest = std::max(widest, layers[l].out);
+        }
+
+        out << "// Generated by cctorch::export_header. Do not edit.\n";
+        out << "// " << layers.front().in;
+        for (const auto &layer : layers)
+        {
+            out << " -> " << layer.out;
+        }
+        out << (options.relu_between_layers && layers.size() > 1 ? ", ReLU after each hidden layer" : "") << "\n";
+        out << "#ifndef " << guard << "\n#define " << guard << "\n\n#include <cstddef>\n\n";
+        out << "namespace " << options.name << "\n{\n\n";
+        out << "    constexpr int in_features = " << layers.front().in << ";\n";
+        out << "    constexpr int out_features = " << layers.back().out << ";\n\n";
+
+        for (size_t l = 0; l < layers.size(); ++l)
+        {
+            const auto &layer = layers[l];
+            out << "    // layer " << l << ": weight [" << layer.in << ", " << layer.out << "], bias [" << layer.out << "]\n";
+            write_array(out, "layer" + std::to_string(l) + "_weight", layer.weight, static_cast<size_t>(layer.in) * layer.out);
+            write_array(out, "layer" + std::to_string(l) + "_bias", layer.bias, layer.out);
+            out << "\n";
+        }
+
+        // 每层：用偏置初始化累加器，按输入逐行累加（内层沿输出连续），写回时做 ReLU。
+        // 隐藏层在两块栈上缓冲区之间交替，最后一层直接写 output
+        out << "    // 单个样本前向：input[in_features] -> output[out_features]\n";
+        out << "    inline void infer(const float *input, float *output)\n    {\n";
+        if (layers.size() > 1)
+        {
+            out << "        alignas(64) float buffers[2][" << widest << "];\n";
+        }
+        for (size_t l = 0; l < layers.size(); ++l)
+        {
+            const auto &layer = layers[l];
+            bool last = l + 1 == layers.size();
+            bool relu = options.relu_between_layers && !last;
+            std::string src = l == 0 ? "input" : "buffers[" + std::to_string((l - 1) % 2) + "]";
+            std::string dst = last ? "output" : "buffers[" + std::to_string(l % 2) + "]";
+            std::string w = "layer" + std::to_string(l) + "_weight";
+            std::string b = "layer" + std::to_string(l) + "_bias";
+            out << "        {\n";
+            out << "            alignas(64) float acc[" << layer.out << "];\n";
+            out << "            for (int j = 0; j < " << layer.out << "; ++j)\n                acc[j] = " << b << "[j];\n";
+            out << "            for (int i = 0; i < " << layer.in << "; ++i)\n            {\n";
+            out << "                const float x = " << src << "[i];\n";
+            out << "                const float *row = " << w << " + static_cast<std::size_t>(i) * " << layer.out << ";\n";
+            out << "                for (int j = 0; j < " << layer.out << "; ++j)\n                    acc[j] += x * row[j];\n";
+            out << "            }\n";
+            out << "            for (int j = 0; j < " << layer.out << "; ++j)\n";
+            out << "                " << dst << "[j] = " << (relu ? "acc[j] > 0.0f ? acc[j] : 0.0f" : "acc[j]") << ";\n";
+            out << "        }\n";
+        }
+        out << "    }\n\n";
+        out << "} // namespace " << options.name << "\n\n#endif // " << guard << "\n";
+
+        if (!out)
+        {
+            throw std::runtime_error("Failed to write " + filename);
+        }
+    }
+
+} // namespace cctorch
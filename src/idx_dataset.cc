@@ -0,0 +1,173 @@
+#include "../include/idx_dataset.h"
+#include "../include/simd.h"
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+
+#ifdef CCTORCH_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace cctorch
+{
+
+    namespace
+    {
+        // IDX 头部的整数为大端序
+        uint32_t read_be32(const uint8_t *p)
+        {
+            return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+        }
+
+        void normalize_scalar(const uint8_t *src, float *dst, size_t n, float scale, float shift)
+        {
+            for (size_t i = 0; i < n; ++i)
+            {
+                dst[i] = src[i] * scale + shift;
+            }
+        }
+
+#ifdef CCTORCH_X86_SIMD
+        __attribute__((target("avx2,fma"))) void normalize_avx2(const uint8_t *src, float *dst, size_t n, float scale, float shift)
+        {
+            __m256 vscale = _mm256_set1_ps(scale);
+            __m256 vshift = _mm256_set1_ps(shift);
+            size_t i = 0;
+            for (; i + 32 <= n; i += 32)
+            {
+                // 一次读 32 个字节，每 8 个零扩展为 int32 再转成 float
+                __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+                __m128i lo = _mm256_castsi256_si128(bytes);
+                __m128i hi = _mm256_extracti128_si256(bytes, 1);
+                __m256 f0 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(lo));
+                __m256 f1 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(lo, 8)));
+                __m256 f2 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(hi));
+                __m256 f3 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(hi, 8)));
+                _mm256_storeu_ps(dst + i, _mm256_fmadd_ps(f0, vscale, vshift));
+                _mm256_storeu_ps(dst + i + 8, _mm256_fmadd_ps(f1, vscale, vshift));
+                _mm256_storeu_ps(dst + i + 16, _mm256_fmadd_ps(f2, vscale, vshift));
+                _mm256_storeu_ps(dst + i + 24, _mm256_fmadd_ps(f3, vscale, vshift));
+            }
+            for (; i + 8 <= n; i += 8)
+            {
+                __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + i));
+                __m256 f = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes));
+                _mm256_storeu_ps(dst + i, _mm256_fmadd_ps(f, vscale, vshift));
+            }
+            normalize_scalar(src + i, dst + i, n - i, scale, shift);
+        }
+#endif
+    }
+
+    IDXDataset::IDXDataset(const std::string &images_file, const std::string &labels_file)
+        : image_file(images_file), label_file(labels_file)
+    {
+        if (image_file.size() < 16 || read_be32(image_file.data()) != 2051)
+        {
+            throw std::runtime_error("Invalid IDX images file: " + images_file);
+        }
+        if (label_file.size() < 8 || read_be32(label_file.data()) != 2049)
+        {
+            throw std::runtime_error("Invalid IDX labels file: " + labels_file);
+        }
+
+        count = read_be32(image_file.data() + 4);
+        uint32_t rows = read_be32(image_file.data() + 8);
+        uint32_t cols = read_be32(image_file.data() + 12);
+        if (rows == 0 || cols == 0 || rows > (uint32_t)std::numeric_limits<int>::max() || cols > (uint32_t)std::numeric_limits<int>::max())
+        {
+            throw std::runtime_error("Invalid image dimensions in IDX file: " + images_file);
+        }
+        if (read_be32(label_file.data() + 4) != count)
+        {
+            throw std::runtime_error("Number of images and labels don't match");
+        }
+        // 头部的数字来自文件本身，先确认 count * rows * cols 个像素确实在文件里再建立视图；逐个用除法比较，乘积不会溢出
+        size_t available = image_file.size() - 16;
+        if (rows > available / cols || (count > 0 && (size_t)rows * cols > available / count) || label_file.size() - 8 < count)
+        {
+            throw std::runtime_error("Truncated IDX file: " + images_file);
+        }
+        image_rows = (int)rows;
+        image_cols = (int)cols;
+
+        pixel_base = image_file.data() + 16;
+        label_base = label_file.data() + 8;
+        order.resize(count);
+        std::iota(order.begin(), order.end(), 0u);
+    }
+
+    IDXDataset IDXDataset::train(const std::string &data_dir)
+    {
+        return IDXDataset(data_dir + "/train-images-idx3-ubyte", data_dir + "/train-labels-idx1-ubyte");
+    }
+
+    IDXDataset IDXDataset::test(const std::string &data_dir)
+    {
+        return IDXDataset(data_dir + "/t10k-images-idx3-ubyte", data_dir + "/t10k-labels-idx1-ubyte");
+    }
+
+    void IDXDataset::shuffle()
+    {
+        shuffle(std::random_device{}());
+    }
+
+    void IDXDataset::shuffle(uint64_t seed)
+    {
+        std::mt19937_64 rng(seed);
+        std::shuffle(order.begin(), order.end(), rng);
+    }
+
+    IDXBatch IDXDataset::batch(size_t start, size_t batch_size) const
+    {
+        IDXBatch view;
+        view.pixels = pixel_base;
+        view.labels = label_base;
+        view.image_size = image_size();
+        if (start < count)
+        {
+            view.indices = order.data() + start;
+            view.size = std::min(batch_size, count - start);
+        }
+        return view;
+    }
+
+    size_t IDXDataset::num_batches(size_t batch_size, bool drop_last) const
+    {
+        if (batch_size == 0)
+        {
+            return 0;
+        }
+        return drop_last ? count / batch_size : (count + batch_size - 1) / batch_size;
+    }
+
+    void normalize_pixels(const uint8_t *src, float *dst, size_t n, float mean, float std)
+    {
+        if (std <= 0.0f)
+        {
+            throw std::invalid_argument("normalize_pixels requires std > 0");
+        }
+        // (x / 255 - mean) / std 展开成 x * scale + shift
+        float scale = 1.0f / (255.0f * std);
+        float shift = -mean / std;
+#ifdef CCTORCH_X86_SIMD
+        if (cpu_has_avx2_fma())
+        {
+            normalize_avx2(src, dst, n, scale, shift);
+            return;
+        }
+#endif
+        normalize_scalar(src, dst, n, scale, shift);
+    }
+
+    void IDXBatch::normalize(float *dst, float mean, float std) const
+    {
+        for (size_t i = 0; i < size; ++i)
+        {
+            normalize_pixels(image(i), dst + i * image_size, image_size, mean, std);
+        }
+    }
+
+} // namespace cctorch
@@ -0,0 +1,494 @@
+#include "../include/jit.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#ifndef _WIN32
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+#endif
+
+namespace cctorch
+{
+
+    namespace
+    {
+        // 生成代码的格式有变化时修改，旧的缓存文件自然失效
+        constexpr char jit_abi[] = "cctorch-jit-1";
+
+        uint64_t fnv1a(uint64_t h, const void *data, size_t bytes)
+        {
+            const unsigned char *p = static_cast<const unsigned char *>(data);
+            for (size_t i = 0; i < bytes; ++i)
+            {
+                h ^= p[i];
+                h *= 1099511628211ull;
+            }
+            return h;
+        }
+
+        struct pending_node
+        {
+            int32_t depth;
+            Tensor::back_type op;
+            // 父节点：>= 0 为算子节点的临时编号，< 0 为叶子 -(下标 + 1)
+            int64_t par1;
+            int64_t par2;
+        };
+
+        // 一个循环体：前向写 o[i]，反向读 og[i]，a/b 是父节点在 v/g 中的下标
+        const char *forward_body(Tensor::back_type op)
+        {
+            switch (op)
+            {
+            case Tensor::back_type::ADD:
+                return "o[i] = v[a[i]] + v[b[i]];";
+            case Tensor::back_type::SUB:
+                return "o[i] = v[a[i]] - v[b[i]];";
+            case Tensor::back_type::MUL:
+                return "o[i] = v[a[i]] * v[b[i]];";
+            case Tensor::back_type::DIV:
+                return "o[i] = v[a[i]] / v[b[i]];";
+            case Tensor::back_type::RELU:
+                return "o[i] = v[a[i]] > 0 ? v[a[i]] : 0.0f;";
+            case Tensor::back_type::EXP:
+                return "o[i] = std::exp(v[a[i]]);";
+            case Tensor::back_type::LOG:
+                return "o[i] = std::log(v[a[i]]);";
+            default:
+                throw std::logic_error("JitGraph: unsupported op.");
+            }
+        }
+
+        const char *backward_body(Tensor::back_type op)
+        {
+            switch (op)
+            {
+            case Tensor::back_type::ADD:
+                return "g[a[i]] += og[i]; g[b[i]] += og[i];";
+            case Tensor::back_type::SUB:
+                return "g[a[i]] += og[i]; g[b[i]] -= og[i];";
+            case Tensor::back_type::MUL:
+                return "g[a[i]] += v[b[i]] * og[i]; g[b[i]] += v[a[i]] * og[i];";
+            case Tensor::back_type::DIV:
+                return "g[a[i]] += og[i] / v[b[i]]; g[b[i]] += -(v[a[i]] * og[i]) / (v[b[i]] * v[b[i]]);";
+            case Tensor::back_type::RELU:
+                return "if (v[a[i]] > 0) g[a[i]] += og[i];";
+            case Tensor::back_type::EXP:
+                return "g[a[i]] += og[i] * o[i];";
+            case Tensor::back_type::LOG:
+                return "g[a[i]] += og[i] / v[a[i]];";
+            default:
+                throw std::logic_error("JitGraph: unsupported op.");
+            }
+        }
+
+#ifndef _WIN32
+        std::filesystem::path cache_directory(const JitOptions &options)
+        {
+            if (!options.cache_dir.empty())
+            {
+                return options.cache_dir;
+            }
+            const char *env = std::getenv("CCTORCH_JIT_CACHE");
+            if (env && *env)
+            {
+                return env;
+            }
+            // 不使用所有人共享的临时目录：别人可以抢先创建它并放进自己的 .so
+            env = std::getenv("XDG_CACHE_HOME");
+            if (env && *env)
+            {
+                return std::filesystem::path(env) / "cctorch_jit";
+            }
+            env = std::getenv("HOME");
+            if (env && *env)
+            {
+                return std::filesystem::path(env) / ".cache" / "cctorch_jit";
+            }
+            throw std::runtime_error("JitGraph: set JitOptions::cache_dir, $CCTORCH_JIT_CACHE or $HOME for the compilation cache.");
+        }
+
+        // 创建（0700）并检查缓存目录：必须是当前用户拥有的真实目录，组和其他用户不可写
+        void prepare_cache_directory(const std::filesystem::path &dir)
+        {
+            if (dir.has_parent_path())
+            {
+                std::filesystem::create_directories(dir.parent_path());
+            }
+            if (mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST)
+            {
+                throw std::runtime_error("JitGraph: cannot create cache directory " + dir.string() + ": " + std::strerror(errno));
+            }
+            struct stat st;
+            if (lstat(dir.c_str(), &st) != 0)
+            {
+                throw std::runtime_error("JitGraph: cannot stat cache directory " + dir.string() + ": " + std::strerror(errno));
+            }
+            if (!S_ISDIR(st.st_mode))
+            {
+                throw std::runtime_error("JitGraph: cache directory " + dir.string() + " is not a directory (symlinks are refused).");
+            }
+            if (st.st_uid != geteuid())
+            {
+                throw std::runtime_error("JitGraph: cache directory " + dir.string() + " is not owned by the current user.");
+            }
+            if (st.st_mode & (S_IWGRP | S_IWOTH))
+            {
+                throw std::runtime_error("JitGraph: cache directory " + dir.string() + " is writable by other users.");
+            }
+        }
+
+        std::vector<std::string> split_words(const std::string &text)
+        {
+            std::vector<std::string> words;
+            std::istringstream in(text);
+            for (std::string word; in >> word;)
+            {
+                words.push_back(word);
+            }
+            return words;
+        }
+
+        // 直接执行编译器（posix_spawnp，不经过 shell），stdout 和 stderr 写进 log；返回退出码，无法启动时返回 -1
+        int run_compiler(const std::vector<std::string> &args, const std::filesystem::path &log)
+        {
+            std::vector<char *> argv;
+            for (const auto &arg : args)
+            {
+                argv.push_back(const_cast<char *>(arg.c_str()));
+            }
+            argv.push_back(nullptr);
+
+            posix_spawn_file_actions_t actions;
+            posix_spawn_file_actions_init(&actions);
+            posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+            posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+            pid_t pid;
+            int rc = posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+            posix_spawn_file_actions_destroy(&actions);
+            if (rc != 0)
+            {
+                return -1;
+            }
+            int status = 0;
+            while (waitpid(pid, &status, 0) < 0)
+            {
+                if (errno != EINTR)
+                {
+                    return -1;
+                }
+            }
+            return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+        }
+#endif
+    }
+
+    JitGraph::JitGraph(const std::vector<Tensor> &inputs, const std::vector<Tensor> &outputs, const JitOptions &options)
+    {
+        // 遍历整张图：叶子按发现顺序编号（inputs 在最前），算子节点记下深度（叶子为 0）
+        std::unordered_map<const tensor_data *, int64_t> ids;
+        std::vector<pending_node> nodes;
+        for (const auto &input : inputs)
+        {
+            if (!input.data || input.data->back != Tensor::back_type::NONE)
+            {
+                throw std::invalid_argument("JitGraph: inputs must be leaf tensors.");
+            }
+            if (ids.emplace(input.data.get(), -static_cast<int64_t>(leaves.size()) - 1).second)
+            {
+                leaves.push_back(input);
+            }
+            else
+            {
+                throw std::invalid_argument("JitGraph: the same input tensor appears twice.");
+            }
+        }
+        num_inputs = leaves.size();
+
+        auto depth_of = [&](int64_t id)
+        { return id < 0 ? 0 : nodes[id].depth; };
+
+        std::vector<std::pair<const Tensor *, bool>> stack;
+        for (const auto &output : outputs)
+        {
+            if (!output.data)
+            {
+                throw std::invalid_argument("JitGraph: outputs must not be empty tensors.");
+            }
+            stack.emplace_back(&output, false);
+            while (!stack.empty())
+            {
+                auto &top = stack.back();
+                const tensor_data *node = top.first->data.get();
+                if (ids.count(node))
+                {
+                    stack.pop_back();
+                    continue;
+                }
+                if (node->back == Tensor::back_type::NONE)
+                {
+                    ids.emplace(node, -static_cast<int64_t>(leaves.size()) - 1);
+                    leaves.push_back(*top.first);
+                    stack.pop_back();
+                    continue;
+                }
+                if (node->back == Tensor::back_type::REDUCE)
+                {
+                    throw std::invalid_argument("JitGraph: REDUCE nodes are not supported; compute the loss on the outputs of forward().");
+                }
+                if (!top.second)
+                {
+                    top.second = true;
+                    const Tensor *par1 = &node->par1;
+                    const Tensor *par2 = &node->par2;
+                    if (!par1->data)
+                    {
+                        throw std::invalid_argument("JitGraph: the graph has already been released by backward().");
+                    }
+                    if (par2->data && !ids.count(par2->data.get()))
+                    {
+                        stack.emplace_back(par2, false);
+                    }
+                    if (!ids.count(par1->data.get()))
+                    {
+                        stack.emplace_back(par1, false);
+                    }
+                    continue;
+                }
+                int64_t p1 = ids.at(node->par1.data.get());
+                int64_t p2 = node->par2.data ? ids.at(node->par2.data.get()) : p1;
+                ids.emplace(node, static_cast<int64_t>(nodes.size()));
+                nodes.push_back({std::max(depth_of(p1), depth_of(p2)) + 1, node->back, p1, p2});
+                stack.pop_back();
+            }
+        }
+
+        size_t total = leaves.size() + nodes.size();
+        if (total > static_cast<size_t>(std::numeric_limits<int32_t>::max()))
+        {
+            throw std::length_error("JitGraph: graph is too large.");
+        }
+
+        // 按（深度，算子）稳定排序：同一深度的节点互不依赖，同种算子排在一起形成长区间。
+        // 最终顺序仍是拓扑序，所以相邻区间算子相同时可以直接合并成一个循环
+        std::vector<int32_t> order(nodes.size());
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            order[i] = static_cast<int32_t>(i);
+        }
+        std::stable_sort(order.begin(), order.end(), [&](int32_t x, int32_t y)
+                         {
+                             if (nodes[x].depth != nodes[y].depth)
+                                 return nodes[x].depth < nodes[y].depth;
+                             return nodes[x].op < nodes[y].op; });
+        std::vector<int32_t> position(nodes.size());
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            position[order[i]] = static_cast<int32_t>(i);
+        }
+
+        const int32_t num_leaves = static_cast<int32_t>(leaves.size());
+        auto final_index = [&](int64_t id)
+        { return id < 0 ? static_cast<int32_t>(-id - 1) : num_leaves + position[id]; };
+
+        in1.resize(nodes.size());
+        in2.resize(nodes.size());
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            const pending_node &n = nodes[order[i]];
+            in1[i] = final_index(n.par1);
+            in2[i] = final_index(n.par2);
+            if (runs.empty() || runs.back().op != n.op)
+            {
+                runs.push_back({n.op, static_cast<uint32_t>(i), static_cast<uint32_t>(i)});
+            }
+            runs.back().end = static_cast<uint32_t>(i + 1);
+        }
+
+        for (const auto &output : outputs)
+        {
+            output_index.push_back(final_index(ids.at(output.data.get())));
+            results.emplace_back(0.0f);
+        }
+        values.assign(total, 0.0f);
+        grads.assign(total, 0.0f);
+
+        // 图的哈希只取决于区间结构和编译命令，节点之间的连接是运行时数据
+        uint64_t h = 14695981039346656037ull;
+        h = fnv1a(h, jit_abi, sizeof(jit_abi));
+        h = fnv1a(h, options.compiler.data(), options.compiler.size());
+        h = fnv1a(h, options.flags.data(), options.flags.size());
+        uint64_t sizes[2] = {leaves.size(), nodes.size()};
+        h = fnv1a(h, sizes, sizeof(sizes));
+        for (const auto &run : runs)
+        {
+            uint32_t key[3] = {static_cast<uint32_t>(run.op), run.begin, run.end};
+            h = fnv1a(h, key, sizeof(key));
+        }
+        graph_hash = h;
+
+        load(options);
+    }
+
+    JitGraph::~JitGraph()
+    {
+#ifndef _WIN32
+        if (handle)
+        {
+            dlclose(handle);
+        }
+#endif
+    }
+
+    std::string JitGraph::generate_source() const
+    {
+        std::ostringstream src;
+        src << "// Generated by cctorch::JitGraph (" << jit_abi << "), " << runs.size() << " runs, "
+            << leaves.size() << " leaves, " << in1.size() << " ops.\n";
+        src << "#include <cmath>\n#include <cstdint>\n\n";
+
+        src << "extern \"C\" void cctorch_jit_forward(float *v, const int32_t *a, const int32_t *b)\n{\n";
+        src << "    float *o = v + " << leaves.size() << ";\n";
+        for (const auto &run : runs)
+        {
+            src << "    for (int32_t i = " << run.begin << "; i < " << run.end << "; ++i) " << forward_body(run.op) << "\n";
+        }
+        src << "}\n\n";
+
+        src << "extern \"C\" void cctorch_jit_backward(const float *v, float *g, const int32_t *a, const int32_t *b)\n{\n";
+        src << "    const float *o = v + " << leaves.size() << ";\n";
+        src << "    const float *og = g + " << leaves.size() << ";\n";
+        src << "    (void)o;\n";
+        for (auto run = runs.rbegin(); run != runs.rend(); ++run)
+        {
+            src << "    for (int32_t i = " << run->end << "; i-- > " << run->begin << ";) { " << backward_body(run->op) << " }\n";
+        }
+        src << "}\n";
+        return src.str();
+    }
+
+    void JitGraph::load(const JitOptions &options)
+    {
+#ifdef _WIN32
+        (void)options;
+        throw std::runtime_error("JitGraph: runtime compilation is only supported on POSIX systems.");
+#else
+        namespace fs = std::filesystem;
+        fs::path dir = cache_directory(options);
+        prepare_cache_directory(dir);
+        char name[32];
+        std::snprintf(name, sizeof(name), "graph_%016llx", static_cast<unsigned long long>(graph_hash));
+        fs::path so = dir / (std::string(name) + ".so");
+        library = so.string();
+
+        cache_hit = fs::exists(so);
+        if (!cache_hit)
+        {
+            // 先编译到带进程号的临时文件再重命名，多个进程同时编译同一张图也不会读到写了一半的 .so
+            std::string stem = std::string(name) + "." + std::to_string(getpid());
+            fs::path source = dir / (stem + ".cc");
+            fs::path tmp = dir / (stem + ".so.tmp");
+            fs::path log = dir / (stem + ".log");
+            {
+                std::ofstream out(source);
+                out << generate_source();
+                if (!out)
+                {
+                    throw std::runtime_error("JitGraph: failed to write " + source.string());
+                }
+            }
+            std::vector<std::string> args = split_words(options.compiler);
+            if (args.empty())
+            {
+                throw std::invalid_argument("JitGraph: JitOptions::compiler is empty.");
+            }
+            for (auto &flag : split_words(options.flags))
+            {
+                args.push_back(std::move(flag));
+            }
+            args.insert(args.end(), {"-o", tmp.string(), source.string()});
+            if (run_compiler(args, log) != 0)
+            {
+                std::string command;
+                for (const auto &arg : args)
+                {
+                    command += (command.empty() ? "" : " ") + arg;
+                }
+                std::ifstream in(log);
+                std::string output((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+                throw std::runtime_error("JitGraph: compilation failed: " + command + "\n" + output);
+            }
+            fs::rename(tmp, so);
+            // 生成的源码留在 .so 旁边方便查看
+            fs::rename(source, dir / (std::string(name) + ".cc"));
+            fs::remove(log);
+        }
+
+        handle = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (!handle)
+        {
+            throw std::runtime_error(std::string("JitGraph: dlopen failed: ") + dlerror());
+        }
+        forward_kernel = reinterpret_cast<forward_fn>(dlsym(handle, "cctorch_jit_forward"));
+        backward_kernel = reinterpret_cast<backward_fn>(dlsym(handle, "cctorch_jit_backward"));
+        if (!forward_kernel || !backward_kernel)
+        {
+            throw std::runtime_error("JitGraph: " + library + " does not export the expected kernels.");
+        }
+#endif
+    }
+
+    const std::vector<Tensor> &JitGraph::forward(const float *input_values)
+    {
+        std::memcpy(values.data(), input_values, num_inputs * sizeof(float));
+        for (size_t i = num_inputs; i < leaves.size(); ++i)
+        {
+            values[i] = leaves[i].data->value;
+        }
+        forward_kernel(values.data(), in1.data(), in2.data());
+        for (size_t k = 0; k < results.size(); ++k)
+        {
+            results[k].data->value = values[output_index[k]];
+            results[k].data->grad = 0.0f;
+        }
+        return results;
+    }
+
+    const std::vector<Tensor> &JitGraph::forward(const std::vector<float> &input_values)
+    {
+        if (input_values.size() != num_inputs)
+        {
+            throw std::invalid_argument("JitGraph::forward: expected " + std::to_string(num_inputs) + " input values.");
+        }
+        return forward(input_values.data());
+    }
+
+    void JitGraph::backward()
+    {
+        std::fill(grads.begin(), grads.end(), 0.0f);
+        for (size_t k = 0; k < results.size(); ++k)
+        {
+            grads[output_index[k]] += results[k].data->grad;
+        }
+        backward_kernel(values.data(), grads.data(), in1.data(), in2.data());
+        for (size_t i = 0; i < leaves.size(); ++i)
+        {
+            leaves[i].data->grad += grads[i];
+        }
+    }
+
+} // namespace cctorch
@@ -1,8 +1,10 @@
 #include "../include/layer.h"
+#include "../include/profiler.h"
 #include <iostream>
 #include <cmath>
 #include <random>
 #include <fstream>
+#include <cstring>
 #include <stdexcept>
 
 namespace cctorch
@@ -10,7 +12,8 @@ namespace cctorch
 
     // Linear class implementation
     Linear::Linear(int in_features, int out_features)
-        : in_features(in_features), out_features(out_features), biases(out_features, Tensor(0.0f))
+        : in_features(in_features), out_features(out_features),
+          weight({in_features, out_features}), bias({out_features})
     {
         float std = std::sqrt(2.0f / in_features);
         // 创建随机数生成器
@@ -18,57 +21,85 @@ namespace cctorch
         // 设置均值和标准差
         std::normal_distribution<float> distribution(0.0f, std);
 
-        weights.resize(in_features, vector<Tensor>());
-        for (int i = 0; i < in_features; ++i)
+        float *w = weight.value_ptr();
+        for (size_t i = 0; i < weight.numel(); ++i)
         {
-            for (int j = 0; j < out_features; ++j)
-            {
-                weights[i].push_back(Tensor(distribution(generator)));
-            }
+            w[i] = distribution(generator);
         }
     }
 
     std::vector<Tensor> Linear::forward(const std::vector<Tensor> &input)
     {
+        CCTORCH_PROFILE_SCOPE("Linear::forward");
         vector<Tensor> outputs;
         outputs.reserve(out_features);
+        if (NoGradGuard::active())
+        {
+            // 推理模式：直接在连续的参数上累加，每个输出只创建一个叶子节点
+            const float *w = weight.value_ptr();
+            vector<float> acc(bias.value_ptr(), bias.value_ptr() + out_features);
+            for (int j = 0; j < in_features; j++)
+            {
+                float x = input[j].data->value;
+                const float *row = w + (size_t)j * out_features;
+                for (int i = 0; i < out_features; i++)
+                {
+                    acc[i] += x * row[i];
+                }
+            }
+            for (int i = 0; i < out_features; i++)
+            {
+                outputs.emplace_back(acc[i]);
+            }
+            return outputs;
+        }
+        // 逐元素的计算图挂在参数的标量视图上，梯度在优化器更新前合并回连续的梯度缓冲区
+        const vector<Tensor> &weights = weight.scalar_view();
+        const vector<Tensor> &biases = bias.scalar_view();
         for (int i = 0; i < out_features; i++)
         {
             outputs.push_back(biases[i]); // Initialize output with bias
             for (int j = 0; j < in_features; j++)
             {
-                outputs[i] = outputs[i] + (input[j] * weights[j][i]);
+                outputs[i] = outputs[i] + (input[j] * weights[(size_t)j * out_features + i]);
             }
         }
         return outputs;
     }
 
-    std::vector<Tensor> Linear::parameters()
+    DenseTensor Linear::forward(const DenseTensor &input)
     {
-        std::vector<Tensor> params;
-        for (const auto &weight_vec : weights)
+        CCTORCH_PROFILE_SCOPE("Linear::forward");
+        if (input.dim() != 2 || input.shape()[1] != in_features)
         {
-            params.insert(params.end(), weight_vec.begin(), weight_vec.end());
+            throw std::invalid_argument("Linear expects input of shape [batch, " + std::to_string(in_features) + "].");
         }
-        params.insert(params.end(), biases.begin(), biases.end());
-        return params;
+        // 参数本身就是连续矩阵，整个 batch 只需要一次 GEMM，反向时 dW/db 直接累加进参数的梯度缓冲区
+        return input.linear(weight, bias);
     }
 
-    void Linear::save(const std::string &filename) const
+    std::vector<DenseTensor> Linear::dense_parameters()
     {
-        std::ofstream file(filename, std::ios::binary);
-        if (!file.is_open())
-        {
-            throw std::runtime_error("Failed to open file for writing: " + filename);
-        }
+        return {weight, bias};
+    }
 
-        save_to_stream(file);
-        file.close();
+    void Linear::save(const std::string &filename) const
+    {
+        CheckpointWriter checkpoint;
+        save_to_checkpoint(checkpoint);
+        checkpoint.write(filename);
         std::cout << "Linear layer saved to " << filename << std::endl;
     }
 
     void Linear::load(const std::string &filename)
     {
+        if (Checkpoint::is_checkpoint(filename))
+        {
+            load_from_checkpoint(Checkpoint(filename), 0);
+            std::cout << "Linear layer loaded from " << filename << std::endl;
+            return;
+        }
+
         std::ifstream file(filename, std::ios::binary);
         if (!file.is_open())
         {
@@ -82,30 +113,13 @@ namespace cctorch
 
     void Linear::save_to_stream(std::ofstream &file) const
     {
-        // 写入层类型标识符 (1 for Linear)
-        int layer_type = 1;
-        file.write(reinterpret_cast<const char *>(&layer_type), sizeof(int));
-
-        // 写入输入和输出特征数
-        file.write(reinterpret_cast<const char *>(&in_features), sizeof(int));
-        file.write(reinterpret_cast<const char *>(&out_features), sizeof(int));
+        // 写入层类型标识符 (1 for Linear) 和输入、输出特征数
+        int header[3] = {1, in_features, out_features};
+        file.write(reinterpret_cast<const char *>(header), sizeof(header));
 
-        // 写入权重 (按 weights[i][j] 的顺序)
-        for (int i = 0; i < in_features; ++i)
-        {
-            for (int j = 0; j < out_features; ++j)
-            {
-                float weight_value = weights[i][j].value();
-                file.write(reinterpret_cast<const char *>(&weight_value), sizeof(float));
-            }
-        }
-
-        // 写入偏置
-        for (int i = 0; i < out_features; ++i)
-        {
-            float bias_value = biases[i].value();
-            file.write(reinterpret_cast<const char *>(&bias_value), sizeof(float));
-        }
+        // 权重按 [in, out] 行优先存放，与偏置各一次写出
+        file.write(reinterpret_cast<const char *>(weight.value_ptr()), weight.numel() * sizeof(float));
+        file.write(reinterpret_cast<const char *>(bias.value_ptr()), bias.numel() * sizeof(float));
     }
 
     void Linear::load_from_stream(std::ifstream &file)
@@ -131,29 +145,54 @@ namespace cctorch
                                      ", Current: " + std::to_string(in_features) + "x" + std::to_string(out_features));
         }
 
-        // 读取权重
-        for (int i = 0; i < in_features; ++i)
+        // 权重和偏置一次读入，读完整之后才覆盖参数
+        std::vector<float> values(weight.numel() + bias.numel());
+        file.read(reinterpret_cast<char *>(values.data()), values.size() * sizeof(float));
+        if (!file)
         {
-            for (int j = 0; j < out_features; ++j)
-            {
-                float weight_value;
-                file.read(reinterpret_cast<char *>(&weight_value), sizeof(float));
-                weights[i][j] = Tensor(weight_value);
-            }
+            throw std::runtime_error("Unexpected end of file while reading Linear parameters.");
         }
 
-        // 读取偏置
-        for (int i = 0; i < out_features; ++i)
+        // 数值写入现有的参数，构造在 load 之前的优化器仍然绑定着它们
+        std::memcpy(weight.value_ptr(), values.data(), weight.numel() * sizeof(float));
+        std::memcpy(bias.value_ptr(), values.data() + weight.numel(), bias.numel() * sizeof(float));
+        weight.refresh_view();
+        bias.refresh_view();
+    }
+
+    uint32_t Linear::save_to_checkpoint(CheckpointWriter &checkpoint) const
+    {
+        uint32_t layer = checkpoint.begin_layer(1);
+        // 直接写入检查点的缓冲区（复用时不分配），整个快照只有这一次拷贝
+        float *w = checkpoint.allocate(layer, CheckpointKind::WEIGHT, {in_features, out_features});
+        std::memcpy(w, weight.value_ptr(), weight.numel() * sizeof(float));
+        float *b = checkpoint.allocate(layer, CheckpointKind::BIAS, {out_features});
+        std::memcpy(b, bias.value_ptr(), bias.numel() * sizeof(float));
+        return layer;
+    }
+
+    void Linear::load_from_checkpoint(const Checkpoint &checkpoint, uint32_t layer)
+    {
+        const CheckpointEntry &weight_entry = checkpoint.find(layer, CheckpointKind::WEIGHT);
+        const CheckpointEntry &bias_entry = checkpoint.find(layer, CheckpointKind::BIAS);
+        if (weight_entry.layer_type != 1 || weight_entry.ndim != 2 || bias_entry.ndim != 1 ||
+            weight_entry.shape[0] != in_features || weight_entry.shape[1] != out_features || bias_entry.shape[0] != out_features)
         {
-            float bias_value;
-            file.read(reinterpret_cast<char *>(&bias_value), sizeof(float));
-            biases[i] = Tensor(bias_value);
+            throw std::runtime_error("Model dimensions mismatch. Checkpoint layer " + std::to_string(layer) + ": " +
+                                     std::to_string(weight_entry.shape[0]) + "x" + std::to_string(weight_entry.shape[1]) +
+                                     ", Current: " + std::to_string(in_features) + "x" + std::to_string(out_features));
         }
+
+        std::memcpy(weight.value_ptr(), checkpoint.values(weight_entry), weight.numel() * sizeof(float));
+        std::memcpy(bias.value_ptr(), checkpoint.values(bias_entry), bias.numel() * sizeof(float));
+        weight.refresh_view();
+        bias.refresh_view();
     }
 
     // ReLU class implementation
     vector<Tensor> ReLU::operator()(const vector<Tensor> &inputs)
     {
+        CCTORCH_PROFILE_SCOPE("ReLU");
         vector<Tensor> outputs;
         outputs.reserve(inputs.size());
 
@@ -175,4 +214,10 @@ namespace cctorch
         return outputs;
     }
 
+    DenseTensor ReLU::operator()(const DenseTensor &inputs)
+    {
+        CCTORCH_PROFILE_SCOPE("ReLU");
+        return inputs.relu();
+    }
+
 } // namespace cctorch
\ No newline at end of file
@@ -0,0 +1,98 @@
+#include "../include/mapped_file.h"
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cctorch
+{
+
+    MappedFile::MappedFile(const std::string &path)
+    {
+#ifdef _WIN32
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file.is_open())
+        {
+            throw std::runtime_error("Cannot open file: " + path);
+        }
+        fallback.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(reinterpret_cast<char *>(fallback.data()), fallback.size());
+        if (!file)
+        {
+            throw std::runtime_error("Failed to read file: " + path);
+        }
+        bytes = fallback.data();
+        length = fallback.size();
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Cannot open file: " + path);
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("Cannot stat file: " + path);
+        }
+        length = static_cast<size_t>(st.st_size);
+        if (length > 0)
+        {
+            void *ptr = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (ptr == MAP_FAILED)
+            {
+                ::close(fd);
+                throw std::runtime_error("Failed to mmap file: " + path);
+            }
+            bytes = static_cast<const uint8_t *>(ptr);
+        }
+        // 映射建立后文件描述符可以立即关闭
+        ::close(fd);
+#endif
+    }
+
+    MappedFile::~MappedFile()
+    {
+        release();
+    }
+
+    MappedFile::MappedFile(MappedFile &&other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            fallback = std::move(other.fallback);
+            bytes = other.bytes;
+            length = other.length;
+            other.bytes = nullptr;
+            other.length = 0;
+        }
+        return *this;
+    }
+
+    void MappedFile::release()
+    {
+#ifndef _WIN32
+        if (bytes && fallback.empty())
+        {
+            ::munmap(const_cast<uint8_t *>(bytes), length);
+        }
+#endif
+        fallback.clear();
+        bytes = nullptr;
+        length = 0;
+    }
+
+} // namespace cctorch
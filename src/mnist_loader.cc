@@ -1,4 +1,6 @@
 #include "../include/mnist_loader.h"
+#include "../include/idx_dataset.h"
+#include "../include/profiler.h"
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
@@ -61,6 +63,7 @@ namespace cctorch
 
     MNISTData MNISTLoader::get_batch(const MNISTData &data, int batch_start, int batch_size)
     {
+        CCTORCH_PROFILE_SCOPE("MNISTLoader::get_batch");
         MNISTData batch;
         batch.image_height = data.image_height;
         batch.image_width = data.image_width;
@@ -210,17 +213,30 @@ namespace cctorch
 
     std::vector<std::vector<float>> MNISTLoader::normalize_image(const std::vector<std::vector<uint8_t>> &images)
     {
-        std::vector<std::vector<float>> res;
-        for (auto &row : images)
+        std::vector<std::vector<float>> res(images.size());
+        for (size_t i = 0; i < images.size(); i++)
         {
-            std::vector<float> float_row;
-            for (auto x : row)
+            res[i].resize(images[i].size());
+            normalize_pixels(images[i].data(), res[i].data(), images[i].size()); // 归一化到 [0, 1] 而不是 [-1, 1]
+        }
+        return res;
+    }
+
+    DenseTensor MNISTLoader::normalize_batch(const MNISTData &data, float mean, float std)
+    {
+        int num_images = (int)data.images.size();
+        int image_size = num_images > 0 ? (int)data.images[0].size() : data.image_width * data.image_height;
+        DenseTensor batch({num_images, image_size}, 0.0f, false);
+        float *dst = batch.value_ptr();
+        for (int i = 0; i < num_images; i++)
+        {
+            if ((int)data.images[i].size() != image_size)
             {
-                float_row.push_back(x / 255.0); // 归一化到 [0, 1] 而不是 [-1, 1]
+                throw std::runtime_error("normalize_batch: image " + std::to_string(i) + " has a different size");
             }
-            res.push_back(float_row);
+            normalize_pixels(data.images[i].data(), dst + (size_t)i * image_size, image_size, mean, std);
         }
-        return res;
+        return batch;
     }
 
 } // namespace cctorch
@@ -0,0 +1,110 @@
+#include "../include/optimizer.h"
+#include "../include/simd.h"
+#include <stdexcept>
+#include <string>
+
+#ifdef CCTORCH_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace cctorch
+{
+
+    namespace
+    {
+        void sgd_scalar(float *value, const float *grad, size_t n, float learning_rate, float decay)
+        {
+            for (size_t i = 0; i < n; ++i)
+            {
+                value[i] = value[i] * decay - learning_rate * grad[i];
+            }
+        }
+
+        void adam_scalar(float *value, const float *grad, float *m, float *v, size_t n, const adam_step_params &p)
+        {
+            for (size_t i = 0; i < n; ++i)
+            {
+                float g = grad[i] * p.grad_scale;
+                m[i] = p.beta1 * m[i] + (1 - p.beta1) * g;
+                v[i] = p.beta2 * v[i] + (1 - p.beta2) * g * g;
+                value[i] = value[i] * p.decay - p.step_size * m[i] / (std::sqrt(v[i]) * p.inv_sqrt_bc2 + p.epsilon);
+            }
+        }
+
+#ifdef CCTORCH_X86_SIMD
+        __attribute__((target("avx2,fma"))) void sgd_avx2(float *value, const float *grad, size_t n, float learning_rate, float decay)
+        {
+            __m256 vlr = _mm256_set1_ps(learning_rate);
+            __m256 vdecay = _mm256_set1_ps(decay);
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8)
+            {
+                __m256 w = _mm256_mul_ps(_mm256_loadu_ps(value + i), vdecay);
+                _mm256_storeu_ps(value + i, _mm256_fnmadd_ps(vlr, _mm256_loadu_ps(grad + i), w));
+            }
+            sgd_scalar(value + i, grad + i, n - i, learning_rate, decay);
+        }
+
+        __attribute__((target("avx2,fma"))) void adam_avx2(float *value, const float *grad, float *m, float *v, size_t n, const adam_step_params &p)
+        {
+            __m256 b1 = _mm256_set1_ps(p.beta1), nb1 = _mm256_set1_ps(1 - p.beta1);
+            __m256 b2 = _mm256_set1_ps(p.beta2), nb2 = _mm256_set1_ps(1 - p.beta2);
+            __m256 step = _mm256_set1_ps(p.step_size);
+            __m256 inv_bc2 = _mm256_set1_ps(p.inv_sqrt_bc2);
+            __m256 eps = _mm256_set1_ps(p.epsilon);
+            __m256 decay = _mm256_set1_ps(p.decay);
+            __m256 scale = _mm256_set1_ps(p.grad_scale);
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8)
+            {
+                __m256 g = _mm256_mul_ps(_mm256_loadu_ps(grad + i), scale);
+                __m256 mi = _mm256_fmadd_ps(b1, _mm256_loadu_ps(m + i), _mm256_mul_ps(nb1, g));
+                __m256 vi = _mm256_fmadd_ps(b2, _mm256_loadu_ps(v + i), _mm256_mul_ps(nb2, _mm256_mul_ps(g, g)));
+                _mm256_storeu_ps(m + i, mi);
+                _mm256_storeu_ps(v + i, vi);
+                __m256 denom = _mm256_fmadd_ps(_mm256_sqrt_ps(vi), inv_bc2, eps);
+                __m256 w = _mm256_mul_ps(_mm256_loadu_ps(value + i), decay);
+                _mm256_storeu_ps(value + i, _mm256_fnmadd_ps(step, _mm256_div_ps(mi, denom), w));
+            }
+            adam_scalar(value + i, grad + i, m + i, v + i, n - i, p);
+        }
+#endif
+    }
+
+    void check_parameters(const std::vector<DenseTensor> &parameters)
+    {
+        for (size_t i = 0; i < parameters.size(); ++i)
+        {
+            const DenseTensor &param = parameters[i];
+            if (!param.data || param.dtype() != Precision::FP32 || !param.grad_ptr())
+            {
+                throw std::invalid_argument("Optimizer parameter " + std::to_string(i) + " must be an fp32 tensor with a gradient buffer.");
+            }
+        }
+    }
+
+    void sgd_update(float *value, const float *grad, size_t n, float learning_rate, float decay)
+    {
+#ifdef CCTORCH_X86_SIMD
+        if (cpu_has_avx2_fma())
+        {
+            sgd_avx2(value, grad, n, learning_rate, decay);
+            return;
+        }
+#endif
+        sgd_scalar(value, grad, n, learning_rate, decay);
+    }
+
+    void adam_update(float *value, const float *grad, float *m, float *v, size_t n, const adam_step_params &p)
+    {
+#ifdef CCTORCH_X86_SIMD
+        if (cpu_has_avx2_fma())
+        {
+            adam_avx2(value, grad, m, v, n, p);
+            return;
+        }
+#endif
+        adam_scalar(value, grad, m, v, n, p);
+    }
+
+} // namespace cctorch
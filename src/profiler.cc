@@ -0,0 +1,295 @@
+#include "../include/profiler.h"
+
+#ifdef CCTORCH_PROFILE
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+namespace cctorch
+{
+    namespace profiler
+    {
+
+        namespace
+        {
+            struct event
+            {
+                const char *name;
+                int64_t begin_ns;
+                int64_t end_ns;
+            };
+
+            // 每个线程一份事件列表；锁只在本线程追加和导出时竞争。线程退出后列表仍由 registry 持有
+            struct thread_events
+            {
+                int tid;
+                std::mutex mutex;
+                std::vector<event> events;
+            };
+
+            std::mutex registry_mutex;
+            std::vector<std::shared_ptr<thread_events>> registry;
+            std::vector<StepStats> step_list;
+            StepStats current_step;
+
+            int64_t steady_ns()
+            {
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+            }
+
+            std::atomic<bool> is_recording{false};
+            // 记录的起点（steady_clock 的纳秒数）。start() 写入时其他线程的 Span 可能正在读取，所以是原子的
+            std::atomic<int64_t> origin{steady_ns()};
+            int64_t stop_ns = 0;
+
+            std::atomic<int64_t> live_nodes{0};
+            std::atomic<int64_t> peak_live{0};
+            std::atomic<int64_t> total_nodes{0};
+            std::atomic<int64_t> total_bytes{0};
+
+            int64_t now_ns()
+            {
+                return steady_ns() - origin.load(std::memory_order_relaxed);
+            }
+
+            thread_events &local_events()
+            {
+                thread_local std::shared_ptr<thread_events> local;
+                if (!local)
+                {
+                    local = std::make_shared<thread_events>();
+                    std::lock_guard<std::mutex> lock(registry_mutex);
+                    local->tid = static_cast<int>(registry.size()) + 1;
+                    registry.push_back(local);
+                }
+                return *local;
+            }
+
+            // 调用者持有 registry_mutex
+            void begin_step(int64_t at)
+            {
+                current_step = StepStats();
+                current_step.begin_ns = at;
+                current_step.nodes_created = total_nodes.load(std::memory_order_relaxed);
+                current_step.bytes_allocated = total_bytes.load(std::memory_order_relaxed);
+                peak_live.store(live_nodes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            }
+
+            void write_escaped(std::ostream &out, const char *s)
+            {
+                for (; *s; ++s)
+                {
+                    if (*s == '"' || *s == '\\')
+                    {
+                        out << '\\';
+                    }
+                    out << *s;
+                }
+            }
+        }
+
+        void start()
+        {
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            for (auto &t : registry)
+            {
+                std::lock_guard<std::mutex> events_lock(t->mutex);
+                t->events.clear();
+            }
+            step_list.clear();
+            origin.store(steady_ns(), std::memory_order_relaxed);
+            begin_step(0);
+            is_recording.store(true, std::memory_order_release);
+        }
+
+        void stop()
+        {
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            if (is_recording.exchange(false, std::memory_order_acq_rel))
+            {
+                stop_ns = now_ns();
+            }
+        }
+
+        bool recording()
+        {
+            return is_recording.load(std::memory_order_relaxed);
+        }
+
+        void step()
+        {
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            if (!recording())
+            {
+                return;
+            }
+            int64_t at = now_ns();
+            current_step.end_ns = at;
+            current_step.nodes_created = total_nodes.load(std::memory_order_relaxed) - current_step.nodes_created;
+            current_step.bytes_allocated = total_bytes.load(std::memory_order_relaxed) - current_step.bytes_allocated;
+            current_step.peak_live_nodes = peak_live.load(std::memory_order_relaxed);
+            step_list.push_back(current_step);
+            begin_step(at);
+        }
+
+        std::vector<StepStats> steps()
+        {
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            return step_list;
+        }
+
+        // 区间先记绝对时间，结束时再换算到当前的起点；跨过一次 start() 的区间开始于本次记录之前，丢弃
+        Span::Span(const char *name) : name(name), begin_ns(recording() ? steady_ns() : -1) {}
+
+        Span::~Span()
+        {
+            int64_t start_ns = origin.load(std::memory_order_relaxed);
+            if (begin_ns < start_ns)
+            {
+                return;
+            }
+            int64_t end_ns = steady_ns();
+            thread_events &local = local_events();
+            std::lock_guard<std::mutex> lock(local.mutex);
+            local.events.push_back({name, begin_ns - start_ns, end_ns - start_ns});
+        }
+
+        void node_created(size_t bytes)
+        {
+            int64_t live = live_nodes.fetch_add(1, std::memory_order_relaxed) + 1;
+            total_nodes.fetch_add(1, std::memory_order_relaxed);
+            total_bytes.fetch_add(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+            int64_t peak = peak_live.load(std::memory_order_relaxed);
+            while (live > peak && !peak_live.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+            {
+            }
+        }
+
+        void node_destroyed()
+        {
+            live_nodes.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        void write_chrome_trace(const std::string &filename)
+        {
+            std::ofstream out(filename);
+            if (!out)
+            {
+                throw std::runtime_error("Failed to open trace file for writing: " + filename);
+            }
+            // trace_event 的时间单位是微秒
+            out << std::fixed << std::setprecision(3);
+            out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+            bool first = true;
+            auto separator = [&]
+            {
+                out << (first ? "" : ",\n");
+                first = false;
+            };
+
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            for (auto &t : registry)
+            {
+                std::lock_guard<std::mutex> events_lock(t->mutex);
+                separator();
+                out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t->tid
+                    << ",\"args\":{\"name\":\"thread " << t->tid << "\"}}";
+                for (const event &e : t->events)
+                {
+                    separator();
+                    out << "{\"name\":\"";
+                    write_escaped(out, e.name);
+                    out << "\",\"cat\":\"cctorch\",\"ph\":\"X\",\"pid\":1,\"tid\":" << t->tid
+                        << ",\"ts\":" << e.begin_ns / 1e3 << ",\"dur\":" << (e.end_ns - e.begin_ns) / 1e3 << "}";
+                }
+            }
+            for (const StepStats &s : step_list)
+            {
+                separator();
+                out << "{\"name\":\"graph\",\"ph\":\"C\",\"pid\":1,\"ts\":" << s.begin_ns / 1e3
+                    << ",\"args\":{\"nodes_created\":" << s.nodes_created << ",\"peak_live_nodes\":" << s.peak_live_nodes << "}}";
+                separator();
+                out << "{\"name\":\"allocated_bytes\",\"ph\":\"C\",\"pid\":1,\"ts\":" << s.begin_ns / 1e3
+                    << ",\"args\":{\"bytes\":" << s.bytes_allocated << "}}";
+            }
+            out << "\n]}\n";
+            if (!out)
+            {
+                throw std::runtime_error("Failed to write trace file: " + filename);
+            }
+        }
+
+        void print_summary(std::ostream &out)
+        {
+            struct total
+            {
+                int64_t calls = 0;
+                int64_t ns = 0;
+                int64_t max_ns = 0;
+            };
+            std::map<std::string, total> totals;
+            int64_t duration;
+            std::vector<StepStats> stats;
+            {
+                std::lock_guard<std::mutex> lock(registry_mutex);
+                for (auto &t : registry)
+                {
+                    std::lock_guard<std::mutex> events_lock(t->mutex);
+                    for (const event &e : t->events)
+                    {
+                        total &entry = totals[e.name];
+                        int64_t ns = e.end_ns - e.begin_ns;
+                        entry.calls++;
+                        entry.ns += ns;
+                        entry.max_ns = std::max(entry.max_ns, ns);
+                    }
+                }
+                duration = recording() ? now_ns() : stop_ns;
+                stats = step_list;
+            }
+
+            std::vector<std::pair<std::string, total>> rows(totals.begin(), totals.end());
+            std::sort(rows.begin(), rows.end(), [](const auto &a, const auto &b)
+                      { return a.second.ns > b.second.ns; });
+            std::ios::fmtflags flags = out.flags();
+            out << std::left << std::setw(32) << "span" << std::right << std::setw(10) << "calls" << std::setw(14) << "total ms"
+                << std::setw(12) << "mean us" << std::setw(12) << "max us" << std::setw(9) << "%" << "\n";
+            out << std::fixed;
+            for (const auto &row : rows)
+            {
+                const total &t = row.second;
+                out << std::left << std::setw(32) << row.first << std::right << std::setw(10) << t.calls
+                    << std::setw(14) << std::setprecision(3) << t.ns / 1e6
+                    << std::setw(12) << std::setprecision(1) << t.ns / 1e3 / t.calls
+                    << std::setw(12) << t.max_ns / 1e3
+                    << std::setw(8) << (duration > 0 ? 100.0 * t.ns / duration : 0.0) << "%\n";
+            }
+            out << "recorded " << std::setprecision(3) << duration / 1e6 << " ms";
+            if (!stats.empty())
+            {
+                double nodes = 0, bytes = 0;
+                int64_t peak = 0;
+                for (const StepStats &s : stats)
+                {
+                    nodes += s.nodes_created;
+                    bytes += s.bytes_allocated;
+                    peak = std::max(peak, s.peak_live_nodes);
+                }
+                out << ", " << stats.size() << " steps: " << std::setprecision(0) << nodes / stats.size() << " nodes/step, "
+                    << std::setprecision(1) << bytes / stats.size() / (1 << 20) << " MB allocated/step, peak live nodes " << peak;
+            }
+            out << "\n";
+            out.flags(flags);
+        }
+
+    } // namespace profiler
+} // namespace cctorch
+
+#endif // CCTORCH_PROFILE
@@ -0,0 +1,521 @@
+#include "../include/quantize.h"
+#include "../include/gemm.h"
+#include "../include/simd.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef CCTORCH_X86_SIMD
+#include <immintrin.h>
+#define CCTORCH_QUANT_INLINE __attribute__((always_inline)) inline
+#endif
+
+namespace cctorch
+{
+
+    namespace
+    {
+        // 微内核：MR 行 x NR 列的 int32 累加器常驻寄存器（AVX2 下为 4 x 2 个 ymm）
+        constexpr int MR = 4;
+        constexpr int NR = 16;
+        // 打包面板中一组 k 的字节数：NR 列 x 4 个 k
+        constexpr int PANEL_STEP = NR * 4;
+        // predict 每次处理的行数，中间结果留在 L1/L2
+        constexpr size_t ROW_BLOCK = 64;
+
+        int round_up(int n, int multiple)
+        {
+            return (n + multiple - 1) / multiple * multiple;
+        }
+
+        // 计算 rows (<= MR) 行、cols (<= NR) 列：a 指向第一行的起点，b 指向一个列面板
+        using int8_kernel = void (*)(int k4, const uint8_t *a, int lda, const int8_t *b, int32_t *c, int ldc, int rows, int cols);
+
+        void kernel_scalar(int k4, const uint8_t *a, int lda, const int8_t *b, int32_t *c, int ldc, int rows, int cols)
+        {
+            for (int i = 0; i < rows; ++i)
+            {
+                int32_t acc[NR] = {};
+                const uint8_t *row = a + (size_t)i * lda;
+                for (int q = 0; q < k4; ++q)
+                {
+                    const int8_t *panel = b + (size_t)q * PANEL_STEP;
+                    for (int j = 0; j < NR; ++j)
+                    {
+                        for (int t = 0; t < 4; ++t)
+                        {
+                            acc[j] += (int32_t)row[q * 4 + t] * panel[j * 4 + t];
+                        }
+                    }
+                }
+                std::memcpy(c + (size_t)i * ldc, acc, cols * sizeof(int32_t));
+            }
+        }
+
+#ifdef CCTORCH_X86_SIMD
+        template <int R>
+        __attribute__((target("avx2,fma"))) CCTORCH_QUANT_INLINE void store_tile(const __m256i (*acc)[2], int32_t *c, int ldc, int cols)
+        {
+            for (int r = 0; r < R; ++r)
+            {
+                int32_t *dst = c + (size_t)r * ldc;
+                if (cols == NR)
+                {
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), acc[r][0]);
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + 8), acc[r][1]);
+                }
+                else
+                {
+                    alignas(32) int32_t tail[NR];
+                    _mm256_store_si256(reinterpret_cast<__m256i *>(tail), acc[r][0]);
+                    _mm256_store_si256(reinterpret_cast<__m256i *>(tail + 8), acc[r][1]);
+                    std::memcpy(dst, tail, cols * sizeof(int32_t));
+                }
+            }
+        }
+
+        // 每次从一行 A 取 4 个字节广播到 8 个 32 位通道，与面板中 8 列 x 4 个 k 的权重做点积：
+        // AVX2 先用 vpmaddubsw 两两相加成 int16，再用 vpmaddwd 乘 1 相加成 int32
+        template <int R>
+        __attribute__((target("avx2,fma"))) void tile_avx2(int k4, const uint8_t *a, int lda, const int8_t *b, int32_t *c, int ldc, int cols)
+        {
+            __m256i acc[R][2];
+            for (int r = 0; r < R; ++r)
+            {
+                acc[r][0] = _mm256_setzero_si256();
+                acc[r][1] = _mm256_setzero_si256();
+            }
+            const __m256i ones = _mm256_set1_epi16(1);
+            for (int q = 0; q < k4; ++q)
+            {
+                __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + (size_t)q * PANEL_STEP));
+                __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + (size_t)q * PANEL_STEP + 32));
+                for (int r = 0; r < R; ++r)
+                {
+                    int32_t word;
+                    std::memcpy(&word, a + (size_t)r * lda + q * 4, sizeof(word));
+                    __m256i x = _mm256_set1_epi32(word);
+                    acc[r][0] = _mm256_add_epi32(acc[r][0], _mm256_madd_epi16(_mm256_maddubs_epi16(x, b0), ones));
+                    acc[r][1] = _mm256_add_epi32(acc[r][1], _mm256_madd_epi16(_mm256_maddubs_epi16(x, b1), ones));
+                }
+            }
+            store_tile<R>(acc, c, ldc, cols);
+        }
+
+        // 同上，VNNI 用一条 vpdpbusd 完成乘加
+        template <int R>
+        __attribute__((target("avx2,fma,avx512vnni,avx512vl"))) void tile_vnni(int k4, const uint8_t *a, int lda, const int8_t *b, int32_t *c, int ldc, int cols)
+        {
+            __m256i acc[R][2];
+            for (int r = 0; r < R; ++r)
+            {
+                acc[r][0] = _mm256_setzero_si256();
+                acc[r][1] = _mm256_setzero_si256();
+            }
+            for (int q = 0; q < k4; ++q)
+            {
+                __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + (size_t)q * PANEL_STEP));
+                __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + (size_t)q * PANEL_STEP + 32));
+                for (int r = 0; r < R; ++r)
+                {
+                    int32_t word;
+                    std::memcpy(&word, a + (size_t)r * lda + q * 4, sizeof(word));
+                    __m256i x = _mm256_set1_epi32(word);
+                    acc[r][0] = _mm256_dpbusd_epi32(acc[r][0], x, b0);
+                    acc[r][1] = _mm256_dpbusd_epi32(acc[r][1], x, b1);
+                }
+            }
+            store_tile<R>(acc, c, ldc, cols);
+        }
+
+        void kernel_avx2(int k4, const uint8_t *a, int lda, const int8_t *b, int32_t *c, int ldc, int rows, int cols)
+        {
+            static constexpr void (*tiles[MR])(int, const uint8_t *, int, const int8_t *, int32_t *, int, int) = {tile_avx2<1>, tile_avx2<2>, tile_avx2<3>, tile_avx2<4>};
+            tiles[rows - 1](k4, a, lda, b, c, ldc, cols);
+        }
+
+        void kernel_vnni(int k4, const uint8_t *a, int lda, const int8_t *b, int32_t *c, int ldc, int rows, int cols)
+        {
+            static constexpr void (*tiles[MR])(int, const uint8_t *, int, const int8_t *, int32_t *, int, int) = {tile_vnni<1>, tile_vnni<2>, tile_vnni<3>, tile_vnni<4>};
+            tiles[rows - 1](k4, a, lda, b, c, ldc, cols);
+        }
+#endif
+
+        int8_kernel select_kernel()
+        {
+#ifdef CCTORCH_X86_SIMD
+            if (cpu_has_avx512_vnni())
+            {
+                return kernel_vnni;
+            }
+            if (cpu_has_avx2_fma())
+            {
+                return kernel_avx2;
+            }
+#endif
+            return kernel_scalar;
+        }
+
+        // 把 float 量化为 [0, 127] 的 uint8：先夹到范围内再 +0.5 截断
+        void quantize_scalar(const float *x, int n, float inv_scale, float zero, uint8_t *q)
+        {
+            const float hi = static_cast<float>(quantized_activation_max);
+            for (int i = 0; i < n; ++i)
+            {
+                float v = std::min(std::max(x[i] * inv_scale + zero, 0.0f), hi);
+                q[i] = static_cast<uint8_t>(static_cast<int>(v + 0.5f));
+            }
+        }
+
+#ifdef CCTORCH_X86_SIMD
+        // 每次 32 个：4 x 8 个 int32 经两次饱和打包变成 32 个字节，打包按 128 位通道交错，最后用 vpermd 还原顺序
+        __attribute__((target("avx2,fma"))) void quantize_avx2(const float *x, int n, float inv_scale, float zero, uint8_t *q)
+        {
+            const __m256 scale = _mm256_set1_ps(inv_scale);
+            const __m256 offset = _mm256_set1_ps(zero);
+            const __m256 lo = _mm256_setzero_ps();
+            const __m256 hi = _mm256_set1_ps(static_cast<float>(quantized_activation_max));
+            const __m256 half = _mm256_set1_ps(0.5f);
+            const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+            int i = 0;
+            for (; i + 32 <= n; i += 32)
+            {
+                __m256i v[4];
+                for (int t = 0; t < 4; ++t)
+                {
+                    __m256 f = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(x + i + 8 * t), scale), offset);
+                    f = _mm256_min_ps(_mm256_max_ps(f, lo), hi);
+                    v[t] = _mm256_cvttps_epi32(_mm256_add_ps(f, half));
+                }
+                __m256i bytes = _mm256_packus_epi16(_mm256_packs_epi32(v[0], v[1]), _mm256_packs_epi32(v[2], v[3]));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(q + i), _mm256_permutevar8x32_epi32(bytes, order));
+            }
+            quantize_scalar(x + i, n - i, inv_scale, zero, q + i);
+        }
+#endif
+
+        void quantize_row(const float *x, int n, float inv_scale, float zero, uint8_t *q)
+        {
+#ifdef CCTORCH_X86_SIMD
+            if (cpu_has_avx2_fma())
+            {
+                quantize_avx2(x, n, inv_scale, zero, q);
+                return;
+            }
+#endif
+            quantize_scalar(x, n, inv_scale, zero, q);
+        }
+
+        uint32_t checked_layer_type(const CheckpointEntry &entry, uint32_t layer)
+        {
+            if (entry.layer_type != quantized_linear_layer && entry.layer_type != quantized_linear_relu_layer)
+            {
+                throw std::runtime_error("Checkpoint layer " + std::to_string(layer) + " is not a quantized Linear layer");
+            }
+            return entry.layer_type;
+        }
+    }
+
+    size_t int8_packed_size(int k, int n)
+    {
+        return (size_t)round_up(k, 4) * round_up(n, NR);
+    }
+
+    void pack_int8_weights(const int8_t *b, int k, int n, int8_t *packed)
+    {
+        int k4 = round_up(k, 4) / 4;
+        std::memset(packed, 0, int8_packed_size(k, n));
+        for (int jb = 0; jb < n; jb += NR)
+        {
+            int8_t *panel = packed + (size_t)jb * k4 * 4;
+            for (int p = 0; p < k; ++p)
+            {
+                const int8_t *src = b + (size_t)p * n;
+                int8_t *dst = panel + (size_t)(p / 4) * PANEL_STEP + p % 4;
+                for (int j = jb; j < std::min(jb + NR, n); ++j)
+                {
+                    dst[(j - jb) * 4] = src[j];
+                }
+            }
+        }
+    }
+
+    void igemm_u8s8(int m, int n, int k, const uint8_t *a, int lda, const int8_t *packed_b, int32_t *c, int ldc)
+    {
+        static const int8_kernel kernel = select_kernel();
+        int k4 = round_up(k, 4) / 4;
+        // 外层按列面板：一个面板（k4 * 64 字节）留在 L1，依次和所有行相乘
+        for (int jb = 0; jb < n; jb += NR)
+        {
+            const int8_t *panel = packed_b + (size_t)jb * k4 * 4;
+            int cols = std::min(NR, n - jb);
+            for (int i = 0; i < m; i += MR)
+            {
+                kernel(k4, a + (size_t)i * lda, lda, panel, c + (size_t)i * ldc + jb, ldc, std::min(MR, m - i), cols);
+            }
+        }
+    }
+
+    const char *igemm_kernel_name()
+    {
+#ifdef CCTORCH_X86_SIMD
+        if (cpu_has_avx512_vnni())
+        {
+            return "avx512-vnni";
+        }
+        if (cpu_has_avx2_fma())
+        {
+            return "avx2";
+        }
+#endif
+        return "scalar";
+    }
+
+    QuantizedMLP::QuantizedMLP(const Checkpoint &checkpoint, const float *calibration, size_t num_samples, const QuantizeOptions &options)
+    {
+        if (num_samples == 0)
+        {
+            throw std::invalid_argument("QuantizedMLP needs at least one calibration sample");
+        }
+        std::vector<const float *> fp32_weights;
+        for (uint32_t index = 0;; ++index)
+        {
+            const CheckpointEntry *weight = checkpoint.lookup(index, CheckpointKind::WEIGHT);
+            if (!weight)
+            {
+                break;
+            }
+            const CheckpointEntry &bias = checkpoint.find(index, CheckpointKind::BIAS);
+            if (weight->layer_type != 1 || weight->ndim != 2 || bias.ndim != 1 || bias.shape[0] != weight->shape[1])
+            {
+                throw std::runtime_error("QuantizedMLP: layer " + std::to_string(index) + " is not a Linear layer");
+            }
+            if (!layers.empty() && layers.back().out != weight->shape[0])
+            {
+                throw std::runtime_error("QuantizedMLP: layer " + std::to_string(index) + " expects " + std::to_string(weight->shape[0]) +
+                                         " inputs but the previous layer has " + std::to_string(layers.back().out) + " outputs");
+            }
+            layer l;
+            l.in = weight->shape[0];
+            l.out = weight->shape[1];
+            const float *b = checkpoint.values(bias);
+            l.bias.assign(b, b + l.out);
+            fp32_weights.push_back(checkpoint.values(*weight));
+            layers.push_back(std::move(l));
+        }
+        if (layers.empty())
+        {
+            throw std::runtime_error("QuantizedMLP: checkpoint has no layers");
+        }
+
+        // fp32 前向跑一遍校准数据，记录每层输入的 [min, max]（包含 0，零点才能落在范围内）
+        std::vector<float> x(calibration, calibration + num_samples * layers.front().in);
+        std::vector<float> y;
+        for (size_t index = 0; index < layers.size(); ++index)
+        {
+            layer &l = layers[index];
+            l.relu = options.relu_between_layers && index + 1 < layers.size();
+            auto range = std::minmax_element(x.begin(), x.end());
+            float lo = std::min(*range.first, 0.0f);
+            float hi = std::max(*range.second, 0.0f);
+            l.input_scale = hi > lo ? (hi - lo) / quantized_activation_max : 1.0f;
+            l.input_zero = std::min(std::max((int)std::lround(-lo / l.input_scale), 0), quantized_activation_max);
+
+            const float *w = fp32_weights[index];
+            y.resize(num_samples * l.out);
+            sgemm(false, false, (int)num_samples, l.out, l.in, 1.0f, x.data(), l.in, w, l.out, 0.0f, y.data(), l.out);
+            for (size_t i = 0; i < num_samples; ++i)
+            {
+                float *row = y.data() + i * l.out;
+                for (int j = 0; j < l.out; ++j)
+                {
+                    row[j] += l.bias[j];
+                    if (l.relu && row[j] < 0.0f)
+                    {
+                        row[j] = 0.0f;
+                    }
+                }
+            }
+            x.swap(y);
+
+            // 权重按输出通道（列）对称量化
+            l.weight.resize((size_t)l.in * l.out);
+            l.weight_scale.assign(l.out, 0.0f);
+            for (int p = 0; p < l.in; ++p)
+            {
+                for (int j = 0; j < l.out; ++j)
+                {
+                    l.weight_scale[j] = std::max(l.weight_scale[j], std::fabs(w[(size_t)p * l.out + j]));
+                }
+            }
+            for (int j = 0; j < l.out; ++j)
+            {
+                l.weight_scale[j] = l.weight_scale[j] > 0.0f ? l.weight_scale[j] / 127.0f : 1.0f;
+            }
+            for (int p = 0; p < l.in; ++p)
+            {
+                for (int j = 0; j < l.out; ++j)
+                {
+                    long q = std::lround(w[(size_t)p * l.out + j] / l.weight_scale[j]);
+                    l.weight[(size_t)p * l.out + j] = static_cast<int8_t>(std::min(std::max(q, -127L), 127L));
+                }
+            }
+            prepare(l);
+        }
+    }
+
+    QuantizedMLP::QuantizedMLP(const std::string &filename)
+    {
+        Checkpoint checkpoint(filename);
+        for (uint32_t index = 0;; ++index)
+        {
+            const CheckpointEntry *weight = checkpoint.lookup(index, CheckpointKind::WEIGHT);
+            if (!weight)
+            {
+                break;
+            }
+            uint32_t type = checked_layer_type(*weight, index);
+            const CheckpointEntry &bias = checkpoint.find(index, CheckpointKind::BIAS);
+            const CheckpointEntry &scale = checkpoint.find(index, CheckpointKind::WEIGHT_SCALE);
+            const CheckpointEntry &input = checkpoint.find(index, CheckpointKind::INPUT_QUANT);
+            if (weight->ndim != 2 || bias.ndim != 1 || bias.shape[0] != weight->shape[1] ||
+                scale.ndim != 1 || scale.shape[0] != weight->shape[1] || input.ndim != 1 || input.shape[0] != 2)
+            {
+                throw std::runtime_error("Invalid quantized Linear layer " + std::to_string(index) + " in " + filename);
+            }
+            if (!layers.empty() && layers.back().out != weight->shape[0])
+            {
+                throw std::runtime_error("Quantized layer " + std::to_string(index) + " in " + filename + " does not match the previous layer");
+            }
+            layer l;
+            l.in = weight->shape[0];
+            l.out = weight->shape[1];
+            l.relu = type == quantized_linear_relu_layer;
+            const int8_t *w = checkpoint.int8_values(*weight);
+            l.weight.assign(w, w + (size_t)l.in * l.out);
+            const float *s = checkpoint.values(scale);
+            l.weight_scale.assign(s, s + l.out);
+            const float *b = checkpoint.values(bias);
+            l.bias.assign(b, b + l.out);
+            const float *q = checkpoint.values(input);
+            l.input_scale = q[0];
+            l.input_zero = (int)q[1];
+            if (!(l.input_scale > 0.0f) || l.input_zero < 0 || l.input_zero > quantized_activation_max)
+            {
+                throw std::runtime_error("Invalid input quantization of layer " + std::to_string(index) + " in " + filename);
+            }
+            prepare(l);
+            layers.push_back(std::move(l));
+        }
+        if (layers.empty())
+        {
+            throw std::runtime_error("Checkpoint " + filename + " has no quantized layers");
+        }
+    }
+
+    void QuantizedMLP::prepare(layer &l)
+    {
+        l.in_padded = round_up(l.in, 4);
+        l.out_padded = round_up(l.out, NR);
+        l.packed.resize(int8_packed_size(l.in, l.out));
+        pack_int8_weights(l.weight.data(), l.in, l.out, l.packed.data());
+
+        // sum_k (qx - z) * qw = acc - z * sum_k qw，零点修正和偏置合并成每列一个 offset
+        std::vector<int32_t> column_sum(l.out, 0);
+        for (int p = 0; p < l.in; ++p)
+        {
+            for (int j = 0; j < l.out; ++j)
+            {
+                column_sum[j] += l.weight[(size_t)p * l.out + j];
+            }
+        }
+        l.multiplier.resize(l.out);
+        l.offset.resize(l.out);
+        for (int j = 0; j < l.out; ++j)
+        {
+            l.multiplier[j] = l.input_scale * l.weight_scale[j];
+            l.offset[j] = l.bias[j] - l.multiplier[j] * (float)l.input_zero * (float)column_sum[j];
+        }
+    }
+
+    void QuantizedMLP::predict(const float *input, float *output, size_t batch) const
+    {
+        int widest_in = 0, widest_out = 0;
+        for (const auto &l : layers)
+        {
+            widest_in = std::max(widest_in, l.in_padded);
+            widest_out = std::max(widest_out, l.out_padded);
+        }
+        // 两个缓冲区在各层之间交替，行尾补齐部分可能留着上一层的数据，但对应的打包权重为 0，不影响结果
+        size_t block = std::min(ROW_BLOCK, batch);
+        std::vector<uint8_t> quantized[2] = {std::vector<uint8_t>(block * widest_in, 0), std::vector<uint8_t>(block * widest_in, 0)};
+        std::vector<int32_t> acc(block * widest_out);
+        std::vector<float> row(widest_out);
+
+        for (size_t start = 0; start < batch; start += ROW_BLOCK)
+        {
+            int rows = (int)std::min(ROW_BLOCK, batch - start);
+            const layer &first = layers.front();
+            for (int i = 0; i < rows; ++i)
+            {
+                quantize_row(input + (start + i) * first.in, first.in, 1.0f / first.input_scale, (float)first.input_zero,
+                             quantized[0].data() + (size_t)i * first.in_padded);
+            }
+            for (size_t index = 0; index < layers.size(); ++index)
+            {
+                const layer &l = layers[index];
+                const uint8_t *a = quantized[index % 2].data();
+                igemm_u8s8(rows, l.out, l.in, a, l.in_padded, l.packed.data(), acc.data(), l.out);
+
+                bool last = index + 1 == layers.size();
+                const layer *next = last ? nullptr : &layers[index + 1];
+                for (int i = 0; i < rows; ++i)
+                {
+                    const int32_t *src = acc.data() + (size_t)i * l.out;
+                    float *dst = last ? output + (start + i) * l.out : row.data();
+                    for (int j = 0; j < l.out; ++j)
+                    {
+                        float v = (float)src[j] * l.multiplier[j] + l.offset[j];
+                        dst[j] = l.relu ? std::max(v, 0.0f) : v;
+                    }
+                    if (next)
+                    {
+                        quantize_row(dst, l.out, 1.0f / next->input_scale, (float)next->input_zero,
+                                     quantized[(index + 1) % 2].data() + (size_t)i * next->in_padded);
+                    }
+                }
+            }
+        }
+    }
+
+    void QuantizedMLP::save_to_checkpoint(CheckpointWriter &checkpoint) const
+    {
+        for (const auto &l : layers)
+        {
+            uint32_t index = checkpoint.begin_layer(l.relu ? quantized_linear_relu_layer : quantized_linear_layer);
+            std::memcpy(checkpoint.allocate_int8(index, CheckpointKind::WEIGHT, {l.in, l.out}), l.weight.data(), l.weight.size());
+            checkpoint.add(index, CheckpointKind::BIAS, {l.out}, l.bias);
+            checkpoint.add(index, CheckpointKind::WEIGHT_SCALE, {l.out}, l.weight_scale);
+            checkpoint.add(index, CheckpointKind::INPUT_QUANT, {2}, std::vector<float>{l.input_scale, (float)l.input_zero});
+        }
+    }
+
+    void QuantizedMLP::save(const std::string &filename) const
+    {
+        CheckpointWriter checkpoint;
+        save_to_checkpoint(checkpoint);
+        checkpoint.write(filename);
+    }
+
+    size_t QuantizedMLP::weight_bytes() const
+    {
+        size_t bytes = 0;
+        for (const auto &l : layers)
+        {
+            bytes += l.weight.size() + (l.bias.size() + l.weight_scale.size()) * sizeof(float);
+        }
+        return bytes;
+    }
+
+} // namespace cctorch
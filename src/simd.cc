@@ -0,0 +1,57 @@
+#include "../include/simd.h"
+
+namespace cctorch
+{
+
+    namespace
+    {
+        bool detect_avx2_fma()
+        {
+#ifdef CCTORCH_X86_SIMD
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+            return false;
+#endif
+        }
+
+        bool detect_avx512_vnni()
+        {
+#ifdef CCTORCH_X86_SIMD
+            __builtin_cpu_init();
+            return detect_avx2_fma() && __builtin_cpu_supports("avx512vnni") && __builtin_cpu_supports("avx512vl");
+#else
+            return false;
+#endif
+        }
+
+        bool detect_f16c()
+        {
+#ifdef CCTORCH_X86_SIMD
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("f16c");
+#else
+            return false;
+#endif
+        }
+    }
+
+    bool cpu_has_avx2_fma()
+    {
+        static const bool supported = detect_avx2_fma();
+        return supported;
+    }
+
+    bool cpu_has_avx512_vnni()
+    {
+        static const bool supported = detect_avx512_vnni();
+        return supported;
+    }
+
+    bool cpu_has_f16c()
+    {
+        static const bool supported = detect_f16c();
+        return supported;
+    }
+
+} // namespace cctorch
@@ -0,0 +1,137 @@
+#include "../include/tape.h"
+#include <iterator>
+#include <stdexcept>
+
+namespace cctorch
+{
+
+    namespace
+    {
+        thread_local Tape *active_tape = nullptr;
+
+        // tape 模式下 sons 不参与计数，借它的最高位作为可达标记；
+        // 不在 tape 上的非叶子节点仍可能保存着计数，所以只置位、清位而不覆盖
+        constexpr unsigned int kReached = 1u << 31;
+    }
+
+    Tape::Scope::Scope(Tape &tape, bool keep_records) : tape(tape), previous(active_tape), keep_records(keep_records)
+    {
+        active_tape = &tape;
+    }
+
+    Tape::Scope::~Scope()
+    {
+        active_tape = previous;
+        if (!keep_records)
+        {
+            tape.clear();
+        }
+    }
+
+    Tape *Tape::current()
+    {
+        return active_tape;
+    }
+
+    void Tape::record(Tensor::back_type op, std::shared_ptr<tensor_data> out, tensor_data *in1, tensor_data *in2)
+    {
+        records.push_back({op, std::move(out), in1, in2});
+    }
+
+    void Tape::backward(const Tensor &root)
+    {
+        tensor_data *target = root.data.get();
+        // root 通常是最后一条记录（loss），从尾部往前找
+        size_t end = records.size();
+        while (end > 0 && records[end - 1].out.get() != target)
+        {
+            --end;
+        }
+        if (end == 0)
+        {
+            if (target && target->back == Tensor::back_type::NONE)
+            {
+                target->grad = 1.0f; // 叶子节点没有可以传播的记录
+                return;
+            }
+            throw std::logic_error("Tensor::backward: tensor was not recorded on the active tape.");
+        }
+
+        target->grad = 1.0f; // Initialize the gradient for the root tensor
+        // 叶子（参数、输入）没有记录，不需要标记
+        auto mark = [this](tensor_data *node)
+        {
+            if (node && node->back != Tensor::back_type::NONE && !(node->sons & kReached))
+            {
+                node->sons |= kReached;
+                reached.push_back(node);
+            }
+        };
+        mark(target);
+        for (size_t i = end; i-- > 0;)
+        {
+            tape_record &r = records[i];
+            if (r.op == Tensor::back_type::NONE || !(r.out->sons & kReached))
+            {
+                continue;
+            }
+            Tensor::backward_op(r.op, r.out.get(), r.in1, r.in2);
+            mark(r.in1);
+            mark(r.in2);
+            if (r.out->reduce)
+            {
+                for (const Tensor &input : r.out->reduce->inputs)
+                {
+                    mark(input.data.get());
+                }
+            }
+            r.op = Tensor::back_type::NONE;
+        }
+        // 标记过的节点都被记录或 root 引用着，此时仍然存活
+        for (tensor_data *node : reached)
+        {
+            node->sons &= ~kReached;
+        }
+        reached.clear();
+    }
+
+    std::vector<Tape> &Tape::shards(size_t n)
+    {
+        if (shard_tapes.size() < n)
+        {
+            shard_tapes.resize(n);
+        }
+        for (size_t i = 0; i < n; ++i)
+        {
+            shard_tapes[i].clear(); // 上一次录制中途抛出异常时可能留有记录
+        }
+        return shard_tapes;
+    }
+
+    void Tape::merge_shards(size_t n)
+    {
+        size_t total = records.size();
+        for (size_t i = 0; i < n; ++i)
+        {
+            total += shard_tapes[i].records.size();
+        }
+        records.reserve(total);
+        for (size_t i = 0; i < n; ++i)
+        {
+            std::vector<tape_record> &part = shard_tapes[i].records;
+            std::move(part.begin(), part.end(), std::back_inserter(records));
+            part.clear();
+        }
+    }
+
+    void Tape::clear()
+    {
+        records.clear();
+    }
+
+    size_t Tape::size() const
+    {
+        return records.size();
+    }
+
+} // namespace cctorch
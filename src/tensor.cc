@@ -1,22 +1,190 @@
 #include "../include/tensor.h"
+#include "../include/graph_arena.h"
+#include "../include/profiler.h"
+#include "../include/tape.h"
+#include "../include/thread_pool.h"
 #include <queue>
 #include <iostream>
 #include <cmath>
+#include <stdexcept>
 
 namespace cctorch
 {
 
+	namespace
+	{
+		thread_local bool no_grad_active = false;
+
+		// 中间节点优先从当前线程的 GraphArena 分配，没有活动 arena 时退回普通堆。
+		// 正在录制 Tape 时把运算追加到 tape 上，并且不再维护 sons 计数。
+		// NoGradGuard 作用域内只保存数值，得到的是叶子节点。
+		std::shared_ptr<tensor_data> make_node(float value, Tensor &par1, Tensor &par2, Tensor::back_type back)
+		{
+			if (no_grad_active)
+			{
+				if (GraphArena *arena = GraphArena::current())
+				{
+					return std::allocate_shared<tensor_data>(arena_allocator<tensor_data>(arena), value);
+				}
+				return std::make_shared<tensor_data>(value);
+			}
+
+			tensor_data *in1 = par1.data.get();
+			tensor_data *in2 = par2.data.get();
+			Tape *tape = Tape::current();
+			if (!tape)
+			{
+				if (in1)
+					in1->sons++;
+				if (in2)
+					in2->sons++;
+			}
+
+			std::shared_ptr<tensor_data> node;
+			if (GraphArena *arena = GraphArena::current())
+			{
+				node = std::allocate_shared<tensor_data>(arena_allocator<tensor_data>(arena), value, std::move(par1), std::move(par2), back);
+			}
+			else
+			{
+				node = std::make_shared<tensor_data>(value, std::move(par1), std::move(par2), back);
+			}
+
+			if (tape)
+			{
+				tape->record(back, node, in1, in2);
+			}
+			return node;
+		}
+
+		struct direct_accumulate
+		{
+			void operator()(float &grad, float delta) const
+			{
+				grad += delta;
+			}
+		};
+
+		// 并行反向传播时多个子节点可能同时向同一个父节点累加梯度。grad 是普通的 float，
+		// 用 std::atomic_ref（C++20）或 GCC/Clang 的 __atomic 内建函数对它做原子操作，而不是把它强转成 atomic<float>
+		struct atomic_accumulate
+		{
+			void operator()(float &grad, float delta) const
+			{
+#if defined(__cpp_lib_atomic_ref)
+				std::atomic_ref<float> target(grad);
+				float current = target.load(std::memory_order_relaxed);
+				while (!target.compare_exchange_weak(current, current + delta, std::memory_order_relaxed))
+				{
+				}
+#else
+				float current;
+				__atomic_load(&grad, &current, __ATOMIC_RELAXED);
+				float desired = current + delta;
+				while (!__atomic_compare_exchange(&grad, &current, &desired, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				{
+					desired = current + delta;
+				}
+#endif
+			}
+		};
+
+		// 各运算的反向传播公式，acc 决定梯度如何累加
+		template <class Acc>
+		void apply_backward(Tensor::back_type back, tensor_data *out, tensor_data *in1, tensor_data *in2, Acc acc)
+		{
+			switch (back) // Using switch-case for clarity
+			{
+			case Tensor::back_type::ADD:
+				acc(in1->grad, out->grad);
+				acc(in2->grad, out->grad);
+				break;
+
+			case Tensor::back_type::SUB:
+				acc(in1->grad, out->grad);
+				acc(in2->grad, -out->grad);
+				break;
+
+			case Tensor::back_type::MUL:
+				acc(in1->grad, in2->value * out->grad);
+				acc(in2->grad, in1->value * out->grad);
+				break;
+
+			case Tensor::back_type::DIV:
+				acc(in1->grad, out->grad / in2->value);
+				acc(in2->grad, -(in1->value * out->grad) / (in2->value * in2->value));
+				break;
+
+			case Tensor::back_type::RELU:
+				if (in1->value > 0) // 基于输入值判断，而不是输出值
+				{
+					acc(in1->grad, out->grad);
+				}
+				break;
+
+			case Tensor::back_type::EXP:
+				acc(in1->grad, out->grad * out->value);
+				break;
+
+			case Tensor::back_type::LOG:
+				acc(in1->grad, out->grad / in1->value);
+				break;
+
+			case Tensor::back_type::REDUCE:
+			{
+				const reduce_data &r = *out->reduce;
+				for (size_t i = 0; i < r.inputs.size(); ++i)
+				{
+					acc(r.inputs[i].data->grad, out->grad * r.partials[i]);
+				}
+				break;
+			}
+
+			case Tensor::back_type::NONE:
+				return;
+			}
+		}
+	}
+
+	NoGradGuard::NoGradGuard(bool no_grad) : previous(no_grad_active)
+	{
+		no_grad_active = previous || no_grad;
+	}
+
+	NoGradGuard::~NoGradGuard()
+	{
+		no_grad_active = previous;
+	}
+
+	bool NoGradGuard::active()
+	{
+		return no_grad_active;
+	}
+
 	// Constructor implementations
 	Tensor::Tensor(float value) : data(std::make_shared<tensor_data>(value)) {}
 
 	Tensor::Tensor(float value, Tensor par1, Tensor par2, back_type back)
-		: data(std::make_shared<tensor_data>(value, par1, par2, back)) {}
+		: data(make_node(value, par1, par2, back)) {}
 
 	tensor_data::tensor_data(float value)
-		: value(value), grad(0.0f), sons(0), back(Tensor::back_type::NONE) {}
+		: value(value), grad(0.0f), sons(0), back(Tensor::back_type::NONE)
+	{
+		CCTORCH_PROFILE_NODE_CREATED(sizeof(tensor_data));
+	}
 
 	tensor_data::tensor_data(float value, Tensor par1, Tensor par2, Tensor::back_type back)
-		: value(value), grad(0.0f), par1(par1), par2(par2), sons(0), back(back) {}
+		: value(value), grad(0.0f), par1(std::move(par1)), par2(std::move(par2)), sons(0), back(back)
+	{
+		CCTORCH_PROFILE_NODE_CREATED(sizeof(tensor_data));
+	}
+
+#ifdef CCTORCH_PROFILE
+	tensor_data::~tensor_data()
+	{
+		CCTORCH_PROFILE_NODE_DESTROYED();
+	}
+#endif
 
 	float Tensor::value() const
 	{
@@ -36,43 +204,23 @@ namespace cctorch
 	// Backward propagation implementation
 	void Tensor::_backward() const
 	{
-		switch (this->data->back) // Using switch-case for clarity
-		{
-		case back_type::ADD:
-			add_backward();
-			break;
-
-		case back_type::SUB:
-			sub_backward();
-			break;
-
-		case back_type::MUL:
-			mul_backward();
-			break;
-
-		case back_type::DIV:
-			div_backward();
-			break;
-
-		case back_type::RELU:
-			relu_backward();
-			break;
-
-		case back_type::EXP:
-			exp_backward();
-			break;
-
-		case back_type::LOG:
-			log_backward();
-			break;
+		backward_op(data->back, data.get(), data->par1.data.get(), data->par2.data.get());
+	}
 
-		case back_type::NONE:
-			return;
-		}
+	void Tensor::backward_op(back_type back, tensor_data *out, tensor_data *in1, tensor_data *in2)
+	{
+		apply_backward(back, out, in1, in2, direct_accumulate());
 	}
 
 	void Tensor::backward()
 	{
+		CCTORCH_PROFILE_SCOPE("Tensor::backward");
+		if (Tape *tape = Tape::current())
+		{
+			tape->backward(*this);
+			return;
+		}
+
 		std::queue<Tensor> que;
 		que.push(*this);
 		this->data->grad = 1.0f; // Initialize the gradient for the root tensor
@@ -90,59 +238,137 @@ namespace cctorch
 			{
 				que.push(current.data->par2);
 			}
+			if (current.data->reduce)
+			{
+				for (const Tensor &input : current.data->reduce->inputs)
+				{
+					if (input.topo_decent())
+					{
+						que.push(input);
+					}
+				}
+				current.data->reduce.reset();
+			}
 			current.drop_par(1); // Clear the reference to avoid dangling pointers
 			current.drop_par(2); // Clear the reference to avoid dangling pointers
 		}
 	}
 
+	void Tensor::backward(ThreadPool &pool)
+	{
+		CCTORCH_PROFILE_SCOPE("Tensor::backward");
+		if (Tape::current())
+		{
+			backward(); // tape 模式下没有 sons 计数
+			return;
+		}
+
+		this->data->grad = 1.0f; // Initialize the gradient for the root tensor
+		// 每个任务沿着一条链往上走：第一个被释放的父节点在本任务内继续处理，其余的提交给线程池。
+		// 叶子节点（参数、输入）没有需要执行的反向公式，不再调度。
+		std::function<void(Tensor)> run = [&pool, &run](Tensor current)
+		{
+			while (current.data)
+			{
+				tensor_data *node = current.data.get();
+				apply_backward(node->back, node, node->par1.data.get(), node->par2.data.get(), atomic_accumulate());
+
+				Tensor next;
+				auto release = [&](const Tensor &par)
+				{
+					if (par.topo_decent() && par.data->back != back_type::NONE)
+					{
+						if (!next.data)
+						{
+							next = par;
+						}
+						else
+						{
+							pool.submit([&run, par]
+										{ run(par); });
+						}
+					}
+				};
+				release(node->par1);
+				release(node->par2);
+				if (node->reduce)
+				{
+					for (const Tensor &input : node->reduce->inputs)
+					{
+						release(input);
+					}
+					node->reduce.reset();
+				}
+				current.drop_par(1);
+				current.drop_par(2);
+				current = std::move(next);
+			}
+		};
+		// 某个任务抛出异常时，wait() 等所有任务（它们引用着 run）结束后再重新抛出
+		pool.submit([&run, root = *this]
+					{ run(root); });
+		pool.wait();
+	}
+
 	// Operator implementations
 	Tensor Tensor::operator+(const Tensor &other) const
 	{
-		this->data->sons++;
-		other.data->sons++;
 		return Tensor(this->data->value + other.data->value, *this, other, back_type::ADD);
 	}
 
 	// Operator implementations
 	Tensor Tensor::operator-(const Tensor &other) const
 	{
-		this->data->sons++;
-		other.data->sons++;
 		return Tensor(this->data->value - other.data->value, *this, other, back_type::SUB);
 	}
 
 	Tensor Tensor::operator*(const Tensor &other) const
 	{
-		this->data->sons++;
-		other.data->sons++;
 		return Tensor(this->data->value * other.data->value, *this, other, back_type::MUL);
 	}
 
 	Tensor Tensor::operator/(const Tensor &other) const
 	{
-		this->data->sons++;
-		other.data->sons++;
 		return Tensor(this->data->value / other.data->value, *this, other, back_type::DIV);
 	}
 
 	Tensor Tensor::relu() const
 	{
-		this->data->sons++;
 		return Tensor((this->data->value > 0) ? this->data->value : 0, *this, Tensor(), back_type::RELU);
 	}
 
 	Tensor Tensor::exp() const
 	{
-		this->data->sons++;
 		return Tensor(std::exp(this->data->value), *this, Tensor(), back_type::EXP);
 	}
 
 	Tensor Tensor::log() const
 	{
-		this->data->sons++;
 		return Tensor(std::log(this->data->value), *this, Tensor(), back_type::LOG);
 	}
 
+	Tensor Tensor::reduce(float value, std::vector<Tensor> inputs, std::vector<float> partials)
+	{
+		if (inputs.size() != partials.size())
+		{
+			throw std::invalid_argument("Tensor::reduce requires one partial derivative per input.");
+		}
+		if (no_grad_active)
+		{
+			return Tensor(value);
+		}
+		if (!Tape::current())
+		{
+			for (const Tensor &input : inputs)
+			{
+				input.data->sons++;
+			}
+		}
+		Tensor out(value, Tensor(), Tensor(), back_type::REDUCE);
+		out.data->reduce = std::make_unique<reduce_data>(reduce_data{std::move(inputs), std::move(partials)});
+		return out;
+	}
+
 	void Tensor::zero_grad()
 	{
 		if (data)
@@ -166,49 +392,6 @@ namespace cctorch
 		}
 	}
 
-	// Private backward function implementations
-	void Tensor::add_backward() const
-	{
-		data->par1.data->grad += data->grad;
-		data->par2.data->grad += data->grad;
-	}
-
-	void Tensor::sub_backward() const
-	{
-		data->par1.data->grad += data->grad;
-		data->par2.data->grad -= data->grad;
-	}
-
-	void Tensor::mul_backward() const
-	{
-		data->par1.data->grad += data->par2.data->value * data->grad;
-		data->par2.data->grad += data->par1.data->value * data->grad;
-	}
-
-	void Tensor::div_backward() const
-	{
-		data->par1.data->grad += data->grad / data->par2.data->value;
-		data->par2.data->grad -= (data->par1.data->value * data->grad) / (data->par2.data->value * data->par2.data->value);
-	}
-
-	void Tensor::relu_backward() const
-	{
-		if (data->par1.data->value > 0) // 基于输入值判断，而不是输出值
-		{
-			data->par1.data->grad += data->grad;
-		}
-	}
-
-	void Tensor::exp_backward() const
-	{
-		data->par1.data->grad += data->grad * data->value;
-	}
-
-	void Tensor::log_backward() const
-	{
-		data->par1.data->grad += data->grad / data->par1.value();
-	}
-
 	std::vector<cctorch::Tensor> flatten(const std::vector<std::vector<cctorch::Tensor>> &inputs)
 	{
 		std::vector<cctorch::Tensor> flat;
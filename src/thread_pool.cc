@@ -0,0 +1,252 @@
+#include "../include/thread_pool.h"
+#include <algorithm>
+
+namespace cctorch
+{
+
+    namespace
+    {
+        thread_local const ThreadPool *current_pool = nullptr;
+        thread_local size_t current_index = 0;
+    }
+
+    ThreadPool::ThreadPool(size_t num_threads)
+        : pending(0), queued(0), next_queue(0), stopping(false)
+    {
+        if (num_threads == 0)
+        {
+            num_threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for (size_t i = 0; i < num_threads; ++i)
+        {
+            queues.push_back(std::make_unique<worker_queue>());
+        }
+        for (size_t i = 0; i < num_threads; ++i)
+        {
+            threads.emplace_back(&ThreadPool::worker_loop, this, i);
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        try
+        {
+            wait();
+        }
+        catch (...)
+        {
+            // 没有人取走的任务异常在析构时丢弃
+        }
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    size_t ThreadPool::size() const
+    {
+        return queues.size();
+    }
+
+    size_t ThreadPool::worker_index() const
+    {
+        return current_pool == this ? current_index : size();
+    }
+
+    void ThreadPool::submit(std::function<void()> task)
+    {
+        size_t index = worker_index();
+        if (index == size())
+        {
+            index = next_queue.fetch_add(1, std::memory_order_relaxed) % size();
+        }
+        pending.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(queues[index]->mutex);
+            queues[index]->tasks.push_back(std::move(task));
+            queued.fetch_add(1, std::memory_order_relaxed);
+        }
+        {
+            // 空临界区：保证正在检查等待条件的线程不会错过这次唤醒
+            std::lock_guard<std::mutex> lock(wake_mutex);
+        }
+        wake.notify_one();
+    }
+
+    bool ThreadPool::try_pop(size_t index, std::function<void()> &task)
+    {
+        if (queued.load(std::memory_order_relaxed) == 0)
+        {
+            return false;
+        }
+        size_t n = size();
+        if (index < n)
+        {
+            // 自己的队列从队尾取
+            std::lock_guard<std::mutex> lock(queues[index]->mutex);
+            auto &tasks = queues[index]->tasks;
+            if (!tasks.empty())
+            {
+                task = std::move(tasks.back());
+                tasks.pop_back();
+                queued.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        // 从其他队列的队首窃取
+        size_t start = index < n ? index + 1 : 0;
+        for (size_t k = 0; k < n; ++k)
+        {
+            auto &victim = *queues[(start + k) % n];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty())
+            {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                queued.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void ThreadPool::run_task(std::function<void()> &task)
+    {
+        try
+        {
+            task();
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error)
+            {
+                error = std::current_exception();
+            }
+        }
+        task = nullptr;
+        finish_task();
+    }
+
+    void ThreadPool::finish_task()
+    {
+        if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex);
+            done.notify_all();
+        }
+    }
+
+    void ThreadPool::worker_loop(size_t index)
+    {
+        current_pool = this;
+        current_index = index;
+        std::function<void()> task;
+        while (true)
+        {
+            if (try_pop(index, task))
+            {
+                run_task(task);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(wake_mutex);
+            wake.wait(lock, [this]
+                      { return stopping || queued.load(std::memory_order_relaxed) > 0; });
+            if (stopping && queued.load(std::memory_order_relaxed) == 0)
+            {
+                return;
+            }
+        }
+    }
+
+    void ThreadPool::wait()
+    {
+        std::function<void()> task;
+        while (try_pop(worker_index(), task))
+        {
+            run_task(task);
+        }
+        {
+            std::unique_lock<std::mutex> lock(wake_mutex);
+            done.wait(lock, [this]
+                      { return pending.load(std::memory_order_acquire) == 0; });
+        }
+        std::exception_ptr failed;
+        {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            std::swap(failed, error);
+        }
+        if (failed)
+        {
+            std::rethrow_exception(failed);
+        }
+    }
+
+    void ThreadPool::parallel_for(size_t n, const std::function<void(size_t, size_t)> &fn, size_t grain)
+    {
+        if (n == 0)
+        {
+            return;
+        }
+        grain = std::max<size_t>(grain, 1);
+        size_t chunks = std::min(size(), (n + grain - 1) / grain);
+        if (chunks <= 1)
+        {
+            fn(0, n);
+            return;
+        }
+        size_t step = (n + chunks - 1) / chunks;
+        // 用自己的计数器等待这几个区间，而不是 wait()，这样在任务内部嵌套调用也不会死锁。
+        // 区间的异常记在本次调用里，等所有区间结束（它们引用着 fn 和这些局部变量）之后再抛出
+        std::atomic<size_t> remaining(0);
+        std::mutex failed_mutex;
+        std::exception_ptr failed;
+        auto run_chunk = [&fn, &failed_mutex, &failed](size_t begin, size_t end)
+        {
+            try
+            {
+                fn(begin, end);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(failed_mutex);
+                if (!failed)
+                {
+                    failed = std::current_exception();
+                }
+            }
+        };
+        for (size_t begin = step; begin < n; begin += step)
+        {
+            size_t end = std::min(n, begin + step);
+            remaining.fetch_add(1, std::memory_order_relaxed);
+            submit([&run_chunk, &remaining, begin, end]
+                   {
+                       run_chunk(begin, end);
+                       remaining.fetch_sub(1, std::memory_order_release); });
+        }
+        run_chunk(0, std::min(n, step));
+        std::function<void()> task;
+        while (remaining.load(std::memory_order_acquire) > 0)
+        {
+            if (try_pop(worker_index(), task))
+            {
+                run_task(task);
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+        if (failed)
+        {
+            std::rethrow_exception(failed);
+        }
+    }
+
+} // namespace cctorch
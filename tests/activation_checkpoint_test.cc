@@ -0,0 +1,167 @@
+#include "dense_tensor.h"
+#include "model.h"
+#include "sequential.h"
+#include "check.h"
+#include <algorithm>
+#include <vector>
+
+using namespace cctorch;
+
+namespace
+{
+    constexpr int kBatch = 5;
+    constexpr int kIn = 6;
+    constexpr int kHidden = 7;
+    constexpr int kOut = 3;
+
+    DenseTensor filled(const std::vector<int> &shape, int seed, bool requires_grad = true)
+    {
+        size_t n = 1;
+        for (int d : shape)
+        {
+            n *= d;
+        }
+        std::vector<float> x(n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            x[i] = 0.1f * (float)((i * 7 + seed * 3) % 13) - 0.6f;
+        }
+        return DenseTensor(shape, x, requires_grad);
+    }
+
+    std::vector<unsigned char> labels()
+    {
+        std::vector<unsigned char> y;
+        for (int i = 0; i < kBatch; ++i)
+        {
+            y.push_back(i % kOut);
+        }
+        return y;
+    }
+
+    // 取出梯度并清零
+    std::vector<float> take_grads(std::vector<DenseTensor> tensors)
+    {
+        std::vector<float> g;
+        for (DenseTensor &t : tensors)
+        {
+            g.insert(g.end(), t.grad_ptr(), t.grad_ptr() + t.numel());
+            t.zero_grad();
+        }
+        return g;
+    }
+
+    void check_same(const std::vector<float> &a, const std::vector<float> &b)
+    {
+        CHECK(a.size() == b.size());
+        for (size_t i = 0; i < a.size(); ++i)
+        {
+            CHECK_NEAR(a[i], b[i], 1e-6);
+        }
+    }
+
+    class TwoLayer : public Model
+    {
+    public:
+        DenseTensor w1 = filled({kIn, kHidden}, 1), b1 = filled({kHidden}, 2);
+        DenseTensor w2 = filled({kHidden, kOut}, 3), b2 = filled({kOut}, 4);
+
+        std::vector<Tensor> forward(const std::vector<Tensor> &input) override { return input; }
+        DenseTensor forward(const DenseTensor &input) override { return input.linear_relu(w1, b1).linear(w2, b2); }
+        std::vector<DenseTensor> dense_parameters() override { return {w1, b1, w2, b2}; }
+    };
+}
+
+// 检查点段前后都有可求导的计算、段的输出被两处使用：损失和所有梯度（段内参数、段之前的参数、输入）与不加检查点时相同
+static void checkpointed_matches_eager()
+{
+    DenseTensor x = filled({kBatch, kIn}, 5);
+    DenseTensor w0 = filled({kIn, kIn}, 6), b0 = filled({kIn}, 7);
+    TwoLayer segment;
+    std::vector<DenseTensor> tracked = segment.dense_parameters();
+    tracked.push_back(w0);
+    tracked.push_back(b0);
+    tracked.push_back(x);
+
+    float losses[2];
+    std::vector<float> grads[2];
+    for (int checkpointed = 0; checkpointed < 2; ++checkpointed)
+    {
+        DenseTensor h = x.linear_relu(w0, b0);
+        DenseTensor y = checkpointed ? h.checkpointed([&segment](const DenseTensor &in)
+                                                      { return segment.forward(in); })
+                                     : segment.forward(h);
+        DenseTensor loss = y.cross_entropy(labels()) + y.sum();
+        loss.backward();
+        losses[checkpointed] = loss.item();
+        grads[checkpointed] = take_grads(tracked);
+    }
+    CHECK_NEAR(losses[1], losses[0], 1e-6);
+    check_same(grads[1], grads[0]);
+
+    // 原样返回输入的段：梯度直接传给输入
+    DenseTensor y = x.linear(w0, b0).checkpointed([](const DenseTensor &in)
+                                                  { return in; });
+    y.sum().backward();
+    std::vector<float> identity = take_grads({w0, b0, x});
+    x.linear(w0, b0).sum().backward();
+    check_same(identity, take_grads({w0, b0, x}));
+
+    // 推理模式下直接执行段，结果没有梯度缓冲区
+    NoGradGuard no_grad;
+    DenseTensor inference = x.checkpointed([&segment](const DenseTensor &in)
+                                           { return segment.forward(in); });
+    CHECK(!inference.requires_grad() && inference.shape() == std::vector<int>({kBatch, kOut}));
+}
+
+// ActivationCheckpoint 包装的模型与直接调用给出相同的梯度
+static void activation_checkpoint_model()
+{
+    TwoLayer model;
+    ActivationCheckpoint wrapped(model);
+    CHECK(wrapped.dense_parameters().size() == 4);
+    DenseTensor x = filled({kBatch, kIn}, 8, false);
+    model(x).cross_entropy(labels()).backward();
+    std::vector<float> eager = take_grads(model.dense_parameters());
+    wrapped(x).cross_entropy(labels()).backward();
+    check_same(take_grads(model.dense_parameters()), eager);
+}
+
+// fixed::Sequential 每 1、2 步一段和不分段得到相同的梯度（融合的 Linear + ReLU 算一步）
+static void sequential_checkpoint_every()
+{
+    using MLP = fixed::Sequential<fixed::Linear<kIn, kHidden>, fixed::ReLU,
+                                  fixed::Linear<kHidden, kHidden>, fixed::ReLU,
+                                  fixed::Linear<kHidden, kOut>>;
+    MLP model;
+    int seed = 20;
+    for (DenseTensor &p : model.dense_parameters())
+    {
+        DenseTensor values = filled(p.shape(), seed++);
+        std::copy(values.value_ptr(), values.value_ptr() + p.numel(), p.value_ptr());
+    }
+    DenseTensor x = filled({kBatch, kIn}, 9, false);
+    std::vector<float> reference;
+    for (size_t steps : {0, 1, 2, 5})
+    {
+        model.set_checkpoint_every(steps);
+        model(x).cross_entropy(labels()).backward();
+        std::vector<float> grads = take_grads(model.dense_parameters());
+        if (steps == 0)
+        {
+            reference = grads;
+        }
+        else
+        {
+            check_same(grads, reference);
+        }
+    }
+}
+
+int main()
+{
+    checkpointed_matches_eager();
+    activation_checkpoint_model();
+    sequential_checkpoint_every();
+    return check::result();
+}
@@ -0,0 +1,93 @@
+#include "dense_tensor.h"
+#include "check.h"
+
+using namespace cctorch;
+
+namespace
+{
+    std::vector<float> pattern(size_t n, float scale)
+    {
+        std::vector<float> v(n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            v[i] = scale * static_cast<float>((i * 37) % 17) / 17.0f - scale / 2;
+        }
+        return v;
+    }
+}
+
+// 叶子（输入、权重、偏置）不复制成半精度，只有激活以半精度存储
+static void leaves_are_not_cast()
+{
+    DenseTensor x({4, 8}, pattern(32, 2.0f));
+    DenseTensor w1({8, 6}, pattern(48, 1.0f)), b1({6}, pattern(6, 0.2f));
+    DenseTensor w2({6, 3}, pattern(18, 1.0f));
+
+    AutocastGuard autocast(Precision::BF16);
+    DenseTensor h = x.linear_relu(w1, b1);
+    CHECK(h.dtype() == Precision::BF16);
+    CHECK(h.data->par1.data == x.data);
+    CHECK(h.data->par2.data == w1.data);
+    CHECK(h.data->par3.data == b1.data);
+
+    DenseTensor y = h.matmul(w2);
+    CHECK(y.data->par1.data == h.data);
+    CHECK(y.data->par2.data == w2.data);
+
+    // fp32 的激活进入矩阵乘法前仍然转换一次
+    DenseTensor z = (h + h).matmul(w2);
+    CHECK(z.data->par1.data->back == DenseTensor::back_type::CAST);
+    CHECK(z.data->par1.grad_ptr() != nullptr);
+}
+
+// bf16 激活下的梯度与 fp32 接近
+static void gradients_match_fp32()
+{
+    auto run = [](Precision precision, std::vector<float> &gw1, std::vector<float> &gw2)
+    {
+        DenseTensor x({4, 8}, pattern(32, 2.0f));
+        DenseTensor w1({8, 6}, pattern(48, 1.0f)), b1({6}, pattern(6, 0.2f));
+        DenseTensor w2({6, 3}, pattern(18, 1.0f)), b2({3}, pattern(3, 0.2f));
+        {
+            AutocastGuard autocast(precision);
+            x.linear_relu(w1, b1).linear(w2, b2).cross_entropy({0, 1, 2, 1}).backward();
+        }
+        gw1.assign(w1.grad_ptr(), w1.grad_ptr() + w1.numel());
+        gw2.assign(w2.grad_ptr(), w2.grad_ptr() + w2.numel());
+    };
+    std::vector<float> f1, f2, h1, h2;
+    run(Precision::FP32, f1, f2);
+    run(Precision::BF16, h1, h2);
+    for (size_t i = 0; i < f1.size(); ++i)
+    {
+        CHECK(std::fabs(h1[i] - f1[i]) <= 2e-2 * (1 + std::fabs(f1[i])));
+    }
+    for (size_t i = 0; i < f2.size(); ++i)
+    {
+        CHECK(std::fabs(h2[i] - f2[i]) <= 2e-2 * (1 + std::fabs(f2[i])));
+    }
+}
+
+// 没有梯度缓冲区的张量转换精度得到的也是叶子，不分配梯度
+static void cast_of_no_grad_tensor()
+{
+    DenseTensor x({2, 2}, {1, 2, 3, 4});
+    DenseTensor frozen;
+    {
+        NoGradGuard g;
+        frozen = x + x;
+    }
+    DenseTensor half = frozen.to(Precision::BF16);
+    CHECK(half.data->back == DenseTensor::back_type::NONE);
+    CHECK(half.grad_ptr() == nullptr);
+    CHECK_NEAR(half.value(3), 8.0, 0);
+    CHECK(frozen.data->sons == 0);
+}
+
+int main()
+{
+    leaves_are_not_cast();
+    gradients_match_fp32();
+    cast_of_no_grad_tensor();
+    return check::result();
+}
@@ -0,0 +1,71 @@
+#ifndef CCTORCH_TESTS_CHECK_H
+#define CCTORCH_TESTS_CHECK_H
+
+#include <cmath>
+#include <iostream>
+
+// 测试用的最小断言：失败时打印位置并计数，main 最后 return check::result() 交给 CTest 判断
+namespace check
+{
+    inline int &failures()
+    {
+        static int count = 0;
+        return count;
+    }
+
+    inline void fail(const char *file, int line, const char *expr)
+    {
+        std::cerr << file << ":" << line << ": check failed: " << expr << "\n";
+        ++failures();
+    }
+
+    inline bool near(double a, double b, double tol)
+    {
+        return std::fabs(a - b) <= tol * (1.0 + std::fabs(b));
+    }
+
+    inline int result()
+    {
+        if (failures())
+        {
+            std::cerr << failures() << " check(s) failed\n";
+        }
+        return failures() ? 1 : 0;
+    }
+}
+
+#define CHECK(cond)                                  \
+    do                                               \
+    {                                                \
+        if (!(cond))                                 \
+            check::fail(__FILE__, __LINE__, #cond);  \
+    } while (0)
+
+#define CHECK_NEAR(a, b, tol)                                                                    \
+    do                                                                                           \
+    {                                                                                            \
+        double check_a = (a), check_b = (b);                                                     \
+        if (!check::near(check_a, check_b, (tol)))                                               \
+        {                                                                                        \
+            std::cerr << "  " << #a << " = " << check_a << ", " << #b << " = " << check_b << "\n"; \
+            check::fail(__FILE__, __LINE__, #a " ~= " #b);                                       \
+        }                                                                                        \
+    } while (0)
+
+#define CHECK_THROWS(expr, type)                               \
+    do                                                         \
+    {                                                          \
+        bool check_thrown = false;                             \
+        try                                                    \
+        {                                                      \
+            expr;                                              \
+        }                                                      \
+        catch (const type &)                                   \
+        {                                                      \
+            check_thrown = true;                               \
+        }                                                      \
+        if (!check_thrown)                                     \
+            check::fail(__FILE__, __LINE__, #expr " throws " #type); \
+    } while (0)
+
+#endif // CCTORCH_TESTS_CHECK_H
@@ -0,0 +1,318 @@
+#include "checkpoint.h"
+#include "layer.h"
+#include "optimizer.h"
+#include "check.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace cctorch;
+
+namespace
+{
+    const std::string kFile = "checkpoint_test.ckpt";
+    const std::string kCorrupt = "checkpoint_test_corrupt.ckpt";
+    const std::string kDelta = "checkpoint_test_delta.ckpt";
+    const std::string kDelta2 = "checkpoint_test_delta2.ckpt";
+
+    std::vector<float> sequence(size_t n, float scale, int seed)
+    {
+        std::vector<float> x(n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            x[i] = scale * ((float)((i * 37 + seed * 11) % 101) - 50.0f) / 50.0f;
+        }
+        return x;
+    }
+
+    void fill(DenseTensor &t, int seed)
+    {
+        std::vector<float> x = sequence(t.numel(), 1.0f, seed);
+        std::copy(x.begin(), x.end(), t.value_ptr());
+        t.refresh_view();
+    }
+
+    bool same_values(const DenseTensor &a, const DenseTensor &b)
+    {
+        return a.numel() == b.numel() && std::memcmp(a.value_ptr(), b.value_ptr(), a.numel() * sizeof(float)) == 0;
+    }
+
+    std::vector<char> read_bytes(const std::string &filename)
+    {
+        std::ifstream in(filename, std::ios::binary);
+        return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    void write_bytes(const std::string &filename, const std::vector<char> &bytes)
+    {
+        std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+        out.write(bytes.data(), bytes.size());
+    }
+}
+
+// 两层 Linear、一个 int8 blob 和 Adam 状态写入后读回：层表、对齐、数值逐位一致，恢复的优化器继续训练结果相同
+static void round_trip()
+{
+    Linear first(5, 3), second(3, 2);
+    fill(first.weight, 1);
+    fill(first.bias, 2);
+    fill(second.weight, 3);
+    fill(second.bias, 4);
+    std::vector<DenseTensor> params = first.dense_parameters();
+    Adam optimizer(params, 0.01f);
+    for (DenseTensor &p : params)
+    {
+        std::vector<float> g = sequence(p.numel(), 0.3f, 5);
+        std::copy(g.begin(), g.end(), p.grad_ptr());
+    }
+    optimizer.step();
+
+    CheckpointWriter writer;
+    CHECK(first.save_to_checkpoint(writer) == 0);
+    CHECK(second.save_to_checkpoint(writer) == 1);
+    uint32_t extra = writer.begin_layer(7);
+    int8_t *q = writer.allocate_int8(extra, CheckpointKind::WEIGHT, {3});
+    q[0] = -128;
+    q[1] = 0;
+    q[2] = 127;
+    writer.add_optimizer(optimizer);
+    writer.write(kFile);
+    CHECK(writer.num_blobs() == 7);
+
+    Checkpoint checkpoint(kFile);
+    CHECK(Checkpoint::is_checkpoint(kFile) && !checkpoint.is_delta());
+    CHECK(checkpoint.entries().size() == 7 && checkpoint.has_optimizer_state());
+    for (const CheckpointEntry &entry : checkpoint.entries())
+    {
+        CHECK(entry.offset % checkpoint_alignment == 0);
+    }
+    const CheckpointEntry &w = checkpoint.find(1, CheckpointKind::WEIGHT);
+    CHECK(w.layer_type == 1 && w.ndim == 2 && w.shape[0] == 3 && w.shape[1] == 2);
+    CHECK(std::memcmp(checkpoint.values(w), second.weight.value_ptr(), 6 * sizeof(float)) == 0);
+    const int8_t *loaded = checkpoint.int8_values(checkpoint.find(extra, CheckpointKind::WEIGHT));
+    CHECK(loaded[0] == -128 && loaded[1] == 0 && loaded[2] == 127);
+    CHECK_THROWS(checkpoint.values(checkpoint.find(extra, CheckpointKind::WEIGHT)), std::runtime_error);
+    CHECK(checkpoint.lookup(5, CheckpointKind::BIAS) == nullptr);
+    CHECK_THROWS(checkpoint.find(5, CheckpointKind::BIAS), std::runtime_error);
+
+    Linear restored_first(5, 3), restored_second(3, 2);
+    restored_first.load_from_checkpoint(checkpoint, 0);
+    restored_second.load_from_checkpoint(checkpoint, 1);
+    CHECK(same_values(restored_first.weight, first.weight) && same_values(restored_first.bias, first.bias));
+    CHECK(same_values(restored_second.weight, second.weight) && same_values(restored_second.bias, second.bias));
+    CHECK_THROWS(Linear(4, 3).load_from_checkpoint(checkpoint, 0), std::runtime_error);
+
+    std::vector<DenseTensor> restored_params = restored_first.dense_parameters();
+    Adam restored(restored_params, 0.01f);
+    checkpoint.load_optimizer(restored);
+    for (size_t i = 0; i < params.size(); ++i)
+    {
+        std::vector<float> g = sequence(params[i].numel(), 0.2f, 6);
+        params[i].zero_grad();
+        restored_params[i].zero_grad();
+        std::copy(g.begin(), g.end(), params[i].grad_ptr());
+        std::copy(g.begin(), g.end(), restored_params[i].grad_ptr());
+    }
+    optimizer.step();
+    restored.step();
+    for (size_t i = 0; i < params.size(); ++i)
+    {
+        CHECK(same_values(params[i], restored_params[i]));
+    }
+    Adam too_small(std::vector<DenseTensor>{restored_first.bias}, 0.01f);
+    CHECK_THROWS(checkpoint.load_optimizer(too_small), std::runtime_error);
+}
+
+// 损坏的文件在打开时被拒绝：blob 字节被改动（校验和）、截断、魔数和版本不对、层表里的形状非法
+static void corruption_rejected()
+{
+    Linear layer(4, 3);
+    fill(layer.weight, 7);
+    CheckpointWriter writer;
+    layer.save_to_checkpoint(writer);
+    writer.write(kFile);
+    const std::vector<char> good = read_bytes(kFile);
+    const CheckpointEntry weight = Checkpoint(kFile).find(0, CheckpointKind::WEIGHT);
+
+    std::vector<char> bytes = good;
+    bytes[weight.offset + 5] ^= 0x01;
+    write_bytes(kCorrupt, bytes);
+    CHECK_THROWS(Checkpoint{kCorrupt}, std::runtime_error);
+    // 关闭校验时照常打开，读到的就是被改动的数值
+    Checkpoint unverified(kCorrupt, false);
+    CHECK(std::memcmp(unverified.values(unverified.find(0, CheckpointKind::WEIGHT)), bytes.data() + weight.offset, weight.bytes) == 0);
+
+    bytes = good;
+    bytes.resize(bytes.size() - 4);
+    write_bytes(kCorrupt, bytes);
+    CHECK_THROWS(Checkpoint(kCorrupt, false), std::runtime_error);
+
+    bytes = good;
+    bytes.resize(64 + sizeof(CheckpointEntry) / 2);
+    write_bytes(kCorrupt, bytes);
+    CHECK_THROWS(Checkpoint(kCorrupt, false), std::runtime_error);
+
+    bytes = good;
+    bytes[0] = 'X';
+    write_bytes(kCorrupt, bytes);
+    CHECK(!Checkpoint::is_checkpoint(kCorrupt));
+    CHECK_THROWS(Checkpoint{kCorrupt}, std::runtime_error);
+
+    bytes = good;
+    bytes[8] = 3;
+    write_bytes(kCorrupt, bytes);
+    CHECK_THROWS(Checkpoint{kCorrupt}, std::runtime_error);
+
+    // 两个负的维度相乘与字节数吻合（-1 * -12 = 12 个 float），仍然要拒绝
+    bytes = good;
+    CheckpointEntry entry;
+    std::memcpy(&entry, bytes.data() + 64, sizeof(entry));
+    CHECK(entry.kind == static_cast<uint32_t>(CheckpointKind::WEIGHT));
+    entry.shape[0] = -1;
+    entry.shape[1] = -12;
+    std::memcpy(bytes.data() + 64, &entry, sizeof(entry));
+    write_bytes(kCorrupt, bytes);
+    CHECK_THROWS(Checkpoint{kCorrupt}, std::runtime_error);
+
+    // 增量标志只能用带 base 的构造函数打开
+    bytes = good;
+    bytes[24] = static_cast<char>(checkpoint_flag_delta);
+    write_bytes(kCorrupt, bytes);
+    CHECK_THROWS(Checkpoint{kCorrupt}, std::runtime_error);
+}
+
+// 后台保存：快照在 commit 时已经拷贝，之后改动模型不影响文件；写入失败在 wait() 或下一次 commit 时抛出，之后仍可继续保存
+static void async_writer()
+{
+    Linear layer(4, 3);
+    fill(layer.weight, 8);
+    std::vector<float> saved(layer.weight.value_ptr(), layer.weight.value_ptr() + layer.weight.numel());
+    AsyncCheckpointWriter checkpointer;
+    layer.save_to_checkpoint(checkpointer.snapshot());
+    checkpointer.commit(kFile);
+    fill(layer.weight, 9);
+    checkpointer.wait();
+    CHECK(!checkpointer.busy());
+    {
+        Checkpoint checkpoint(kFile);
+        CHECK(std::memcmp(checkpoint.values(checkpoint.find(0, CheckpointKind::WEIGHT)), saved.data(), saved.size() * sizeof(float)) == 0);
+    }
+
+    const std::string missing = "checkpoint_test_missing_dir/model.ckpt";
+    layer.save_to_checkpoint(checkpointer.snapshot());
+    checkpointer.commit(missing);
+    CHECK_THROWS(checkpointer.wait(), std::runtime_error);
+    checkpointer.wait(); // 错误只抛出一次
+
+    layer.save_to_checkpoint(checkpointer.snapshot());
+    checkpointer.commit(missing);
+    layer.save_to_checkpoint(checkpointer.snapshot());
+    CHECK_THROWS(checkpointer.commit(kFile), std::runtime_error);
+
+    layer.save_to_checkpoint(checkpointer.snapshot());
+    checkpointer.commit(kFile);
+    checkpointer.wait();
+    Checkpoint checkpoint(kFile);
+    CHECK(std::memcmp(checkpoint.values(checkpoint.find(0, CheckpointKind::WEIGHT)), layer.weight.value_ptr(), saved.size() * sizeof(float)) == 0);
+}
+
+// 增量检查点逐位还原当前数值：未变化的块、微小更新（压缩）、整块替换（原样保存）、跨块边界、-0 和 NaN 载荷；
+// 基准里没有或形状不同的 blob 完整保存；增量可以再作为基准；换了基准或负载损坏时拒绝
+static void delta_round_trip()
+{
+    Linear big(40, 60), small(3, 2); // 2400 个权重，跨 3 个增量块
+    fill(big.weight, 10);
+    fill(big.bias, 11);
+    fill(small.weight, 12);
+    CheckpointWriter writer;
+    big.save_to_checkpoint(writer);
+    small.save_to_checkpoint(writer);
+    writer.write(kFile);
+    Checkpoint base(kFile);
+
+    float *w = big.weight.value_ptr();
+    for (size_t i = 0; i < 1024; i += 7)
+    {
+        w[i] += 1e-6f; // 第一块：只改低位
+    }
+    w[1023] = -0.0f;
+    w[1024] = std::numeric_limits<float>::quiet_NaN();
+    uint32_t payload = 0x7fc01234u;
+    std::memcpy(w + 1025, &payload, sizeof(payload));
+    for (size_t i = 2048; i < 2400; ++i)
+    {
+        w[i] = sequence(1, 1.0f, (int)i)[0] * 3.7f + (float)i; // 最后一块整块替换
+    }
+    Linear extra(2, 2);
+    fill(extra.weight, 13);
+    Linear reshaped(2, 3);
+    fill(reshaped.weight, 14);
+
+    writer.clear();
+    big.save_to_checkpoint(writer);
+    reshaped.save_to_checkpoint(writer); // 第 1 层形状变了
+    extra.save_to_checkpoint(writer);    // 第 2 层基准中没有
+    writer.write_delta(kDelta, base);
+    CHECK(read_bytes(kDelta).size() < read_bytes(kFile).size());
+
+    Checkpoint delta(kDelta, base);
+    CHECK(delta.is_delta());
+    CHECK(delta.find(0, CheckpointKind::WEIGHT).dtype == static_cast<uint32_t>(CheckpointDType::DELTA_XOR));
+    CHECK(delta.find(0, CheckpointKind::BIAS).dtype == static_cast<uint32_t>(CheckpointDType::DELTA_XOR));
+    CHECK(delta.find(1, CheckpointKind::WEIGHT).dtype == static_cast<uint32_t>(CheckpointDType::FLOAT32));
+    CHECK(delta.find(2, CheckpointKind::WEIGHT).dtype == static_cast<uint32_t>(CheckpointDType::FLOAT32));
+    Linear restored(40, 60), restored_reshaped(2, 3), restored_extra(2, 2);
+    restored.load_from_checkpoint(delta, 0);
+    restored_reshaped.load_from_checkpoint(delta, 1);
+    restored_extra.load_from_checkpoint(delta, 2);
+    CHECK(same_values(restored.weight, big.weight) && same_values(restored.bias, big.bias));
+    CHECK(same_values(restored_reshaped.weight, reshaped.weight) && same_values(restored_extra.weight, extra.weight));
+
+    // 以增量检查点为基准再写一次增量
+    w[5] = 42.0f;
+    writer.clear();
+    big.save_to_checkpoint(writer);
+    writer.write_delta(kDelta2, delta);
+    Checkpoint second(kDelta2, delta);
+    restored.load_from_checkpoint(second, 0);
+    CHECK(same_values(restored.weight, big.weight));
+
+    CHECK_THROWS(Checkpoint{kDelta}, std::runtime_error);
+    CHECK_THROWS(Checkpoint(kDelta2, base), std::runtime_error);
+    // 同样布局、不同数值的基准：id 不同
+    fill(big.bias, 15);
+    writer.clear();
+    big.save_to_checkpoint(writer);
+    small.save_to_checkpoint(writer);
+    writer.write(kCorrupt);
+    Checkpoint other(kCorrupt);
+    CHECK(other.id() != base.id());
+    CHECK_THROWS(Checkpoint(kDelta, other), std::runtime_error);
+
+    // 改动增量负载且不校验：解码时发现格式损坏
+    std::vector<char> bytes = read_bytes(kDelta);
+    const CheckpointEntry &entry = delta.find(0, CheckpointKind::WEIGHT);
+    bytes[entry.offset + 8 + 4] = 7; // 第一个变化块的模式：位于块大小、块数和 4 字节位图之后
+    write_bytes(kCorrupt, bytes);
+    CHECK_THROWS(Checkpoint(kCorrupt, base), std::runtime_error);
+    CHECK_THROWS(Checkpoint(kCorrupt, base, false), std::runtime_error);
+}
+
+int main()
+{
+    round_trip();
+    corruption_rejected();
+    async_writer();
+    delta_round_trip();
+    std::remove(kFile.c_str());
+    std::remove(kCorrupt.c_str());
+    std::remove(kDelta.c_str());
+    std::remove(kDelta2.c_str());
+    return check::result();
+}
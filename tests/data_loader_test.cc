@@ -0,0 +1,128 @@
+#include "data_loader.h"
+#include "check.h"
+#include "idx_files.h"
+#include <cmath>
+#include <string>
+#include <vector>
+
+using namespace cctorch;
+
+namespace
+{
+    const std::string kImages = "loader_test_images";
+    const std::string kLabels = "loader_test_labels";
+    constexpr uint32_t kCount = 10;
+    constexpr uint32_t kPixels = 6;
+
+    // 第 i 个样本的所有像素都是 i，标签为 i % 10，从归一化后的图像就能认出样本
+    IDXDataset make_dataset()
+    {
+        std::vector<uint8_t> pixels, labels;
+        for (uint32_t i = 0; i < kCount; ++i)
+        {
+            pixels.insert(pixels.end(), kPixels, (uint8_t)i);
+            labels.push_back(i % 10);
+        }
+        idx_files::write(kImages, kLabels, kCount, 2, 3, pixels, labels);
+        return IDXDataset(kImages, kLabels);
+    }
+
+    // 读完一个 epoch，返回按顺序出现的样本编号，同时检查 batch 的元数据和内容
+    std::vector<int> read_epoch(DataLoader &loader, const DataLoaderOptions &options, size_t epoch)
+    {
+        std::vector<int> samples;
+        size_t index = 0;
+        while (const DataBatch *batch = loader.next())
+        {
+            CHECK(batch->epoch == epoch && batch->index == index);
+            CHECK(batch->size == batch->labels.size() && (size_t)batch->images.shape()[0] == batch->size);
+            CHECK(batch->size == options.batch_size || index + 1 == loader.batches_per_epoch());
+            CHECK(!batch->images.requires_grad());
+            CHECK(batch->tensors.size() == (options.scalar_tensors ? batch->size : 0));
+            for (size_t r = 0; r < batch->size; ++r)
+            {
+                int sample = (int)std::lround(batch->images.value(r * kPixels) * 255.0f);
+                for (size_t p = 1; p < kPixels; ++p)
+                {
+                    CHECK(batch->images.value(r * kPixels + p) == batch->images.value(r * kPixels));
+                }
+                CHECK(batch->labels[r] == sample % 10);
+                if (options.scalar_tensors)
+                {
+                    CHECK(batch->tensors[r][0].value() == batch->images.value(r * kPixels));
+                }
+                samples.push_back(sample);
+            }
+            ++index;
+        }
+        CHECK(index == loader.batches_per_epoch());
+        CHECK(loader.epoch() == epoch + 1);
+        return samples;
+    }
+}
+
+// 每个 epoch 恰好覆盖所有样本一次；顺序只由种子决定，与工作线程数无关；每个 epoch 的顺序不同
+static void complete_and_deterministic()
+{
+    IDXDataset data = make_dataset();
+    DataLoaderOptions options;
+    options.batch_size = 4;
+    options.seed = 123;
+    options.prefetch = 3;
+
+    std::vector<std::vector<int>> orders[2];
+    for (size_t workers : {1, 3})
+    {
+        options.num_workers = workers;
+        options.scalar_tensors = workers == 3;
+        DataLoader loader(data, options);
+        CHECK(loader.batches_per_epoch() == 3);
+        for (size_t epoch = 0; epoch < 3; ++epoch)
+        {
+            std::vector<int> samples = read_epoch(loader, options, epoch);
+            std::vector<bool> seen(kCount, false);
+            for (int s : samples)
+            {
+                CHECK(s >= 0 && s < (int)kCount && !seen[s]);
+                seen[s] = true;
+            }
+            CHECK(samples.size() == kCount);
+            orders[workers == 3].push_back(samples);
+        }
+    }
+    CHECK(orders[0] == orders[1]);
+    CHECK(orders[0][0] != orders[0][1] || orders[0][1] != orders[0][2]);
+}
+
+// 不打乱时按文件顺序；drop_last 丢弃每个 epoch 末尾不满的 batch
+static void sequential_and_drop_last()
+{
+    IDXDataset data = make_dataset();
+    DataLoaderOptions options;
+    options.batch_size = 4;
+    options.shuffle = false;
+    options.num_workers = 2;
+    {
+        DataLoader loader(data, options);
+        std::vector<int> samples = read_epoch(loader, options, 0);
+        for (int i = 0; i < (int)kCount; ++i)
+        {
+            CHECK(samples[i] == i);
+        }
+    }
+
+    options.drop_last = true;
+    DataLoader loader(data, options);
+    CHECK(loader.batches_per_epoch() == 2);
+    for (size_t epoch = 0; epoch < 2; ++epoch)
+    {
+        CHECK(read_epoch(loader, options, epoch).size() == 8);
+    }
+}
+
+int main()
+{
+    complete_and_deterministic();
+    sequential_and_drop_last();
+    return check::result();
+}
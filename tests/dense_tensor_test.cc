@@ -0,0 +1,88 @@
+#include "dense_tensor.h"
+#include "check.h"
+#include <stdexcept>
+
+using namespace cctorch;
+
+// 越界的标签在建立节点之前就被拒绝，logits 的引用计数不变，之后的反向照常进行
+static void cross_entropy_rejects_bad_targets()
+{
+    DenseTensor w({2, 3}, {0.1f, 0.2f, 0.3f, -0.1f, 0.0f, 0.4f});
+    DenseTensor x({2, 2}, {1, 2, 3, 4});
+    DenseTensor logits = x.matmul(w);
+    unsigned int sons = logits.data->sons;
+    CHECK_THROWS(logits.cross_entropy({0, 3}), std::out_of_range);
+    CHECK(logits.data->sons == sons);
+
+    DenseTensor loss = logits.cross_entropy({0, 2});
+    loss.backward();
+    bool reached = false;
+    for (size_t i = 0; i < w.numel(); ++i)
+    {
+        reached = reached || w.grad(i) != 0.0f;
+    }
+    CHECK(reached);
+}
+
+// 融合的 linear 与 matmul + 加偏置给出相同的梯度，叶子输入也有 dX
+static void linear_matches_matmul()
+{
+    std::vector<float> xv = {1, -2, 0.5f, 3, 0, -1};
+    std::vector<float> wv = {0.2f, -0.4f, 0.1f, 0.3f, -0.5f, 0.6f};
+    std::vector<float> bv = {0.05f, -0.05f};
+
+    DenseTensor x1({2, 3}, xv), w1({3, 2}, wv), b1({2}, bv);
+    x1.linear(w1, b1).exp().sum().backward();
+
+    DenseTensor x2({2, 3}, xv), w2({3, 2}, wv), b2({2}, bv);
+    (x2.matmul(w2) + b2).exp().sum().backward();
+
+    for (size_t i = 0; i < x1.numel(); ++i)
+    {
+        CHECK_NEAR(x1.grad(i), x2.grad(i), 1e-5);
+    }
+    CHECK(x1.grad(0) != 0.0f);
+    for (size_t i = 0; i < w1.numel(); ++i)
+    {
+        CHECK_NEAR(w1.grad(i), w2.grad(i), 1e-5);
+    }
+    for (size_t i = 0; i < b1.numel(); ++i)
+    {
+        CHECK_NEAR(b1.grad(i), b2.grad(i), 1e-5);
+    }
+}
+
+// requires_grad = false 的输入没有梯度缓冲区，权重和偏置的梯度不受影响
+static void input_without_grad()
+{
+    std::vector<float> xv = {1, -2, 0.5f, 3, 0, -1};
+    DenseTensor x1({2, 3}, xv, false), w1({3, 2}, 0.3f), b1({2}, 0.1f);
+    CHECK(!x1.requires_grad() && w1.requires_grad());
+    x1.linear(w1, b1).exp().sum().backward();
+    CHECK(x1.grad_ptr() == nullptr);
+
+    DenseTensor x2({2, 3}, xv), w2({3, 2}, 0.3f), b2({2}, 0.1f);
+    x2.linear(w2, b2).exp().sum().backward();
+    for (size_t i = 0; i < w1.numel(); ++i)
+    {
+        CHECK(w1.grad(i) == w2.grad(i));
+    }
+    for (size_t i = 0; i < b1.numel(); ++i)
+    {
+        CHECK(b1.grad(i) == b2.grad(i));
+    }
+
+    // 由它转换精度得到的副本同样不需要 dX
+    AutocastGuard autocast(Precision::BF16);
+    DenseTensor x3({2, 3}, xv, false);
+    x3.to(Precision::BF16).linear(w1, b1).sum().backward();
+    CHECK(x3.grad_ptr() == nullptr);
+}
+
+int main()
+{
+    linear_matches_matmul();
+    input_without_grad();
+    cross_entropy_rejects_bad_targets();
+    return check::result();
+}
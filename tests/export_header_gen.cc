@@ -0,0 +1,29 @@
+#include "checkpoint.h"
+#include "header_export.h"
+#include "export_mlp.h"
+#include <iostream>
+
+// 构建时运行：把随机初始化的 ExportMLP 保存为检查点，再导出成头文件（命名空间 exported_mlp）
+//     export_header_gen <checkpoint.bin> <header.h>
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <checkpoint.bin> <header.h>" << std::endl;
+        return 1;
+    }
+    try
+    {
+        ExportMLP mlp;
+        mlp.save(argv[1]);
+        cctorch::HeaderExportOptions options;
+        options.name = "exported_mlp";
+        cctorch::export_header(cctorch::Checkpoint(argv[1]), argv[2], options);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Export failed: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
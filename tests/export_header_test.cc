@@ -0,0 +1,45 @@
+#include "dense_tensor.h"
+#include "export_mlp.h"
+#include "check.h"
+#include EXPORTED_MODEL_HEADER
+#include <cstdlib>
+
+static_assert(exported_mlp::in_features == ExportMLP::in_features && exported_mlp::out_features == ExportMLP::out_features,
+              "exported header does not match ExportMLP");
+
+// 导出的 infer() 与从同一个检查点加载的模型的 Model::forward 输出一致
+int main()
+{
+    ExportMLP mlp;
+    mlp.load(EXPORTED_MODEL_CHECKPOINT);
+
+    const int rows = 64;
+    const int in = ExportMLP::in_features, out = ExportMLP::out_features;
+    cctorch::DenseTensor inputs({rows, in});
+    std::srand(7);
+    for (size_t i = 0; i < inputs.numel(); ++i)
+    {
+        inputs.value_ptr()[i] = static_cast<float>(std::rand()) / RAND_MAX * 2.0f - 1.0f;
+    }
+    cctorch::DenseTensor reference;
+    {
+        cctorch::NoGradGuard no_grad;
+        cctorch::Model &model = mlp;
+        reference = model.forward(inputs);
+    }
+
+    float scores[exported_mlp::out_features];
+    bool nonzero = false;
+    for (int r = 0; r < rows; ++r)
+    {
+        exported_mlp::infer(inputs.value_ptr() + static_cast<size_t>(r) * in, scores);
+        for (int j = 0; j < out; ++j)
+        {
+            // 两边的累加顺序不同（GEMM 分块），只允许舍入误差
+            CHECK_NEAR(scores[j], reference.value(static_cast<size_t>(r) * out + j), 1e-5);
+            nonzero = nonzero || scores[j] != 0.0f;
+        }
+    }
+    CHECK(nonzero);
+    return check::result();
+}
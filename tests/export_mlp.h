@@ -0,0 +1,13 @@
+#ifndef CCTORCH_TESTS_EXPORT_MLP_H
+#define CCTORCH_TESTS_EXPORT_MLP_H
+
+#include "sequential.h"
+
+// export_header_gen 导出、export_header_test 对比的小模型
+using ExportMLP = cctorch::fixed::Sequential<cctorch::fixed::Linear<20, 16>,
+                                             cctorch::fixed::ReLU,
+                                             cctorch::fixed::Linear<16, 12>,
+                                             cctorch::fixed::ReLU,
+                                             cctorch::fixed::Linear<12, 5>>;
+
+#endif // CCTORCH_TESTS_EXPORT_MLP_H
@@ -0,0 +1,86 @@
+#include "graph_arena.h"
+#include "tensor.h"
+#include "check.h"
+#include <vector>
+
+using namespace cctorch;
+
+namespace
+{
+    // 一个小的标量计算图：loss = sum((w * x_i + b)^2)，反向后返回 w、b 的梯度
+    float step(Tensor &w, Tensor &b, Tensor *kept = nullptr)
+    {
+        w.zero_grad();
+        b.zero_grad();
+        Tensor loss(0.0f);
+        for (int i = 0; i < 100; ++i)
+        {
+            Tensor y = w * Tensor(0.01f * i) + b;
+            loss = loss + y * y;
+        }
+        loss.backward();
+        if (kept)
+        {
+            *kept = loss;
+        }
+        return loss.value();
+    }
+}
+
+// arena 中的节点与堆上的节点给出相同的结果；每轮结束后块被收回，之后的轮次复用同样的块
+static void arena_reuses_blocks()
+{
+    Tensor w(0.5f), b(-0.25f);
+    float heap_loss = step(w, b);
+    float heap_dw = w.grad(), heap_db = b.grad();
+
+    GraphArena arena;
+    size_t reserved = 0, used = 0;
+    for (int iter = 0; iter < 10; ++iter)
+    {
+        GraphArena::Scope scope(arena);
+        CHECK(GraphArena::current() == &arena);
+        CHECK(step(w, b) == heap_loss);
+        CHECK(w.grad() == heap_dw && b.grad() == heap_db);
+        used = arena.bytes_used();
+        CHECK(used > sizeof(tensor_data) * 100);
+        if (iter == 0)
+        {
+            reserved = arena.bytes_reserved();
+        }
+        CHECK(arena.bytes_reserved() == reserved);
+    }
+    CHECK(GraphArena::current() == nullptr);
+    CHECK(arena.bytes_used() < used);
+    CHECK(arena.bytes_reserved() == reserved);
+}
+
+// Scope 结束时仍存活的节点保持有效，它所在的块不再复用，由最后一个节点释放
+static void live_nodes_outlive_scope()
+{
+    Tensor w(0.5f), b(-0.25f);
+    GraphArena arena;
+    Tensor kept;
+    float expected;
+    {
+        GraphArena::Scope scope(arena);
+        expected = step(w, b, &kept);
+    }
+    CHECK(arena.bytes_reserved() == 0);
+    CHECK(kept.value() == expected);
+
+    {
+        GraphArena::Scope scope(arena);
+        step(w, b);
+    }
+    CHECK(kept.value() == expected);
+    CHECK(arena.bytes_reserved() > 0);
+    kept = Tensor();
+}
+
+int main()
+{
+    arena_reuses_blocks();
+    live_nodes_outlive_scope();
+    return check::result();
+}
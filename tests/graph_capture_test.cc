@@ -0,0 +1,152 @@
+#include "graph_capture.h"
+#include "layer.h"
+#include "check.h"
+#include <algorithm>
+#include <vector>
+
+using namespace cctorch;
+
+namespace
+{
+    constexpr int kBatch = 4;
+    constexpr int kIn = 5;
+    constexpr int kHidden = 6;
+    constexpr int kOut = 3;
+
+    // 两层网络；relu 关闭时 forward 走另一条分支（控制流变化）
+    class TwoLayer : public Model
+    {
+    public:
+        Linear first{kIn, kHidden};
+        Linear second{kHidden, kOut};
+        bool relu = true;
+
+        std::vector<Tensor> forward(const std::vector<Tensor> &input) override { return second.forward(first.forward(input)); }
+
+        DenseTensor forward(const DenseTensor &input) override
+        {
+            DenseTensor h = relu ? input.linear_relu(first.weight, first.bias) : input.linear(first.weight, first.bias);
+            return h.linear(second.weight, second.bias);
+        }
+
+        std::vector<DenseTensor> dense_parameters() override
+        {
+            return {first.weight, first.bias, second.weight, second.bias};
+        }
+    };
+
+    void copy_parameters(TwoLayer &from, TwoLayer &to)
+    {
+        std::vector<DenseTensor> src = from.dense_parameters(), dst = to.dense_parameters();
+        for (size_t i = 0; i < src.size(); ++i)
+        {
+            std::copy(src[i].value_ptr(), src[i].value_ptr() + src[i].numel(), dst[i].value_ptr());
+        }
+    }
+
+    DenseTensor batch(int step, int rows = kBatch)
+    {
+        std::vector<float> x;
+        for (int i = 0; i < rows * kIn; ++i)
+        {
+            x.push_back(0.1f * ((i * 3 + step * 7) % 11) - 0.5f);
+        }
+        return DenseTensor({rows, kIn}, x, false);
+    }
+
+    std::vector<unsigned char> labels(int step, int rows = kBatch)
+    {
+        std::vector<unsigned char> y;
+        for (int i = 0; i < rows; ++i)
+        {
+            y.push_back((i + step) % kOut);
+        }
+        return y;
+    }
+
+    std::vector<float> grads_of(TwoLayer &model)
+    {
+        std::vector<float> g;
+        for (DenseTensor &p : model.dense_parameters())
+        {
+            g.insert(g.end(), p.grad_ptr(), p.grad_ptr() + p.numel());
+            p.zero_grad();
+        }
+        return g;
+    }
+
+    float eager_step(TwoLayer &model, CrossEntropyLoss &criterion, const DenseTensor &x, const std::vector<unsigned char> &y)
+    {
+        DenseTensor loss = criterion(model(x), y);
+        loss.backward();
+        return loss.item();
+    }
+}
+
+// 重放与 eager 每一步给出相同的损失和梯度；形状不同的 batch 退回 eager，计划保留
+static void replay_matches_eager()
+{
+    TwoLayer captured_model, eager_model;
+    copy_parameters(captured_model, eager_model);
+    CrossEntropyLoss criterion;
+    GraphCapture capture(captured_model, criterion, 0);
+
+    for (int step = 0; step < 5; ++step)
+    {
+        int rows = step == 3 ? kBatch - 1 : kBatch;
+        float replayed = capture(batch(step, rows), labels(step, rows));
+        float expected = eager_step(eager_model, criterion, batch(step, rows), labels(step, rows));
+        CHECK_NEAR(replayed, expected, 1e-6);
+        std::vector<float> a = grads_of(captured_model), b = grads_of(eager_model);
+        for (size_t i = 0; i < a.size(); ++i)
+        {
+            CHECK_NEAR(a[i], b[i], 1e-5);
+        }
+    }
+    CHECK(capture.captures() == 1);
+    CHECK(capture.replays() == 3);
+    CHECK(capture.eager_steps() == 1);
+}
+
+// 替换参数张量后下一步就重新捕获，即使从不重新记录前向
+static void replaced_parameter_invalidates()
+{
+    TwoLayer model, reference;
+    CrossEntropyLoss criterion;
+    GraphCapture capture(model, criterion, 0);
+    capture(batch(0), labels(0));
+    capture(batch(1), labels(1));
+
+    model.second.weight = DenseTensor({kHidden, kOut}, 0.25f);
+    copy_parameters(model, reference);
+    grads_of(model);
+    float loss = capture(batch(2), labels(2));
+    CHECK(capture.captures() == 2);
+    CHECK_NEAR(loss, eager_step(reference, criterion, batch(2), labels(2)), 1e-6);
+}
+
+// 控制流的变化只在重新记录前向时发现：间隔为 1 时下一步就重新捕获
+static void control_flow_change_detected()
+{
+    TwoLayer model, reference;
+    copy_parameters(model, reference);
+    CrossEntropyLoss criterion;
+    GraphCapture capture(model, criterion, 1);
+    capture(batch(0), labels(0));
+    capture(batch(1), labels(1));
+    CHECK(capture.captures() == 1);
+
+    model.relu = reference.relu = false;
+    grads_of(model);
+    float loss = capture(batch(2), labels(2));
+    CHECK(capture.captures() == 2);
+    CHECK_NEAR(loss, eager_step(reference, criterion, batch(2), labels(2)), 1e-6);
+}
+
+int main()
+{
+    replay_matches_eager();
+    replaced_parameter_invalidates();
+    control_flow_change_detected();
+    return check::result();
+}
@@ -0,0 +1,154 @@
+#include "idx_dataset.h"
+#include "check.h"
+#include "idx_files.h"
+#include "simd.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace cctorch;
+
+namespace
+{
+    const std::string kImages = "idx_test_images";
+    const std::string kLabels = "idx_test_labels";
+
+    void write_idx(uint32_t count, uint32_t rows, uint32_t cols, const std::vector<uint8_t> &pixels, const std::vector<uint8_t> &labels)
+    {
+        idx_files::write(kImages, kLabels, count, rows, cols, pixels, labels);
+    }
+
+    std::vector<uint8_t> sample_pixels(size_t n)
+    {
+        std::vector<uint8_t> pixels(n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            pixels[i] = (uint8_t)(i * 7 + 3);
+        }
+        return pixels;
+    }
+}
+
+// 映射后的整块数据与文件内容相同；shuffle 只打乱编号，batch 是编号区间上的视图
+static void mapped_and_shuffled()
+{
+    const uint32_t count = 10, rows = 3, cols = 4;
+    std::vector<uint8_t> pixels = sample_pixels(count * rows * cols);
+    std::vector<uint8_t> labels;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        labels.push_back(i % 10);
+    }
+    write_idx(count, rows, cols, pixels, labels);
+
+    IDXDataset data(kImages, kLabels);
+    CHECK(data.size() == count && data.rows() == (int)rows && data.cols() == (int)cols);
+    CHECK(std::equal(pixels.begin(), pixels.end(), data.pixels()));
+    CHECK(std::equal(labels.begin(), labels.end(), data.labels()));
+    CHECK(data.image(4) == data.pixels() + 4 * data.image_size() && data.label(4) == 4);
+
+    data.shuffle(42);
+    std::vector<uint32_t> first = data.indices();
+    std::vector<uint32_t> sorted = first;
+    std::sort(sorted.begin(), sorted.end());
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        CHECK(sorted[i] == i);
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        CHECK(data.image(i) == data.pixels() + first[i] * data.image_size());
+        CHECK(data.label(i) == labels[first[i]]);
+    }
+    data.shuffle(7);
+    data.shuffle(42);
+    IDXDataset same(kImages, kLabels);
+    same.shuffle(42);
+    CHECK(same.indices() == first);
+
+    CHECK(data.num_batches(4) == 3 && data.num_batches(4, true) == 2);
+    IDXBatch tail = data.batch(8, 4);
+    CHECK(tail.size == 2 && tail.indices == data.indices().data() + 8);
+    CHECK(tail.image(1) == data.image(9) && tail.label(1) == data.label(9));
+    CHECK(data.batch(count, 4).size == 0);
+}
+
+// 头部的数字与文件大小不符时在建立视图之前拒绝，乘积溢出也不会绕过检查
+static void bad_headers_rejected()
+{
+    std::vector<uint8_t> labels(4, 1);
+    write_idx(4, 2, 2, sample_pixels(15), labels); // 少一个像素
+    CHECK_THROWS(IDXDataset(kImages, kLabels), std::runtime_error);
+
+    write_idx(4, 65536, 65536, sample_pixels(16), labels); // rows * cols 在 32 位下溢出为 0
+    CHECK_THROWS(IDXDataset(kImages, kLabels), std::runtime_error);
+
+    write_idx(4, 0, 2, sample_pixels(16), labels);
+    CHECK_THROWS(IDXDataset(kImages, kLabels), std::runtime_error);
+
+    write_idx(4, 0x80000000u, 1, sample_pixels(16), labels);
+    CHECK_THROWS(IDXDataset(kImages, kLabels), std::runtime_error);
+
+    write_idx(5, 2, 2, sample_pixels(20), labels); // 标签个数不一致
+    CHECK_THROWS(IDXDataset(kImages, kLabels), std::runtime_error);
+}
+
+// normalize_pixels（支持时为 AVX2 内核）与标量公式一致：覆盖 32 宽、8 宽循环和每种尾部长度，
+// 源地址不对齐，且不写出 dst[n] 之后
+static void normalize_matches_scalar()
+{
+    std::vector<uint8_t> src(3 + 100);
+    for (size_t i = 0; i < src.size(); ++i)
+    {
+        src[i] = (uint8_t)(i * 61 + 17);
+    }
+    const float sentinel = -12345.0f;
+    for (float mean : {0.0f, 0.1307f})
+    {
+        float std = mean == 0.0f ? 1.0f : 0.3081f;
+        for (size_t offset = 0; offset < 3; ++offset)
+        {
+            for (size_t n = 0; n <= 100; ++n)
+            {
+                std::vector<float> dst(n + 1, sentinel);
+                normalize_pixels(src.data() + offset, dst.data(), n, mean, std);
+                for (size_t i = 0; i < n; ++i)
+                {
+                    float expected = (src[offset + i] / 255.0f - mean) / std;
+                    CHECK_NEAR(dst[i], expected, 1e-5 * (1.0f + std::fabs(expected)));
+                }
+                CHECK(dst[n] == sentinel);
+            }
+        }
+    }
+    std::vector<float> dst(4);
+    CHECK_THROWS(normalize_pixels(src.data(), dst.data(), 4, 0.0f, 0.0f), std::invalid_argument);
+
+    // batch 按行写入，每行等于单独归一化对应的图像
+    write_idx(4, 5, 7, sample_pixels(4 * 35), std::vector<uint8_t>(4, 0));
+    IDXDataset data(kImages, kLabels);
+    data.shuffle(3);
+    IDXBatch batch = data.batch(1, 3);
+    std::vector<float> rows(batch.size * batch.image_size), row(batch.image_size);
+    batch.normalize(rows.data(), 0.5f, 0.25f);
+    for (size_t r = 0; r < batch.size; ++r)
+    {
+        normalize_pixels(batch.image(r), row.data(), row.size(), 0.5f, 0.25f);
+        CHECK(std::equal(row.begin(), row.end(), rows.begin() + r * row.size()));
+    }
+}
+
+int main()
+{
+    mapped_and_shuffled();
+    bad_headers_rejected();
+    normalize_matches_scalar();
+    if (!cpu_has_avx2_fma())
+    {
+        std::cout << "note: no AVX2/FMA on this CPU, only the scalar kernel was exercised\n";
+    }
+    return check::result();
+}
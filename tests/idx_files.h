@@ -0,0 +1,35 @@
+#ifndef CCTORCH_TESTS_IDX_FILES_H
+#define CCTORCH_TESTS_IDX_FILES_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// 测试用的小 IDX 文件：头部的 count/rows/cols 可以与实际写入的像素个数不一致，用来构造损坏的文件
+namespace idx_files
+{
+    inline void put_be32(std::ofstream &out, uint32_t v)
+    {
+        const char bytes[4] = {(char)(v >> 24), (char)(v >> 16), (char)(v >> 8), (char)v};
+        out.write(bytes, 4);
+    }
+
+    inline void write(const std::string &images_file, const std::string &labels_file, uint32_t count, uint32_t rows, uint32_t cols,
+                      const std::vector<uint8_t> &pixels, const std::vector<uint8_t> &labels)
+    {
+        std::ofstream images(images_file, std::ios::binary);
+        put_be32(images, 2051);
+        put_be32(images, count);
+        put_be32(images, rows);
+        put_be32(images, cols);
+        images.write(reinterpret_cast<const char *>(pixels.data()), pixels.size());
+
+        std::ofstream label_out(labels_file, std::ios::binary);
+        put_be32(label_out, 2049);
+        put_be32(label_out, (uint32_t)labels.size());
+        label_out.write(reinterpret_cast<const char *>(labels.data()), labels.size());
+    }
+}
+
+#endif // CCTORCH_TESTS_IDX_FILES_H
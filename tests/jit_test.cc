@@ -0,0 +1,128 @@
+#include "jit.h"
+#include "check.h"
+#include <filesystem>
+#include <stdexcept>
+#include <vector>
+#include <sys/stat.h>
+
+using namespace cctorch;
+namespace fs = std::filesystem;
+
+namespace
+{
+    const fs::path cache_root = JIT_TEST_CACHE;
+
+    // 两层的小网络：out_j = sum_i relu(x_i * w_ij + b_j) * v_j，外加一个 exp/log/除法分支
+    std::vector<Tensor> network(const std::vector<Tensor> &x, const std::vector<Tensor> &w, const std::vector<Tensor> &b, const std::vector<Tensor> &v)
+    {
+        std::vector<Tensor> out;
+        for (size_t j = 0; j < b.size(); ++j)
+        {
+            Tensor acc(0.0f);
+            for (size_t i = 0; i < x.size(); ++i)
+            {
+                acc = acc + (x[i] * w[i * b.size() + j] + b[j]).relu() * v[j];
+            }
+            out.push_back(acc + (x[j] - b[j]).exp().log() / (v[j] * v[j] + Tensor(1.0f)));
+        }
+        return out;
+    }
+
+    std::vector<Tensor> leaves(size_t n, float scale)
+    {
+        std::vector<Tensor> t;
+        for (size_t i = 0; i < n; ++i)
+        {
+            t.push_back(Tensor(scale * ((float)((i * 5) % 7) - 3.0f)));
+        }
+        return t;
+    }
+
+    std::vector<float> grads(const std::vector<Tensor> &params)
+    {
+        std::vector<float> g;
+        for (const Tensor &p : params)
+        {
+            g.push_back(p.grad());
+        }
+        return g;
+    }
+}
+
+// 编译后的图与即时执行的图给出相同的输出和参数梯度；第二次构造直接使用缓存
+static void jit_matches_eager()
+{
+    JitOptions options;
+    options.cache_dir = (cache_root / "cache; touch injected").string(); // 目录名不会经过 shell
+    std::vector<Tensor> w = leaves(12, 0.1f), b = leaves(3, 0.05f), v = leaves(3, 0.2f);
+
+    std::vector<Tensor> x = leaves(4, 0.3f);
+    JitGraph jit(x, network(x, w, b, v), options);
+    CHECK(!fs::exists("injected") && !fs::exists(cache_root / "injected"));
+    CHECK((fs::status(options.cache_dir).permissions() & (fs::perms::group_all | fs::perms::others_all)) == fs::perms::none);
+
+    std::vector<float> input = {0.7f, -0.2f, 1.3f, 0.4f};
+    const std::vector<Tensor> &compiled = jit.forward(input);
+    for (const Tensor &out : compiled)
+    {
+        out.data->grad = 1.0f;
+    }
+    jit.backward();
+    std::vector<float> jit_grads = grads(w);
+
+    for (Tensor &p : w)
+    {
+        p.zero_grad();
+    }
+    std::vector<Tensor> fresh;
+    for (float value : input)
+    {
+        fresh.push_back(Tensor(value));
+    }
+    std::vector<Tensor> eager = network(fresh, w, b, v);
+    Tensor root = eager[0] + eager[1] + eager[2];
+    for (size_t k = 0; k < eager.size(); ++k)
+    {
+        CHECK_NEAR(compiled[k].value(), eager[k].value(), 1e-5);
+    }
+    root.backward();
+    std::vector<float> eager_grads = grads(w);
+    bool nonzero = false;
+    for (size_t i = 0; i < w.size(); ++i)
+    {
+        CHECK_NEAR(jit_grads[i], eager_grads[i], 1e-5);
+        nonzero = nonzero || eager_grads[i] != 0.0f;
+    }
+    CHECK(nonzero);
+
+    JitGraph cached(x, network(x, w, b, v), options);
+    CHECK(cached.from_cache() && cached.hash() == jit.hash());
+}
+
+// 其他用户可写的缓存目录被拒绝；编译器参数不经过 shell 解释
+static void unsafe_setups_rejected()
+{
+    std::vector<Tensor> x = leaves(2, 0.5f);
+    std::vector<Tensor> out = {(x[0] * x[1]).exp()};
+
+    fs::path shared = cache_root / "shared";
+    fs::create_directories(shared);
+    chmod(shared.c_str(), 0777);
+    JitOptions options;
+    options.cache_dir = shared.string();
+    CHECK_THROWS(JitGraph(x, out, options), std::runtime_error);
+
+    options.cache_dir = (cache_root / "private").string();
+    options.compiler = "c++;touch";
+    options.flags = "injected -shared";
+    CHECK_THROWS(JitGraph(x, out, options), std::runtime_error);
+    CHECK(!fs::exists("injected"));
+}
+
+int main()
+{
+    fs::remove_all(cache_root);
+    jit_matches_eager();
+    unsafe_setups_rejected();
+    return check::result();
+}
@@ -0,0 +1,214 @@
+#include "layer.h"
+#include "loss.h"
+#include "optimizer.h"
+#include "graph_capture.h"
+#include "thread_pool.h"
+#include "check.h"
+#include <algorithm>
+#include <vector>
+
+using namespace cctorch;
+
+namespace
+{
+    constexpr int kBatch = 5;
+    constexpr int kIn = 6;
+    constexpr int kOut = 4;
+
+    std::vector<float> batch_values()
+    {
+        std::vector<float> x;
+        for (int i = 0; i < kBatch * kIn; ++i)
+        {
+            x.push_back(0.1f * ((i * 7) % 13) - 0.6f);
+        }
+        return x;
+    }
+
+    std::vector<unsigned char> batch_labels()
+    {
+        std::vector<unsigned char> labels;
+        for (int s = 0; s < kBatch; ++s)
+        {
+            labels.push_back(s % kOut);
+        }
+        return labels;
+    }
+
+    std::vector<std::vector<Tensor>> scalar_batch(const std::vector<float> &x)
+    {
+        std::vector<std::vector<Tensor>> inputs;
+        for (int s = 0; s < kBatch; ++s)
+        {
+            inputs.push_back(to_tensor(std::vector<float>(x.begin() + s * kIn, x.begin() + (s + 1) * kIn)));
+        }
+        return inputs;
+    }
+
+    std::vector<float> grads_of(Linear &model)
+    {
+        std::vector<float> grads;
+        for (DenseTensor &p : model.dense_parameters())
+        {
+            p.merge_view_grad();
+            grads.insert(grads.end(), p.grad_ptr(), p.grad_ptr() + p.numel());
+        }
+        return grads;
+    }
+
+    void zero_grads(Linear &model)
+    {
+        for (DenseTensor &p : model.dense_parameters())
+        {
+            p.zero_grad();
+        }
+    }
+}
+
+// 批量前向（一次 GEMM）与逐元素的标量前向给出相同的输出和参数梯度
+static void dense_matches_scalar()
+{
+    Linear model(kIn, kOut);
+    std::vector<float> x = batch_values();
+    std::vector<unsigned char> labels = batch_labels();
+    CrossEntropyLoss criterion;
+
+    zero_grads(model);
+    DenseTensor logits = model(DenseTensor({kBatch, kIn}, x));
+    criterion(logits, labels).backward();
+    std::vector<float> dense = grads_of(model);
+
+    zero_grads(model);
+    std::vector<std::vector<Tensor>> outputs = model(scalar_batch(x));
+    criterion(outputs, labels).backward();
+    std::vector<float> scalar = grads_of(model);
+
+    for (int s = 0; s < kBatch; ++s)
+    {
+        for (int j = 0; j < kOut; ++j)
+        {
+            CHECK_NEAR(outputs[s][j].value(), logits.value(s * kOut + j), 1e-5);
+        }
+    }
+    CHECK(dense.size() == (size_t)kIn * kOut + kOut && scalar.size() == dense.size());
+    bool nonzero = false;
+    for (size_t i = 0; i < dense.size(); ++i)
+    {
+        CHECK_NEAR(scalar[i], dense[i], 1e-5);
+        nonzero = nonzero || dense[i] != 0.0f;
+    }
+    CHECK(nonzero);
+
+    // 推理模式的标量前向直接读连续参数
+    NoGradGuard no_grad;
+    std::vector<Tensor> first = model.forward(scalar_batch(x)[0]);
+    for (int j = 0; j < kOut; ++j)
+    {
+        CHECK_NEAR(first[j].value(), logits.value(j), 1e-5);
+    }
+}
+
+// 优化器原地更新参数缓冲区，标量视图随之刷新；标量路径累加在视图上的梯度也参与更新
+static void optimizer_updates_in_place()
+{
+    Linear model(kIn, kOut);
+    const float *weights = model.weight.value_ptr();
+    std::vector<float> before(weights, weights + model.weight.numel());
+    const std::vector<Tensor> &view = model.weight.scalar_view();
+
+    SGD optimizer(model.parameters(), 0.1f);
+    optimizer.set_multi_tensor(true);
+    optimizer.zero_grad();
+    CrossEntropyLoss criterion;
+    criterion(model(scalar_batch(batch_values())), batch_labels()).backward();
+    std::vector<float> grads(view.size());
+    for (size_t i = 0; i < view.size(); ++i)
+    {
+        grads[i] = view[i].grad();
+    }
+    optimizer.step();
+
+    CHECK(model.weight.value_ptr() == weights);
+    for (size_t i = 0; i < view.size(); ++i)
+    {
+        CHECK_NEAR(model.weight.value(i), before[i] - 0.1f * grads[i], 1e-6);
+        CHECK(view[i].value() == model.weight.value(i));
+    }
+}
+
+// Adam 的标量循环、向量化内核和线程池切分给出相同的结果
+static void adam_modes_agree()
+{
+    ThreadPool pool(3);
+    std::vector<std::vector<float>> results;
+    for (int mode = 0; mode < 3; ++mode)
+    {
+        Linear model(kIn, kOut);
+        std::vector<float> start(model.weight.numel());
+        for (size_t i = 0; i < start.size(); ++i)
+        {
+            start[i] = 0.01f * (float)i - 0.1f;
+        }
+        std::copy(start.begin(), start.end(), model.weight.value_ptr());
+
+        Adam optimizer(model.dense_parameters(), 0.01f, 0.9f, 0.999f, 1e-8f, 0.01f);
+        CHECK(optimizer.numel() == (size_t)kIn * kOut + kOut);
+        if (mode > 0)
+        {
+            optimizer.set_multi_tensor(true, mode == 2 ? &pool : nullptr);
+        }
+        CrossEntropyLoss criterion;
+        for (int step = 0; step < 3; ++step)
+        {
+            optimizer.zero_grad();
+            criterion(model(DenseTensor({kBatch, kIn}, batch_values())), batch_labels()).backward();
+            optimizer.step();
+        }
+        results.push_back(std::vector<float>(model.weight.value_ptr(), model.weight.value_ptr() + model.weight.numel()));
+    }
+    for (size_t i = 0; i < results[0].size(); ++i)
+    {
+        CHECK_NEAR(results[1][i], results[0][i], 1e-5);
+        CHECK(results[2][i] == results[1][i]);
+    }
+}
+
+// 重放计划时参数梯度和 eager 一样累加，不会被清零
+static void graph_capture_accumulates()
+{
+    Linear model(kIn, kOut);
+    CrossEntropyLoss criterion;
+    DenseTensor x({kBatch, kIn}, batch_values());
+
+    zero_grads(model);
+    criterion(model(x), batch_labels()).backward();
+    std::vector<float> once = grads_of(model);
+
+    GraphCapture capture(model, criterion);
+    zero_grads(model);
+    capture(x, batch_labels());
+    capture(x, batch_labels());
+    CHECK(capture.replays() == 1);
+    std::vector<float> twice = grads_of(model);
+    for (size_t i = 0; i < once.size(); ++i)
+    {
+        CHECK_NEAR(twice[i], 2 * once[i], 1e-5);
+    }
+
+    // 替换参数张量后重新捕获
+    GraphCapture verify(model, criterion, 1);
+    verify(x, batch_labels());
+    model.weight = DenseTensor({kIn, kOut}, 0.5f);
+    verify(x, batch_labels());
+    verify(x, batch_labels());
+    CHECK(verify.captures() == 2);
+}
+
+int main()
+{
+    dense_matches_scalar();
+    optimizer_updates_in_place();
+    adam_modes_agree();
+    graph_capture_accumulates();
+    return check::result();
+}
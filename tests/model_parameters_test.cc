@@ -0,0 +1,102 @@
+#include "layer.h"
+#include "loss.h"
+#include "optimizer.h"
+#include "check.h"
+#include <vector>
+
+using namespace cctorch;
+
+namespace
+{
+    // 只实现旧接口 parameters() 的组合模型（升级前的写法）
+    class LegacyMLP : public Model
+    {
+    public:
+        Linear linear1{3, 4};
+        ReLU relu;
+        Linear linear2{4, 2};
+
+        std::vector<Tensor> forward(const std::vector<Tensor> &input) override
+        {
+            return linear2(relu(linear1(input)));
+        }
+
+        std::vector<Tensor> parameters() override
+        {
+            std::vector<Tensor> params;
+            auto p1 = linear1.parameters();
+            auto p2 = linear2.parameters();
+            params.insert(params.end(), p1.begin(), p1.end());
+            params.insert(params.end(), p2.begin(), p2.end());
+            return params;
+        }
+    };
+
+    // 两个接口都没有实现
+    class EmptyModel : public Model
+    {
+    public:
+        std::vector<Tensor> forward(const std::vector<Tensor> &input) override { return input; }
+    };
+}
+
+// 旧接口返回的标量参数映射回各层的连续参数，不会复制出一份新的缓冲区
+static void legacy_parameters_map_to_layers()
+{
+    LegacyMLP model;
+    std::vector<DenseTensor> params = model.dense_parameters();
+    CHECK(params.size() == 4);
+    CHECK(params[0].value_ptr() == model.linear1.weight.value_ptr());
+    CHECK(params[1].value_ptr() == model.linear1.bias.value_ptr());
+    CHECK(params[2].value_ptr() == model.linear2.weight.value_ptr());
+    CHECK(params[3].value_ptr() == model.linear2.bias.value_ptr());
+
+    // 不属于任何参数的标量 Tensor 收集成一个一维参数
+    std::vector<Tensor> mixed = model.linear2.parameters();
+    mixed.push_back(Tensor(1.5f));
+    mixed.push_back(Tensor(-2.0f));
+    std::vector<DenseTensor> converted = DenseTensor::from_parameters(mixed);
+    CHECK(converted.size() == 3);
+    CHECK(converted[2].numel() == 2);
+    CHECK(converted[2].value(1) == -2.0f);
+
+    CHECK_THROWS(EmptyModel().dense_parameters(), std::logic_error);
+}
+
+// 用旧接口构造的优化器更新的是层里的连续参数，批量前向随之变化
+static void legacy_model_trains()
+{
+    LegacyMLP model;
+    std::vector<float> before(model.linear1.weight.value_ptr(), model.linear1.weight.value_ptr() + model.linear1.weight.numel());
+    SGD optimizer(model.parameters(), 0.1f);
+    CHECK(optimizer.parameters.size() == 4);
+
+    CrossEntropyLoss criterion;
+    std::vector<std::vector<Tensor>> inputs = {to_tensor({0.5f, -0.2f, 0.8f}), to_tensor({-0.3f, 0.9f, 0.1f})};
+    std::vector<unsigned char> labels = {0, 1};
+    optimizer.zero_grad();
+    criterion(model(inputs), labels).backward();
+    optimizer.step();
+
+    bool changed = false;
+    for (size_t i = 0; i < before.size(); ++i)
+    {
+        changed = changed || model.linear1.weight.value(i) != before[i];
+    }
+    CHECK(changed);
+
+    // 标量路径和连续参数上的批量前向看到同一组数值
+    DenseTensor hidden = model.linear1(DenseTensor({1, 3}, {0.5f, -0.2f, 0.8f}));
+    std::vector<Tensor> scalar = model.linear1(inputs[0]);
+    for (int j = 0; j < 4; ++j)
+    {
+        CHECK_NEAR(scalar[j].value(), hidden.value(j), 1e-6);
+    }
+}
+
+int main()
+{
+    legacy_parameters_map_to_layers();
+    legacy_model_trains();
+    return check::result();
+}
@@ -0,0 +1,64 @@
+#include "dense_tensor.h"
+#include "check.h"
+
+using namespace cctorch;
+
+// NoGradGuard 作用域内算出的特征当作冻结的输入，之后在它上面接一个可训练的头
+static void frozen_features()
+{
+    DenseTensor x({2, 3}, {1, 2, 3, 4, 5, 6});
+    DenseTensor w({3, 4}, 0.5f);
+    DenseTensor head({4, 1}, 1.0f);
+
+    DenseTensor feat;
+    {
+        NoGradGuard g;
+        feat = x.matmul(w).relu();
+    }
+    CHECK(feat.data->back == DenseTensor::back_type::NONE);
+    CHECK(!feat.data->par1.data && !feat.data->par2.data);
+    CHECK(feat.grad_ptr() == nullptr);
+
+    DenseTensor loss = feat.matmul(head).sum();
+    loss.backward();
+
+    // feat 的每一行是 [3, 3, 3, 3] 和 [7.5, 7.5, 7.5, 7.5]
+    CHECK_NEAR(loss.item(), 42.0, 1e-6);
+    for (int i = 0; i < 4; ++i)
+    {
+        CHECK_NEAR(head.grad(i), 10.5, 1e-6);
+    }
+    // 截断处之前的参数收不到梯度
+    for (size_t i = 0; i < w.numel(); ++i)
+    {
+        CHECK(w.grad(i) == 0.0f);
+    }
+}
+
+// 冻结的输入同时作为 linear 和逐元素算子的父节点
+static void frozen_input_to_fused_ops()
+{
+    DenseTensor x({2, 2}, {1, -2, 3, 4});
+    DenseTensor w({2, 2}, {1, 0, 0, 1});
+    DenseTensor b({2}, {0.5f, -0.5f});
+
+    DenseTensor frozen;
+    {
+        NoGradGuard g;
+        frozen = x + x;
+    }
+    DenseTensor loss = (frozen.linear_relu(w, b) + frozen).exp().log().sum();
+    loss.backward();
+    // 只有 relu 后为正的位置把梯度传给 w 和 b：z = [[2.5, 0], [6.5, 7.5]]
+    CHECK_NEAR(b.grad(0), 2.0, 1e-6);
+    CHECK_NEAR(b.grad(1), 1.0, 1e-6);
+    CHECK_NEAR(w.grad(0), 2.0 + 6.0, 1e-6);
+    CHECK_NEAR(w.grad(3), 8.0, 1e-6);
+}
+
+int main()
+{
+    frozen_features();
+    frozen_input_to_fused_ops();
+    return check::result();
+}
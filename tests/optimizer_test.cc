@@ -0,0 +1,121 @@
+#include "optimizer.h"
+#include "simd.h"
+#include "thread_pool.h"
+#include "check.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+using namespace cctorch;
+
+namespace
+{
+    // 长度不是 8 的倍数，覆盖向量化内核的尾部
+    constexpr size_t kSize = 1003;
+
+    std::vector<float> sequence(size_t n, float scale, int seed)
+    {
+        std::vector<float> x(n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            x[i] = scale * ((float)((i * 37 + seed * 11) % 101) - 50.0f) / 50.0f;
+        }
+        return x;
+    }
+}
+
+// sgd_update（支持时为 AVX2 + FMA 内核）与逐元素的标量公式一致
+static void sgd_kernel_matches_scalar()
+{
+    std::vector<float> value = sequence(kSize, 1.0f, 1), grad = sequence(kSize, 0.5f, 2);
+    std::vector<float> expected = value;
+    float rate = 0.05f, decay = 0.999f;
+    for (size_t i = 0; i < kSize; ++i)
+    {
+        expected[i] = expected[i] * decay - rate * grad[i];
+    }
+    sgd_update(value.data(), grad.data(), kSize, rate, decay);
+    for (size_t i = 0; i < kSize; ++i)
+    {
+        CHECK_NEAR(value[i], expected[i], 1e-6);
+    }
+}
+
+// adam_update 连续几步与标量公式一致，包括一阶、二阶矩
+static void adam_kernel_matches_scalar()
+{
+    std::vector<float> value = sequence(kSize, 1.0f, 3), m(kSize, 0.0f), v(kSize, 0.0f);
+    std::vector<float> ref_value = value, ref_m = m, ref_v = v;
+    float lr = 0.01f, beta1 = 0.9f, beta2 = 0.999f, eps = 1e-8f;
+    for (int t = 1; t <= 3; ++t)
+    {
+        std::vector<float> grad = sequence(kSize, 0.3f, 10 + t);
+        adam_step_params p;
+        p.step_size = lr / (1 - std::pow(beta1, t));
+        p.beta1 = beta1;
+        p.beta2 = beta2;
+        p.inv_sqrt_bc2 = 1.0f / std::sqrt(1 - std::pow(beta2, t));
+        p.epsilon = eps;
+        p.decay = 1.0f - lr * 0.01f;
+        p.grad_scale = 0.5f;
+        adam_update(value.data(), grad.data(), m.data(), v.data(), kSize, p);
+        for (size_t i = 0; i < kSize; ++i)
+        {
+            float g = grad[i] * p.grad_scale;
+            ref_m[i] = beta1 * ref_m[i] + (1 - beta1) * g;
+            ref_v[i] = beta2 * ref_v[i] + (1 - beta2) * g * g;
+            ref_value[i] = ref_value[i] * p.decay - p.step_size * ref_m[i] / (std::sqrt(ref_v[i]) * p.inv_sqrt_bc2 + eps);
+        }
+    }
+    for (size_t i = 0; i < kSize; ++i)
+    {
+        CHECK_NEAR(m[i], ref_m[i], 1e-6);
+        CHECK_NEAR(v[i], ref_v[i], 1e-6);
+        CHECK_NEAR(value[i], ref_value[i], 1e-5);
+    }
+}
+
+// 标量循环、融合内核和线程池切分（参数大于 optimizer_grain，区间边界不是 8 的倍数）给出相同的参数
+template <class Optimizer, class... Args>
+static void modes_agree(Args... args)
+{
+    ThreadPool pool(3);
+    size_t n = optimizer_grain * 2 + 5;
+    std::vector<std::vector<float>> results;
+    for (int mode = 0; mode < 3; ++mode)
+    {
+        DenseTensor param({(int)n}, sequence(n, 1.0f, 4));
+        std::vector<float> grad = sequence(n, 0.2f, 5);
+        Optimizer optimizer(std::vector<DenseTensor>{param}, args...);
+        if (mode > 0)
+        {
+            optimizer.set_multi_tensor(true, mode == 2 ? &pool : nullptr);
+        }
+        for (int step = 0; step < 2; ++step)
+        {
+            optimizer.zero_grad();
+            std::copy(grad.begin(), grad.end(), param.grad_ptr());
+            optimizer.step();
+        }
+        results.emplace_back(param.value_ptr(), param.value_ptr() + n);
+    }
+    for (size_t i = 0; i < n; ++i)
+    {
+        CHECK_NEAR(results[1][i], results[0][i], 1e-5);
+        CHECK(results[2][i] == results[1][i]);
+    }
+}
+
+int main()
+{
+    sgd_kernel_matches_scalar();
+    adam_kernel_matches_scalar();
+    modes_agree<SGD>(0.1f, 0.01f);
+    modes_agree<Adam>(0.01f, 0.9f, 0.999f, 1e-8f, 0.01f);
+    if (!cpu_has_avx2_fma())
+    {
+        std::cout << "note: no AVX2/FMA on this CPU, only the scalar kernels were exercised\n";
+    }
+    return check::result();
+}
@@ -0,0 +1,138 @@
+#include "layer.h"
+#include "loss.h"
+#include "tape.h"
+#include "thread_pool.h"
+#include "check.h"
+#include <stdexcept>
+
+using namespace cctorch;
+
+namespace
+{
+    // 一次前向 + 反向，返回所有参数的梯度
+    std::vector<float> gradients(Linear &model, ThreadPool *pool, bool use_tape)
+    {
+        std::vector<std::vector<Tensor>> inputs;
+        std::vector<unsigned char> labels;
+        for (int s = 0; s < 16; ++s)
+        {
+            std::vector<float> x;
+            for (int f = 0; f < 5; ++f)
+            {
+                x.push_back(0.1f * ((s * 7 + f * 3) % 11) - 0.5f);
+            }
+            inputs.push_back(to_tensor(x));
+            labels.push_back(s % 3);
+        }
+
+        for (DenseTensor &p : model.dense_parameters())
+        {
+            p.zero_grad();
+        }
+        model.set_thread_pool(pool);
+        CrossEntropyLoss criterion;
+        Tape tape;
+        if (use_tape)
+        {
+            Tape::Scope scope(tape);
+            criterion(model(inputs), labels).backward();
+            CHECK(tape.size() > 0);
+        }
+        else
+        {
+            criterion(model(inputs), labels).backward();
+        }
+        model.set_thread_pool(nullptr);
+
+        // 标量路径的梯度在参数的标量视图上，合并回连续的梯度缓冲区后读取
+        std::vector<float> grads;
+        for (DenseTensor &p : model.dense_parameters())
+        {
+            p.merge_view_grad();
+            grads.insert(grads.end(), p.grad_ptr(), p.grad_ptr() + p.numel());
+        }
+        return grads;
+    }
+}
+
+namespace
+{
+    // 第 3 个样本的前向抛出异常
+    class FailingModel : public Model
+    {
+    public:
+        Linear inner{5, 3};
+
+        std::vector<Tensor> forward(const std::vector<Tensor> &input) override
+        {
+            if (input[0].value() == 3.0f)
+            {
+                throw std::runtime_error("bad sample");
+            }
+            return inner.forward(input);
+        }
+
+        std::vector<DenseTensor> dense_parameters() override { return inner.dense_parameters(); }
+    };
+}
+
+// 工作线程里 forward() 抛出的异常在调用线程重新抛出，tape 上不留下不完整的记录
+static void forward_exception_rethrown()
+{
+    FailingModel model;
+    ThreadPool pool(4);
+    model.set_thread_pool(&pool);
+    std::vector<std::vector<Tensor>> inputs;
+    for (int s = 0; s < 8; ++s)
+    {
+        inputs.push_back(to_tensor(std::vector<float>(5, (float)s)));
+    }
+
+    CHECK_THROWS(model(inputs), std::runtime_error);
+    Tape tape;
+    {
+        Tape::Scope scope(tape);
+        CHECK_THROWS(model(inputs), std::runtime_error);
+        CHECK(tape.size() == 0);
+    }
+
+    inputs[3] = to_tensor(std::vector<float>(5, 0.5f));
+    CHECK(model(inputs).size() == inputs.size());
+}
+
+// 录制 Tape 时并行前向与串行前向的梯度相同（分片按样本顺序合并，反向的执行顺序也相同）
+int main()
+{
+    forward_exception_rethrown();
+
+    Linear model(5, 3);
+    ThreadPool pool(4);
+
+    std::vector<float> serial = gradients(model, nullptr, true);
+    std::vector<float> parallel = gradients(model, &pool, true);
+    std::vector<float> graph = gradients(model, &pool, false);
+
+    CHECK(serial.size() == parallel.size() && serial.size() == graph.size());
+    bool nonzero = false;
+    for (size_t i = 0; i < serial.size(); ++i)
+    {
+        CHECK(parallel[i] == serial[i]);
+        CHECK_NEAR(graph[i], serial[i], 1e-5);
+        nonzero = nonzero || serial[i] != 0.0f;
+    }
+    CHECK(nonzero);
+
+    // 同一个 tape 上连续两次并行前向，分片被复用
+    Tape tape;
+    {
+        Tape::Scope scope(tape);
+        model.set_thread_pool(&pool);
+        std::vector<std::vector<Tensor>> inputs(8, to_tensor(std::vector<float>(5, 0.25f)));
+        model(inputs);
+        size_t once = tape.size();
+        model(inputs);
+        CHECK(tape.size() == 2 * once);
+        model.set_thread_pool(nullptr);
+    }
+    return check::result();
+}
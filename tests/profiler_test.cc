@@ -0,0 +1,126 @@
+#include "profiler.h"
+#include "dense_tensor.h"
+#include "check.h"
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace cctorch;
+
+namespace
+{
+    const std::string kTrace = "profiler_test_trace.json";
+
+    // 一个小的前向 + 反向：经过库里的 DenseTensor::backward 区间，并新建计算图节点
+    void train_step()
+    {
+        CCTORCH_PROFILE_SCOPE("test::step");
+        DenseTensor x({4, 3}, 0.5f, false);
+        DenseTensor w({3, 2}, 0.25f), b({2}, 0.1f);
+        {
+            CCTORCH_PROFILE_SCOPE("test::forward");
+            x.linear_relu(w, b).sum().backward();
+        }
+    }
+
+    size_t count(const std::string &text, const std::string &what)
+    {
+        size_t n = 0;
+        for (size_t at = text.find(what); at != std::string::npos; at = text.find(what, at + 1))
+        {
+            ++n;
+        }
+        return n;
+    }
+}
+
+// 区间、每步计数、Chrome trace 和汇总表都有内容；stop() 之后的区间不再记录
+static void spans_and_counters()
+{
+    profiler::start();
+    CHECK(profiler::recording());
+    train_step();
+    profiler::step();
+    train_step();
+    train_step();
+    profiler::step();
+    profiler::stop();
+    CHECK(!profiler::recording());
+    train_step();
+
+    std::vector<profiler::StepStats> steps = profiler::steps();
+    CHECK(steps.size() == 2);
+    for (const profiler::StepStats &s : steps)
+    {
+        CHECK(s.begin_ns >= 0 && s.end_ns >= s.begin_ns);
+        CHECK(s.nodes_created > 0 && s.bytes_allocated > 0 && s.peak_live_nodes > 0);
+    }
+    CHECK(steps[1].begin_ns == steps[0].end_ns);
+    CHECK(steps[1].nodes_created == 2 * steps[0].nodes_created);
+
+    profiler::write_chrome_trace(kTrace);
+    std::ifstream in(kTrace);
+    std::string trace((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    CHECK(trace.rfind("{\"displayTimeUnit\"", 0) == 0);
+    CHECK(count(trace, "\"name\":\"test::step\"") == 3);
+    CHECK(count(trace, "\"name\":\"test::forward\"") == 3);
+    CHECK(count(trace, "\"name\":\"DenseTensor::backward\"") == 3);
+    CHECK(count(trace, "\"name\":\"graph\"") == 2);
+
+    std::ostringstream summary;
+    profiler::print_summary(summary);
+    CHECK(summary.str().find("test::forward") != std::string::npos);
+    CHECK(summary.str().find("2 steps") != std::string::npos);
+}
+
+// 其他线程的区间进行中反复 start()：跨过 start() 的区间被丢弃，记下的区间都落在本次记录之内
+static void restart_while_spans_open()
+{
+    std::atomic<bool> done{false};
+    std::thread worker([&]
+                       {
+                           while (!done.load())
+                           {
+                               CCTORCH_PROFILE_SCOPE("test::worker");
+                               std::this_thread::yield();
+                           } });
+    for (int i = 0; i < 50; ++i)
+    {
+        profiler::start();
+        std::this_thread::yield();
+    }
+    done = true;
+    worker.join();
+    profiler::stop();
+
+    profiler::write_chrome_trace(kTrace);
+    std::ifstream in(kTrace);
+    std::string trace((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    CHECK(trace.find("\"ts\":-") == std::string::npos);
+    CHECK(trace.find("\"dur\":-") == std::string::npos);
+    CHECK(trace.find("test::step") == std::string::npos);
+}
+
+int main()
+{
+    if (!profiler::enabled())
+    {
+        // 没有定义 CCTORCH_PROFILE 时所有接口都是空的
+        profiler::start();
+        train_step();
+        profiler::step();
+        CHECK(!profiler::recording() && profiler::steps().empty());
+        std::cout << "note: built without CCTORCH_PROFILE, configure with -DCCTORCH_PROFILE=ON to exercise the profiler\n";
+        return check::result();
+    }
+    spans_and_counters();
+    restart_while_spans_open();
+    std::remove(kTrace.c_str());
+    return check::result();
+}
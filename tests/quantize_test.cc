@@ -0,0 +1,166 @@
+#include "quantize.h"
+#include "layer.h"
+#include "check.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace cctorch;
+
+namespace
+{
+    const std::string kFp32 = "quantize_test_fp32.ckpt";
+    const std::string kInt8 = "quantize_test_int8.ckpt";
+
+    // 确定性的伪随机序列
+    uint32_t next(uint32_t &state)
+    {
+        state = state * 1664525u + 1013904223u;
+        return state >> 8;
+    }
+
+    int round_up(int n, int multiple)
+    {
+        return (n + multiple - 1) / multiple * multiple;
+    }
+}
+
+// igemm_u8s8（当前 CPU 选中的内核）与逐元素的 int32 累加逐位相同：行、列、k 都覆盖不满一个微内核或一组 4 的尾部，
+// lda、ldc 大于矩阵宽度时不读写其余的位置
+static void igemm_matches_reference()
+{
+    uint32_t state = 1;
+    for (int m : {1, 3, 4, 5, 9})
+    {
+        for (int n : {1, 15, 16, 17, 40})
+        {
+            for (int k : {1, 3, 4, 6, 67})
+            {
+                int lda = round_up(k, 4) + 4, ldc = n + 3;
+                std::vector<uint8_t> a((size_t)m * lda);
+                std::vector<int8_t> b((size_t)k * n);
+                for (int i = 0; i < m; ++i)
+                {
+                    for (int p = 0; p < lda; ++p)
+                    {
+                        // 补齐位置也写入非零值：对应的打包权重为 0，不能影响结果
+                        a[(size_t)i * lda + p] = next(state) % (quantized_activation_max + 1);
+                    }
+                }
+                for (int8_t &w : b)
+                {
+                    w = static_cast<int8_t>((int)(next(state) % 256) - 128);
+                }
+                std::vector<int8_t> packed(int8_packed_size(k, n));
+                pack_int8_weights(b.data(), k, n, packed.data());
+
+                const int32_t sentinel = 0x5a5a5a5a;
+                std::vector<int32_t> c((size_t)m * ldc, sentinel);
+                igemm_u8s8(m, n, k, a.data(), lda, packed.data(), c.data(), ldc);
+                for (int i = 0; i < m; ++i)
+                {
+                    for (int j = 0; j < n; ++j)
+                    {
+                        int32_t expected = 0;
+                        for (int p = 0; p < k; ++p)
+                        {
+                            expected += (int32_t)a[(size_t)i * lda + p] * b[(size_t)p * n + j];
+                        }
+                        CHECK(c[(size_t)i * ldc + j] == expected);
+                    }
+                    for (int j = n; j < ldc; ++j)
+                    {
+                        CHECK(c[(size_t)i * ldc + j] == sentinel);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// 量化后的两层 MLP 与 fp32 前向接近；保存再读回后预测逐位相同，并且多个 ROW_BLOCK 的 batch 与逐行预测一致
+static void quantized_mlp_round_trip()
+{
+    const int in = 6, hidden = 20, out = 3;
+    const size_t batch = 70;
+    Linear first(in, hidden), second(hidden, out);
+    CheckpointWriter writer;
+    first.save_to_checkpoint(writer);
+    second.save_to_checkpoint(writer);
+    writer.write(kFp32);
+
+    uint32_t state = 7;
+    std::vector<float> x(batch * in);
+    for (float &v : x)
+    {
+        v = (float)(next(state) % 2001) / 1000.0f - 1.0f;
+    }
+
+    // fp32 参考：first -> ReLU -> second
+    std::vector<float> expected(batch * out);
+    float largest = 0.0f;
+    for (size_t r = 0; r < batch; ++r)
+    {
+        std::vector<float> h(hidden);
+        for (int j = 0; j < hidden; ++j)
+        {
+            float sum = first.bias.value(j);
+            for (int p = 0; p < in; ++p)
+            {
+                sum += x[r * in + p] * first.weight.value(p * hidden + j);
+            }
+            h[j] = std::max(sum, 0.0f);
+        }
+        for (int j = 0; j < out; ++j)
+        {
+            float sum = second.bias.value(j);
+            for (int p = 0; p < hidden; ++p)
+            {
+                sum += h[p] * second.weight.value(p * out + j);
+            }
+            expected[r * out + j] = sum;
+            largest = std::max(largest, std::fabs(sum));
+        }
+    }
+
+    Checkpoint fp32(kFp32);
+    CHECK_THROWS(QuantizedMLP(fp32, x.data(), 0), std::invalid_argument);
+    QuantizedMLP model(fp32, x.data(), batch);
+    CHECK(model.num_layers() == 2 && model.in_features() == in && model.out_features() == out);
+    CHECK(model.weight_bytes() < 4 * (size_t)(in * hidden + hidden + hidden * out + out));
+    std::vector<float> y(batch * out);
+    model.predict(x.data(), y.data(), batch);
+    for (size_t i = 0; i < y.size(); ++i)
+    {
+        CHECK_NEAR(y[i], expected[i], 0.05 * largest + 1e-3);
+    }
+
+    model.save(kInt8);
+    QuantizedMLP loaded(kInt8);
+    CHECK(loaded.num_layers() == 2 && loaded.weight_bytes() == model.weight_bytes());
+    std::vector<float> reloaded(batch * out), single(out);
+    loaded.predict(x.data(), reloaded.data(), batch);
+    CHECK(reloaded == y);
+    for (size_t r = 0; r < batch; r += 23)
+    {
+        loaded.predict(x.data() + r * in, single.data(), 1);
+        CHECK(std::equal(single.begin(), single.end(), y.begin() + r * out));
+    }
+
+    // fp32 检查点不能当作量化模型读取
+    CHECK_THROWS(QuantizedMLP{kFp32}, std::runtime_error);
+}
+
+int main()
+{
+    std::cout << "igemm kernel: " << igemm_kernel_name() << "\n";
+    igemm_matches_reference();
+    quantized_mlp_round_trip();
+    std::remove(kFp32.c_str());
+    std::remove(kInt8.c_str());
+    return check::result();
+}
@@ -0,0 +1,86 @@
+#include "tensor.h"
+#include "tape.h"
+#include "check.h"
+
+using namespace cctorch;
+
+// Scope 内已经析构、与 loss 无关的临时运算不参与反向传播
+static void dead_temporaries_are_skipped()
+{
+    Tensor a(2.0f), b(3.0f), c(5.0f);
+    Tape tape;
+    {
+        Tape::Scope scope(tape);
+        {
+            Tensor tmp = a * b;
+        }
+        Tensor loss = a * c;
+        loss.backward();
+        CHECK_NEAR(a.grad(), 5.0, 0);
+        CHECK_NEAR(b.grad(), 0.0, 0);
+        CHECK_NEAR(c.grad(), 2.0, 0);
+    }
+    CHECK(tape.size() == 0);
+}
+
+// 同一个 Scope 内第二次 backward 不会重复累加已经执行过的记录
+static void second_backward_does_not_double_count()
+{
+    Tensor a(2.0f), b(3.0f);
+    Tape tape;
+    Tape::Scope scope(tape);
+    Tensor h = a * b;
+    Tensor loss = h + h.relu();
+    loss.backward();
+    loss.backward();
+    CHECK_NEAR(a.grad(), 6.0, 0);
+    CHECK_NEAR(b.grad(), 4.0, 0);
+
+    // 与 loss 共享 h 的另一个 root 只执行 h 之后还没执行过的记录
+    Tensor other = h * a;
+    other.backward();
+    CHECK_NEAR(a.grad(), 6.0 + 6.0, 0);
+    CHECK_NEAR(b.grad(), 4.0, 0);
+}
+
+// tape 与按 sons 计数的反向传播给出相同的梯度（含 reduce 节点）
+static void matches_graph_backward()
+{
+    auto run = [](bool use_tape, float *grads)
+    {
+        Tensor x(0.5f), y(-1.5f), z(2.0f);
+        auto loss_of = [&]
+        {
+            Tensor s = (x * y).exp() + (z / x).log() - y.relu();
+            return Tensor::reduce(3.0f * s.value(), {s, x}, {3.0f, 0.5f});
+        };
+        if (use_tape)
+        {
+            Tape tape;
+            Tape::Scope scope(tape);
+            loss_of().backward();
+        }
+        else
+        {
+            loss_of().backward();
+        }
+        grads[0] = x.grad();
+        grads[1] = y.grad();
+        grads[2] = z.grad();
+    };
+    float graph[3], taped[3];
+    run(false, graph);
+    run(true, taped);
+    for (int i = 0; i < 3; ++i)
+    {
+        CHECK_NEAR(taped[i], graph[i], 1e-6);
+    }
+}
+
+int main()
+{
+    dead_temporaries_are_skipped();
+    second_backward_does_not_double_count();
+    matches_graph_backward();
+    return check::result();
+}
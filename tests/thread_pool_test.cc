@@ -0,0 +1,101 @@
+#include "thread_pool.h"
+#include "tensor.h"
+#include "check.h"
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+using namespace cctorch;
+
+// 区间抛出异常时其余区间照常执行完，parallel_for 重新抛出，线程池之后照常可用
+static void parallel_for_rethrows()
+{
+    ThreadPool pool(4);
+    std::vector<std::atomic<int>> visited(1000);
+    CHECK_THROWS(pool.parallel_for(visited.size(), [&](size_t begin, size_t end)
+                                   {
+                                       for (size_t i = begin; i < end; ++i)
+                                       {
+                                           visited[i]++;
+                                       }
+                                       if (begin > 0)
+                                       {
+                                           throw std::runtime_error("chunk failed");
+                                       } },
+                                   10),
+                 std::runtime_error);
+    for (auto &v : visited)
+    {
+        CHECK(v.load() == 1);
+    }
+
+    std::atomic<size_t> total(0);
+    pool.parallel_for(100, [&](size_t begin, size_t end)
+                      { total += end - begin; });
+    CHECK(total.load() == 100);
+}
+
+// submit 的任务抛出的异常由 wait() 在所有任务结束后重新抛出，只抛一次
+static void wait_rethrows()
+{
+    ThreadPool pool(3);
+    std::atomic<int> finished(0);
+    for (int i = 0; i < 20; ++i)
+    {
+        pool.submit([&finished, i]
+                    {
+                        if (i % 5 == 0)
+                        {
+                            throw std::invalid_argument("task failed");
+                        }
+                        finished++; });
+    }
+    CHECK_THROWS(pool.wait(), std::invalid_argument);
+    CHECK(finished.load() == 16);
+    pool.wait();
+}
+
+namespace
+{
+    // 扇入图：共享的中间节点 h 被许多分支同时使用，并行反向时多个线程向它累加梯度
+    Tensor fan_in(std::vector<Tensor> &leaves)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            leaves.push_back(Tensor(0.1f * (i + 1)));
+        }
+        Tensor h = leaves[0] * leaves[1] + leaves[2];
+        Tensor root = Tensor(0.0f);
+        for (int k = 0; k < 200; ++k)
+        {
+            Tensor branch = (h * Tensor(0.01f * (k % 7)) + leaves[3]).exp();
+            root = root + branch * h;
+        }
+        return root;
+    }
+}
+
+// 多线程反向传播与单线程反向传播给出相同的梯度
+static void parallel_backward_matches()
+{
+    std::vector<Tensor> serial_leaves;
+    fan_in(serial_leaves).backward();
+
+    ThreadPool pool(4);
+    std::vector<Tensor> parallel_leaves;
+    fan_in(parallel_leaves).backward(pool);
+
+    for (size_t i = 0; i < serial_leaves.size(); ++i)
+    {
+        CHECK(serial_leaves[i].grad() != 0.0f);
+        CHECK_NEAR(parallel_leaves[i].grad(), serial_leaves[i].grad(), 1e-5);
+    }
+}
+
+int main()
+{
+    parallel_for_rethrows();
+    wait_rethrows();
+    parallel_backward_matches();
+    return check::result();
+}
@@ -0,0 +1,196 @@
+#include "trainer.h"
+#include "layer.h"
+#include "optimizer.h"
+#include "check.h"
+#include <algorithm>
+#include <vector>
+
+using namespace cctorch;
+
+namespace
+{
+    constexpr int kIn = 5;
+    constexpr int kOut = 3;
+
+    DenseTensor images(int rows, int offset)
+    {
+        std::vector<float> x;
+        for (int i = 0; i < rows * kIn; ++i)
+        {
+            x.push_back(0.1f * (((i + offset * kIn) * 7) % 13) - 0.6f);
+        }
+        return DenseTensor({rows, kIn}, x, false);
+    }
+
+    std::vector<unsigned char> labels(int rows, int offset)
+    {
+        std::vector<unsigned char> y;
+        for (int i = 0; i < rows; ++i)
+        {
+            y.push_back((i + offset) % kOut);
+        }
+        return y;
+    }
+
+    // 同样初值的模型
+    void reset(Linear &model)
+    {
+        for (DenseTensor &p : model.dense_parameters())
+        {
+            for (size_t i = 0; i < p.numel(); ++i)
+            {
+                p.value_ptr()[i] = 0.05f * (float)((i * 3) % 7) - 0.15f;
+            }
+            p.refresh_view();
+        }
+    }
+
+    std::vector<float> weights(Linear &model)
+    {
+        std::vector<float> w;
+        for (DenseTensor &p : model.dense_parameters())
+        {
+            w.insert(w.end(), p.value_ptr(), p.value_ptr() + p.numel());
+        }
+        return w;
+    }
+
+    void check_same(const std::vector<float> &a, const std::vector<float> &b)
+    {
+        CHECK(a.size() == b.size());
+        for (size_t i = 0; i < a.size(); ++i)
+        {
+            CHECK_NEAR(a[i], b[i], 1e-5);
+        }
+    }
+
+    // 均方误差损失，目标为 one-hot 标签
+    DenseTensor mse(const DenseTensor &outputs, const std::vector<unsigned char> &targets)
+    {
+        std::vector<float> onehot(outputs.numel(), 0.0f);
+        for (size_t r = 0; r < targets.size(); ++r)
+        {
+            onehot[r * kOut + targets[r]] = 1.0f;
+        }
+        return outputs.mse(DenseTensor(outputs.shape(), onehot, false));
+    }
+
+    // 用给定的 micro-batch 大小训练一步，返回更新后的参数
+    std::vector<float> train_once(size_t micro, bool use_mse, float *loss = nullptr, size_t *chunks = nullptr)
+    {
+        Linear model(kIn, kOut);
+        reset(model);
+        CrossEntropyLoss criterion;
+        SGD optimizer(model.dense_parameters(), 0.1f);
+        float value;
+        if (use_mse)
+        {
+            Trainer<SGD> trainer(model, mse, optimizer, micro);
+            value = trainer.step(images(7, 0), labels(7, 0));
+            if (chunks)
+            {
+                *chunks = trainer.micro_batches();
+            }
+        }
+        else
+        {
+            Trainer<SGD> trainer(model, criterion, optimizer, micro);
+            value = trainer.step(images(7, 0), labels(7, 0));
+            if (chunks)
+            {
+                *chunks = trainer.micro_batches();
+            }
+        }
+        if (loss)
+        {
+            *loss = value;
+        }
+        return weights(model);
+    }
+}
+
+// 一次整个 batch 与切成大小不等的 micro-batch（3 + 3 + 1 行，按 n / rows 缩放）得到相同的损失和更新
+static void micro_batches_match_full_batch()
+{
+    for (bool use_mse : {false, true})
+    {
+        float full_loss, micro_loss;
+        size_t chunks = 0;
+        std::vector<float> full = train_once(0, use_mse, &full_loss);
+        std::vector<float> micro = train_once(3, use_mse, &micro_loss, &chunks);
+        CHECK(chunks == 3);
+        CHECK_NEAR(micro_loss, full_loss, 1e-5);
+        check_same(micro, full);
+    }
+}
+
+// 优化器的梯度累加：两个 4 行的 batch 累加后更新一次，等于一个 8 行的 batch；flush 提前结束一组，discard 丢弃一组
+static void accumulation_matches_large_batch()
+{
+    CrossEntropyLoss criterion;
+    auto large_batch = [&](int offset)
+    {
+        Linear model(kIn, kOut);
+        reset(model);
+        SGD optimizer(model.dense_parameters(), 0.1f);
+        Trainer<SGD> trainer(model, criterion, optimizer, 3);
+        DenseTensor x({8, kIn}, 0.0f, false);
+        DenseTensor first = images(4, offset), second = images(4, offset + 4);
+        std::copy(first.value_ptr(), first.value_ptr() + first.numel(), x.value_ptr());
+        std::copy(second.value_ptr(), second.value_ptr() + second.numel(), x.value_ptr() + first.numel());
+        std::vector<unsigned char> y = labels(4, offset), y2 = labels(4, offset + 4);
+        y.insert(y.end(), y2.begin(), y2.end());
+        trainer.step(x, y);
+        return weights(model);
+    };
+
+    // step：每 2 个逻辑 batch 更新一次
+    {
+        Linear model(kIn, kOut);
+        reset(model);
+        SGD optimizer(model.dense_parameters(), 0.1f);
+        optimizer.set_accumulation_steps(2);
+        Trainer<SGD> trainer(model, criterion, optimizer, 3);
+        std::vector<float> start = weights(model);
+        trainer.step(images(4, 0), labels(4, 0));
+        CHECK(optimizer.accumulating());
+        check_same(weights(model), start);
+        trainer.step(images(4, 4), labels(4, 4));
+        CHECK(!optimizer.accumulating());
+        check_same(weights(model), large_batch(0));
+    }
+
+    // flush：一组凑不满时提前更新
+    {
+        Linear model(kIn, kOut);
+        reset(model);
+        SGD optimizer(model.dense_parameters(), 0.1f);
+        optimizer.set_accumulation_steps(3);
+        Trainer<SGD> trainer(model, criterion, optimizer, 3);
+        trainer.step(images(4, 0), labels(4, 0));
+        trainer.step(images(4, 4), labels(4, 4));
+        CHECK(optimizer.flush());
+        check_same(weights(model), large_batch(0));
+    }
+
+    // discard：丢弃第一组已经累加的梯度，之后的一组照常更新
+    {
+        Linear model(kIn, kOut);
+        reset(model);
+        SGD optimizer(model.dense_parameters(), 0.1f);
+        optimizer.set_accumulation_steps(2);
+        Trainer<SGD> trainer(model, criterion, optimizer, 3);
+        trainer.step(images(4, 100), labels(4, 100));
+        optimizer.discard();
+        trainer.step(images(4, 0), labels(4, 0));
+        trainer.step(images(4, 4), labels(4, 4));
+        check_same(weights(model), large_batch(0));
+    }
+}
+
+int main()
+{
+    micro_batches_match_full_batch();
+    accumulation_matches_large_batch();
+    return check::result();
+}